@@ -0,0 +1,253 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+// Measures the native library through its exported functions.
+//
+// Usage: WebP.Benchmarks [-corpus directory] [-iterations count]
+//
+// The corpus directory defaults to the slow input corpus that the fuzz target writes,
+// every file in it is replayed through the same calls as the managed load path.
+//
+// A large image is then saved as lossless with regular pages, and again with large pages
+// when the process token has the SeLockMemoryPrivilege enabled.
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "LoadSequence.h"
+
+namespace
+{
+    struct BenchmarkOptions
+    {
+        BenchmarkOptions() : corpusDirectory("..\\WebP.Fuzz\\slow-inputs"), iterations(5)
+        {
+        }
+
+        std::string corpusDirectory;
+        int iterations;
+    };
+
+    // Runs the function the specified number of times and returns the median time in milliseconds.
+    template <typename Function>
+    double MeasureMedian(int iterations, Function function)
+    {
+        std::vector<double> times;
+
+        for (int i = 0; i < iterations; i++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            function();
+
+            times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        std::sort(times.begin(), times.end());
+
+        return times[times.size() / 2];
+    }
+
+    bool ReadFileBytes(const std::string& path, std::vector<uint8_t>& data)
+    {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        return true;
+    }
+
+    std::vector<std::string> ListFiles(const std::string& directory)
+    {
+        std::vector<std::string> files;
+        WIN32_FIND_DATAA findData;
+
+        HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &findData);
+        if (find != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+                {
+                    files.push_back(directory + "\\" + findData.cFileName);
+                }
+            } while (FindNextFileA(find, &findData));
+
+            FindClose(find);
+        }
+
+        std::sort(files.begin(), files.end());
+
+        return files;
+    }
+
+    // Replays the inputs that the fuzz target found to be slow, a regression shows up as a higher time.
+    void RunCorpusBenchmark(const BenchmarkOptions& options)
+    {
+        const std::vector<std::string> files = ListFiles(options.corpusDirectory);
+
+        printf("Load sequence, %zu files in %s\n", files.size(), options.corpusDirectory.c_str());
+
+        for (const std::string& path : files)
+        {
+            std::vector<uint8_t> data;
+
+            if (!ReadFileBytes(path, data))
+            {
+                printf("  %s: cannot be read\n", path.c_str());
+                continue;
+            }
+
+            int outputStride;
+            const size_t outputSize = GetLoadOutputSize(data.data(), data.size(), outputStride);
+            std::unique_ptr<uint8_t[]> output(outputSize > 0 ? new uint8_t[outputSize] : nullptr);
+
+            const double time = MeasureMedian(options.iterations, [&]()
+            {
+                RunLoadSequence(data.data(), data.size(), output.get(), outputSize, outputStride);
+            });
+
+            printf("  %s: %.2f ms\n", path.c_str(), time);
+        }
+    }
+
+    // Creates a BGRA image with smooth gradients and some noise, which is closer to a photo
+    // than a flat or random image and keeps the encoder busy in every transform.
+    std::vector<uint32_t> CreateTestImage(int width, int height)
+    {
+        std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+        uint32_t seed = 1;
+
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                seed = seed * 1103515245 + 12345;
+                const uint32_t noise = (seed >> 16) & 7;
+
+                const uint32_t b = ((x * 255) / width + noise) & 0xff;
+                const uint32_t g = ((y * 255) / height + noise) & 0xff;
+                const uint32_t r = (((x + y) * 255) / (width + height)) & 0xff;
+
+                pixels[static_cast<size_t>(y) * width + x] = 0xff000000 | (r << 16) | (g << 8) | b;
+            }
+        }
+
+        return pixels;
+    }
+
+    // The lossless encoder reads the ARGB copy of the image from image memory, which is the
+    // largest buffer that the library allocates itself.
+    void RunLargePageBenchmark(const BenchmarkOptions& options)
+    {
+        const int width = 4096;
+        const int height = 4096;
+        const int stride = width * 4;
+
+        const std::vector<uint32_t> pixels = CreateTestImage(width, height);
+
+        EncodeParams encodeOptions;
+        memset(&encodeOptions, 0, sizeof(encodeOptions));
+        encodeOptions.quality = 75;
+        encodeOptions.preset = WEBP_PRESET_DEFAULT;
+        encodeOptions.lossless = true;
+        encodeOptions.alphaCompression = -1;
+        encodeOptions.method = 0;
+
+        const size_t outputCapacity = static_cast<size_t>(stride) * height + 1024 * 1024;
+        std::unique_ptr<uint8_t[]> output(new uint8_t[outputCapacity]);
+
+        printf("Lossless save, %d x %d\n", width, height);
+
+        for (int pass = 0; pass < 2; pass++)
+        {
+            const bool largePages = pass != 0;
+
+            if (WebPEnableLargePages(largePages) != largePages)
+            {
+                printf("  large pages: not available, the SeLockMemoryPrivilege is not enabled\n");
+                break;
+            }
+
+            int error = VP8_ENC_OK;
+
+            const double time = MeasureMedian(options.iterations, [&]()
+            {
+                size_t outputSize;
+
+                error = WebPSaveToBuffer(pixels.data(), width, height, stride, &encodeOptions, nullptr, nullptr, output.get(), outputCapacity, &outputSize);
+            });
+
+            if (error != VP8_ENC_OK)
+            {
+                printf("  %s: failed with error %d\n", largePages ? "large pages" : "regular pages", error);
+            }
+            else
+            {
+                printf("  %s: %.2f ms\n", largePages ? "large pages" : "regular pages", time);
+            }
+        }
+
+        WebPEnableLargePages(false);
+    }
+
+    bool ParseOptions(int argc, char** argv, BenchmarkOptions& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (strcmp(argv[i], "-corpus") == 0 && i + 1 < argc)
+            {
+                options.corpusDirectory = argv[++i];
+            }
+            else if (strcmp(argv[i], "-iterations") == 0 && i + 1 < argc)
+            {
+                options.iterations = atoi(argv[++i]);
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return options.iterations > 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+
+    if (!ParseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "Usage: WebP.Benchmarks [-corpus directory] [-iterations count]\n");
+        return 1;
+    }
+
+    RunCorpusBenchmark(options);
+    RunLargePageBenchmark(options);
+
+    return 0;
+}
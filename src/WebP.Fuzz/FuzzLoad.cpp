@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+// A libFuzzer target that looks for inputs which make the load and metadata functions slow,
+// or allocate far more memory than the decoded image needs.
+//
+// Each input runs the same native calls as the managed load path. An input that exceeds the
+// time or allocation limit is saved into the slow input directory, which the benchmarks replay.
+// The limits are set with the following environment variables:
+//
+// WEBP_FUZZ_TIME_LIMIT_MS     The time limit for one input in milliseconds, the default is 250.
+// WEBP_FUZZ_MEMORY_LIMIT_MB   The allocation high-water mark in megabytes, excluding one working copy
+//                             of the image. The default is 64.
+// WEBP_FUZZ_SLOW_INPUTS       The directory that the inputs are saved in, the default is slow-inputs.
+//                             The directory must exist.
+//
+// The allocations are tracked with the sanitizer allocator hooks, so the target must be built with
+// AddressSanitizer, as libFuzzer requires.
+
+#include <sanitizer/allocator_interface.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "Checksum.h"
+#include "LoadSequence.h"
+
+namespace
+{
+    struct FuzzLimits
+    {
+        int64_t timeLimit;
+        int64_t memoryLimit;
+        std::string slowInputDirectory;
+    };
+
+    std::atomic<int64_t> allocatedBytes(0);
+    std::atomic<int64_t> peakAllocatedBytes(0);
+
+    void MallocHook(const volatile void* ptr, size_t size)
+    {
+        const int64_t current = allocatedBytes.fetch_add(static_cast<int64_t>(size)) + static_cast<int64_t>(size);
+        int64_t peak = peakAllocatedBytes.load();
+
+        while (current > peak && !peakAllocatedBytes.compare_exchange_weak(peak, current))
+        {
+        }
+    }
+
+    void FreeHook(const volatile void* ptr)
+    {
+        if (ptr != nullptr)
+        {
+            allocatedBytes.fetch_sub(static_cast<int64_t>(__sanitizer_get_allocated_size(const_cast<const void*>(ptr))));
+        }
+    }
+
+    int64_t GetLimit(const char* name, int64_t defaultValue)
+    {
+        const char* value = getenv(name);
+
+        return value != nullptr ? _atoi64(value) : defaultValue;
+    }
+
+    FuzzLimits ReadLimits()
+    {
+        FuzzLimits limits;
+        limits.timeLimit = GetLimit("WEBP_FUZZ_TIME_LIMIT_MS", 250);
+        limits.memoryLimit = GetLimit("WEBP_FUZZ_MEMORY_LIMIT_MB", 64) * 1024 * 1024;
+
+        const char* directory = getenv("WEBP_FUZZ_SLOW_INPUTS");
+        limits.slowInputDirectory = directory != nullptr ? directory : "slow-inputs";
+
+        return limits;
+    }
+
+    void SaveSlowInput(const FuzzLimits& limits, const char* kind, const uint8_t* data, size_t size)
+    {
+        StreamChecksum checksum(ChecksumXxHash64);
+        checksum.Update(data, size);
+
+        char name[64];
+        snprintf(name, sizeof(name), "%s-%016llx.webp", kind, static_cast<unsigned long long>(checksum.GetValue()));
+
+        const std::string path = limits.slowInputDirectory + "/" + name;
+        std::ofstream file(path, std::ios::binary);
+
+        if (file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size)))
+        {
+            fprintf(stderr, "Saved %s\n", path.c_str());
+        }
+        else
+        {
+            fprintf(stderr, "Could not write %s\n", path.c_str());
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv)
+{
+    __sanitizer_install_malloc_and_free_hooks(MallocHook, FreeHook);
+
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static const FuzzLimits limits = ReadLimits();
+
+    int outputStride;
+    const size_t outputSize = GetLoadOutputSize(data, size, outputStride);
+    std::unique_ptr<uint8_t[]> output(outputSize > 0 ? new uint8_t[outputSize] : nullptr);
+
+    const int64_t baseline = allocatedBytes.load();
+    peakAllocatedBytes.store(baseline);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    RunLoadSequence(data, size, output.get(), outputSize, outputStride);
+
+    const int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    // The decoders may keep a full size working copy of the image, e.g. the ARGB buffer of the lossless decoder,
+    // only the memory used on top of it is checked.
+    const int64_t allocated = peakAllocatedBytes.load() - baseline - static_cast<int64_t>(outputSize);
+
+    if (elapsed > limits.timeLimit)
+    {
+        fprintf(stderr, "Slow input: %lld ms\n", static_cast<long long>(elapsed));
+        SaveSlowInput(limits, "time", data, size);
+    }
+
+    if (allocated > limits.memoryLimit)
+    {
+        fprintf(stderr, "Input allocated %lld bytes\n", static_cast<long long>(allocated));
+        SaveSlowInput(limits, "memory", data, size);
+    }
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <memory>
+#include "WebP.h"
+
+// The largest image that is decoded, the larger images only run the header and metadata functions.
+// This keeps the output buffer within the default libFuzzer RSS limit.
+const uint64_t MaxDecodedPixels = 8192 * 8192;
+
+// Gets the size of the buffer that RunLoadSequence decodes the image into, or 0 if the image is not decoded.
+// The managed load path allocates the output surface before it decodes the image, so the callers
+// allocate the buffer outside of the measured region.
+inline size_t GetLoadOutputSize(const uint8_t* data, size_t dataSize, int& outputStride)
+{
+    ImageInfo info;
+
+    outputStride = 0;
+
+    if (WebPGetImageInfo(data, dataSize, &info) != VP8_STATUS_OK ||
+        info.hasAnimation ||
+        static_cast<uint64_t>(info.width) * info.height > MaxDecodedPixels)
+    {
+        return 0;
+    }
+
+    outputStride = info.width * 4;
+
+    return static_cast<size_t>(outputStride) * info.height;
+}
+
+// Runs the native functions that the managed load path calls for a file, in the same order.
+// This is shared by the fuzz target and the benchmark that replays the slow input corpus.
+// The output buffer must have the size returned by GetLoadOutputSize, the image is not decoded if the size is 0.
+inline void RunLoadSequence(const uint8_t* data, size_t dataSize, uint8_t* output, size_t outputSize, int outputStride)
+{
+    ImageInfo info;
+
+    if (WebPGetImageInfo(data, dataSize, &info) == VP8_STATUS_OK && outputSize > 0)
+    {
+        WebPLoad(data, dataSize, output, outputSize, outputStride);
+    }
+
+    const MetadataType types[] = { ColorProfile, EXIF, XMP };
+
+    for (MetadataType type : types)
+    {
+        const uint32_t metadataSize = GetMetadataSize(data, dataSize, type);
+
+        if (metadataSize > 0)
+        {
+            std::unique_ptr<uint8_t[]> metadata(new uint8_t[metadataSize]);
+
+            ExtractMetadata(data, dataSize, metadata.get(), metadataSize, type);
+        }
+    }
+
+    ExifImageInfo exifInfo;
+    WebPGetExifImageInfo(data, dataSize, &exifInfo);
+}
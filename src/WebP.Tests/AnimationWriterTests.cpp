@@ -0,0 +1,299 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "Tests.h"
+#include "RiffReader.h"
+
+namespace
+{
+    const int CanvasWidth = 64;
+    const int CanvasHeight = 48;
+    const int CanvasStride = CanvasWidth * 4;
+    const int FrameDuration = 100;
+
+    // A seekable in-memory stream for the write and seek callbacks.
+    std::vector<uint8_t> stream;
+    size_t streamPosition;
+
+    WebPEncodingError __stdcall WriteToStream(const uint8_t* data, const size_t dataSize)
+    {
+        if (streamPosition + dataSize > stream.size())
+        {
+            stream.resize(streamPosition + dataSize);
+        }
+
+        memcpy(stream.data() + streamPosition, data, dataSize);
+        streamPosition += dataSize;
+
+        return VP8_ENC_OK;
+    }
+
+    WebPEncodingError __stdcall SeekStream(uint64_t position)
+    {
+        if (position > stream.size())
+        {
+            return VP8_ENC_ERROR_BAD_WRITE;
+        }
+
+        streamPosition = static_cast<size_t>(position);
+
+        return VP8_ENC_OK;
+    }
+
+    void ResetStream(const std::vector<uint8_t>& data)
+    {
+        stream = data;
+        streamPosition = 0;
+    }
+
+    bool __stdcall CancelEncoding(int)
+    {
+        return false;
+    }
+
+    // The canvases that WebPLoadAnimation produced for each frame.
+    std::vector<uint8_t> decodeCanvas;
+    std::vector<std::vector<uint8_t>> decodedFrames;
+
+    bool __stdcall StoreDecodedFrame(int, int)
+    {
+        decodedFrames.push_back(decodeCanvas);
+
+        return true;
+    }
+
+    std::vector<std::vector<uint8_t>> DecodeFrames(const std::vector<uint8_t>& data)
+    {
+        decodeCanvas.assign(static_cast<size_t>(CanvasStride) * CanvasHeight, 0);
+        decodedFrames.clear();
+
+        if (WebPLoadAnimation(data.data(), data.size(), decodeCanvas.data(), decodeCanvas.size(), CanvasStride, StoreDecodedFrame) != VP8_STATUS_OK)
+        {
+            decodedFrames.clear();
+        }
+
+        return decodedFrames;
+    }
+
+    // The test image with an opaque square that moves with the frame index.
+    std::vector<uint8_t> CreateFrame(int index)
+    {
+        std::vector<uint8_t> pixels = CreateTestImage(CanvasWidth, CanvasHeight, CanvasStride);
+
+        for (int y = index * 4; y < (index * 4) + 12; y++)
+        {
+            for (int x = index * 6; x < (index * 6) + 16; x++)
+            {
+                uint8_t* pixel = pixels.data() + (static_cast<size_t>(y) * CanvasStride) + (static_cast<size_t>(x) * 4);
+
+                pixel[0] = 40;
+                pixel[1] = static_cast<uint8_t>(index * 50);
+                pixel[2] = 220;
+                pixel[3] = 255;
+            }
+        }
+
+        return pixels;
+    }
+
+    bool AddFrames(AnimationWriter* writer, int firstFrame, int count)
+    {
+        const EncodeParams encodeOptions = CreateEncodeOptions(true);
+
+        for (int i = firstFrame; i < firstFrame + count; i++)
+        {
+            const std::vector<uint8_t> frame = CreateFrame(i);
+
+            if (WebPAnimationWriterAddCanvasFrame(writer, frame.data(), CanvasStride, FrameDuration, &encodeOptions, nullptr) != VP8_ENC_OK)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool FramesMatch(const std::vector<std::vector<uint8_t>>& frames, int count)
+    {
+        if (frames.size() != static_cast<size_t>(count))
+        {
+            return false;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            if (!ImagesEqual(CreateFrame(i).data(), CanvasStride, frames[i].data(), CanvasStride, CanvasWidth, CanvasHeight))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    std::vector<uint8_t> CreateAnimation(int frameCount, const MetadataParams* metadata)
+    {
+        ResetStream(std::vector<uint8_t>());
+
+        AnimationWriter* writer;
+
+        if (WebPAnimationWriterCreate(WriteToStream, SeekStream, CanvasWidth, CanvasHeight, 0, 0, metadata, &writer) != VP8_ENC_OK)
+        {
+            return std::vector<uint8_t>();
+        }
+
+        const bool finished = AddFrames(writer, 0, frameCount) && WebPAnimationWriterFinish(writer) == VP8_ENC_OK;
+
+        WebPAnimationWriterDelete(writer);
+
+        return finished ? stream : std::vector<uint8_t>();
+    }
+
+    std::vector<RiffChunk> GetFrameChunks(const std::vector<uint8_t>& data)
+    {
+        std::vector<RiffChunk> frames;
+        RiffChunkReader reader(data.data(), data.size());
+        RiffChunk chunk;
+
+        while (reader.Next(chunk))
+        {
+            if (chunk.fourcc == AnmfFourCC)
+            {
+                frames.push_back(chunk);
+            }
+        }
+
+        return frames;
+    }
+
+    std::vector<uint8_t> GetExif(const std::vector<uint8_t>& data)
+    {
+        std::vector<uint8_t> exif(GetMetadataSize(data.data(), data.size(), EXIF));
+
+        if (!exif.empty())
+        {
+            ExtractMetadata(data.data(), data.size(), exif.data(), static_cast<uint32_t>(exif.size()), EXIF);
+        }
+
+        return exif;
+    }
+
+    int Validate(const std::vector<uint8_t>& data)
+    {
+        size_t errorOffset;
+
+        return WebPValidate(data.data(), data.size(), &errorOffset);
+    }
+}
+
+TEST_CASE(AnimationWriterStreamsFrames)
+{
+    const std::vector<uint8_t> animation = CreateAnimation(3, nullptr);
+
+    CHECK(!animation.empty());
+    CHECK(Validate(animation) == WebPValidationOk);
+    CHECK(GetFrameChunks(animation).size() == 3);
+    CHECK(FramesMatch(DecodeFrames(animation), 3));
+
+    ImageInfo info;
+    CHECK(WebPGetImageInfo(animation.data(), animation.size(), &info) == VP8_STATUS_OK);
+    CHECK(info.hasAnimation);
+    CHECK(info.width == CanvasWidth);
+    CHECK(info.height == CanvasHeight);
+}
+
+TEST_CASE(AnimationWriterAppendsFrames)
+{
+    std::vector<uint8_t> exif = { 'I', 'I', 42, 0, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    MetadataParams metadata = {};
+    metadata.exif = exif.data();
+    metadata.exifSize = exif.size();
+
+    const std::vector<uint8_t> original = CreateAnimation(3, &metadata);
+    CHECK(!original.empty());
+    CHECK(GetExif(original) == exif);
+
+    const std::vector<uint8_t> lastFrame = CreateFrame(2);
+
+    ResetStream(original);
+
+    AnimationWriter* writer;
+    CHECK(WebPAnimationWriterOpen(original.data(), original.size(), WriteToStream, SeekStream, lastFrame.data(), CanvasStride, &writer) == VP8_ENC_OK);
+    CHECK(AddFrames(writer, 3, 2));
+    CHECK(WebPAnimationWriterFinish(writer) == VP8_ENC_OK);
+    WebPAnimationWriterDelete(writer);
+
+    const std::vector<uint8_t> appended = stream;
+
+    CHECK(Validate(appended) == WebPValidationOk);
+    CHECK(FramesMatch(DecodeFrames(appended), 5));
+    CHECK(GetExif(appended) == exif);
+
+    // The existing frames are not written again.
+    const std::vector<RiffChunk> originalFrames = GetFrameChunks(original);
+    const std::vector<RiffChunk> appendedFrames = GetFrameChunks(appended);
+
+    CHECK(originalFrames.size() == 3);
+    CHECK(appendedFrames.size() == 5);
+
+    for (size_t i = 0; i < originalFrames.size() && i < appendedFrames.size(); i++)
+    {
+        const RiffChunk& frame = originalFrames[i];
+        const size_t frameSize = ChunkHeaderSize + frame.payloadSize;
+
+        CHECK(appendedFrames[i].offset == frame.offset);
+        CHECK(memcmp(appended.data() + frame.offset, original.data() + frame.offset, frameSize) == 0);
+    }
+}
+
+TEST_CASE(UnfinishedAppendLeavesTheOriginalAnimation)
+{
+    const std::vector<uint8_t> original = CreateAnimation(3, nullptr);
+
+    ResetStream(original);
+
+    AnimationWriter* writer;
+    CHECK(WebPAnimationWriterOpen(original.data(), original.size(), WriteToStream, SeekStream, nullptr, 0, &writer) == VP8_ENC_OK);
+    CHECK(AddFrames(writer, 3, 1));
+    WebPAnimationWriterDelete(writer);
+
+    // The new frame was written after the RIFF data, which readers ignore.
+    CHECK(stream.size() > original.size());
+    CHECK(memcmp(stream.data(), original.data(), original.size()) == 0);
+    CHECK(Validate(stream) == WebPValidationOk);
+    CHECK(FramesMatch(DecodeFrames(stream), 3));
+}
+
+TEST_CASE(CancelledFrameCanBeFollowedByFinish)
+{
+    ResetStream(std::vector<uint8_t>());
+
+    AnimationWriter* writer;
+    CHECK(WebPAnimationWriterCreate(WriteToStream, SeekStream, CanvasWidth, CanvasHeight, 0, 0, nullptr, &writer) == VP8_ENC_OK);
+    CHECK(AddFrames(writer, 0, 1));
+
+    const size_t sizeBeforeCancel = stream.size();
+    const std::vector<uint8_t> cancelledFrame = CreateFrame(1);
+    const EncodeParams encodeOptions = CreateEncodeOptions(true);
+
+    CHECK(WebPAnimationWriterAddCanvasFrame(writer, cancelledFrame.data(), CanvasStride, FrameDuration, &encodeOptions, CancelEncoding) == VP8_ENC_ERROR_USER_ABORT);
+    CHECK(stream.size() == sizeBeforeCancel);
+
+    CHECK(AddFrames(writer, 1, 1));
+    CHECK(WebPAnimationWriterFinish(writer) == VP8_ENC_OK);
+    WebPAnimationWriterDelete(writer);
+
+    CHECK(Validate(stream) == WebPValidationOk);
+    CHECK(FramesMatch(DecodeFrames(stream), 2));
+}
@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "Tests.h"
+#include "Checksum.h"
+
+namespace
+{
+    const char CheckString[] = "123456789";
+    const char QuickBrownFox[] = "The quick brown fox jumps over the lazy dog";
+
+    std::vector<uint8_t> writtenImage;
+
+    WebPEncodingError __stdcall AppendWrittenImage(const uint8_t* image, const size_t imageSize)
+    {
+        writtenImage.insert(writtenImage.end(), image, image + imageSize);
+
+        return VP8_ENC_OK;
+    }
+
+    const uint8_t* AsBytes(const char* value)
+    {
+        return reinterpret_cast<const uint8_t*>(value);
+    }
+
+    uint64_t ComputeChecksum(ChecksumType type, const uint8_t* data, size_t dataSize)
+    {
+        StreamChecksum checksum(type);
+        checksum.Update(data, dataSize);
+
+        return checksum.GetValue();
+    }
+
+    // Covers the 8 byte slices, the 32 byte XXH64 stripes and the unaligned tails.
+    std::vector<uint8_t> CreateTestData(size_t size)
+    {
+        std::vector<uint8_t> data(size);
+
+        for (size_t i = 0; i < size; i++)
+        {
+            data[i] = static_cast<uint8_t>((i * 7) + 3);
+        }
+
+        return data;
+    }
+
+    uint32_t ComputeCrc32c(uint32_t (*update)(uint32_t, const uint8_t*, size_t), const uint8_t* data, size_t dataSize)
+    {
+        return update(0xffffffff, data, dataSize) ^ 0xffffffff;
+    }
+
+    void CheckCrc32cImplementation(uint32_t (*update)(uint32_t, const uint8_t*, size_t))
+    {
+        const std::vector<uint8_t> zeros(32, 0);
+        const std::vector<uint8_t> ones(32, 0xff);
+
+        CHECK(ComputeCrc32c(update, AsBytes(CheckString), strlen(CheckString)) == 0xE3069283);
+        CHECK(ComputeCrc32c(update, zeros.data(), zeros.size()) == 0x8A9136AA);
+        CHECK(ComputeCrc32c(update, ones.data(), ones.size()) == 0x62A8AB43);
+        CHECK(ComputeCrc32c(update, nullptr, 0) == 0);
+
+        // Every length and alignment gives the same result as the byte at a time reference.
+        const std::vector<uint8_t> data = CreateTestData(100);
+
+        for (size_t offset = 0; offset < 8; offset++)
+        {
+            for (size_t size = 0; size + offset <= data.size(); size += 13)
+            {
+                uint32_t expected = 0xffffffff;
+
+                for (size_t i = 0; i < size; i++)
+                {
+                    expected = UpdateCrc32cSoftware(expected, data.data() + offset + i, 1);
+                }
+
+                CHECK(update(0xffffffff, data.data() + offset, size) == expected);
+            }
+        }
+    }
+
+    void CheckSaveChecksum(ChecksumType type, const MetadataParams* metadata)
+    {
+        const int width = 40;
+        const int height = 30;
+        const int stride = width * 4;
+        const std::vector<uint8_t> pixels = CreateTestImage(width, height, stride);
+        const EncodeParams encodeOptions = CreateEncodeOptions(false);
+
+        writtenImage.clear();
+        uint64_t checksum = 0;
+
+        CHECK(WebPSaveWithChecksum(AppendWrittenImage, pixels.data(), width, height, stride, &encodeOptions, metadata, nullptr, type, &checksum) == VP8_ENC_OK);
+        CHECK(!writtenImage.empty());
+        CHECK(checksum == ComputeChecksum(type, writtenImage.data(), writtenImage.size()));
+    }
+}
+
+TEST_CASE(Crc32cMatchesKnownValues)
+{
+    CheckCrc32cImplementation(UpdateCrc32cSoftware);
+
+    CHECK(ComputeChecksum(ChecksumCrc32c, AsBytes(CheckString), strlen(CheckString)) == 0xE3069283);
+}
+
+#ifdef CRC32C_HARDWARE_SUPPORTED
+TEST_CASE(Crc32cHardwareMatchesSoftware)
+{
+    // The test passes without checking anything on a processor that does not support SSE 4.2.
+    if (IsCrc32cHardwareSupported())
+    {
+        CheckCrc32cImplementation(UpdateCrc32cHardware);
+    }
+}
+#endif
+
+TEST_CASE(XxHash64MatchesKnownValues)
+{
+    CHECK(ComputeChecksum(ChecksumXxHash64, nullptr, 0) == 0xEF46DB3751D8E999);
+    CHECK(ComputeChecksum(ChecksumXxHash64, AsBytes("abc"), 3) == 0x44BC2CF5AD770999);
+    CHECK(ComputeChecksum(ChecksumXxHash64, AsBytes(QuickBrownFox), strlen(QuickBrownFox)) == 0x0B242D361FDA71BC);
+
+    const std::vector<uint8_t> data = CreateTestData(100);
+    CHECK(ComputeChecksum(ChecksumXxHash64, data.data(), data.size()) == 0xA61F8D4C170FE531);
+}
+
+TEST_CASE(ChecksumIsIndependentOfTheBlockSizes)
+{
+    const std::vector<uint8_t> data = CreateTestData(1000);
+    const ChecksumType types[] = { ChecksumCrc32c, ChecksumXxHash64 };
+    const size_t blockSizes[] = { 1, 3, 31, 32, 33, 257 };
+
+    for (ChecksumType type : types)
+    {
+        const uint64_t expected = ComputeChecksum(type, data.data(), data.size());
+
+        for (size_t blockSize : blockSizes)
+        {
+            StreamChecksum checksum(type);
+
+            for (size_t offset = 0; offset < data.size(); offset += blockSize)
+            {
+                checksum.Update(data.data() + offset, blockSize < data.size() - offset ? blockSize : data.size() - offset);
+            }
+
+            CHECK(checksum.GetValue() == expected);
+
+            checksum.Reset();
+            CHECK(checksum.GetValue() == ComputeChecksum(type, nullptr, 0));
+        }
+    }
+}
+
+TEST_CASE(SaveChecksumMatchesTheWrittenBytes)
+{
+    std::vector<uint8_t> exif(24, 1);
+    std::vector<uint8_t> xmp(17, 2);
+
+    MetadataParams metadata = {};
+    metadata.exif = exif.data();
+    metadata.exifSize = exif.size();
+    metadata.xmp = xmp.data();
+    metadata.xmpSize = xmp.size();
+
+    const ChecksumType types[] = { ChecksumCrc32c, ChecksumXxHash64 };
+
+    for (ChecksumType type : types)
+    {
+        CheckSaveChecksum(type, nullptr);
+        CheckSaveChecksum(type, &metadata);
+    }
+}
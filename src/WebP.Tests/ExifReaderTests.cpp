@@ -0,0 +1,201 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "Tests.h"
+
+namespace
+{
+    // Builds a TIFF header and a first IFD that contains the orientation, resolution unit and resolution tags.
+    class ExifBuilder
+    {
+    public:
+        explicit ExifBuilder(bool bigEndian) : bigEndian(bigEndian)
+        {
+        }
+
+        std::vector<uint8_t> Build(uint16_t orientation, uint16_t resolutionUnit, uint32_t xNumerator, uint32_t yNumerator, uint32_t denominator)
+        {
+            const uint16_t entryCount = 5;
+            const uint32_t ifdOffset = 8;
+            const uint32_t rationalOffset = ifdOffset + 2 + (entryCount * 12) + 4;
+
+            data.clear();
+            data.push_back(bigEndian ? 'M' : 'I');
+            data.push_back(bigEndian ? 'M' : 'I');
+            Write16(42);
+            Write32(ifdOffset);
+
+            Write16(entryCount);
+            WriteShortEntry(274, orientation);
+            WriteRationalEntry(282, rationalOffset);
+            WriteRationalEntry(283, rationalOffset + 8);
+            WriteShortEntry(296, resolutionUnit);
+            // An unrelated tag that must be skipped.
+            WriteShortEntry(305, 0xffff);
+            Write32(0);
+
+            Write32(xNumerator);
+            Write32(denominator);
+            Write32(yNumerator);
+            Write32(denominator);
+
+            return data;
+        }
+
+    private:
+        void Write16(uint16_t value)
+        {
+            if (bigEndian)
+            {
+                data.push_back(static_cast<uint8_t>(value >> 8));
+                data.push_back(static_cast<uint8_t>(value));
+            }
+            else
+            {
+                data.push_back(static_cast<uint8_t>(value));
+                data.push_back(static_cast<uint8_t>(value >> 8));
+            }
+        }
+
+        void Write32(uint32_t value)
+        {
+            if (bigEndian)
+            {
+                Write16(static_cast<uint16_t>(value >> 16));
+                Write16(static_cast<uint16_t>(value));
+            }
+            else
+            {
+                Write16(static_cast<uint16_t>(value));
+                Write16(static_cast<uint16_t>(value >> 16));
+            }
+        }
+
+        void WriteShortEntry(uint16_t tag, uint16_t value)
+        {
+            Write16(tag);
+            Write16(3);
+            Write32(1);
+            Write16(value);
+            Write16(0);
+        }
+
+        void WriteRationalEntry(uint16_t tag, uint32_t valueOffset)
+        {
+            Write16(tag);
+            Write16(5);
+            Write32(1);
+            Write32(valueOffset);
+        }
+
+        std::vector<uint8_t> data;
+        bool bigEndian;
+    };
+
+    std::vector<uint8_t> EncodeWithExif(std::vector<uint8_t> exif)
+    {
+        const int width = 16;
+        const int height = 16;
+        const int stride = width * 4;
+        const std::vector<uint8_t> pixels = CreateTestImage(width, height, stride);
+
+        MetadataParams metadata = {};
+        metadata.exif = exif.data();
+        metadata.exifSize = exif.size();
+
+        return EncodeImage(pixels.data(), width, height, stride, CreateEncodeOptions(true), &metadata);
+    }
+
+    bool GetExifImageInfo(const std::vector<uint8_t>& exif, ExifImageInfo& info)
+    {
+        const std::vector<uint8_t> image = EncodeWithExif(exif);
+
+        return WebPGetExifImageInfo(image.data(), image.size(), &info);
+    }
+}
+
+TEST_CASE(ExifReaderReadsLittleEndianTags)
+{
+    ExifImageInfo info;
+
+    CHECK(GetExifImageInfo(ExifBuilder(false).Build(6, 2, 300, 150, 1), info));
+    CHECK(info.orientation == 6);
+    CHECK(info.resolutionUnit == 2);
+    CHECK(info.xResolution == 300.0);
+    CHECK(info.yResolution == 150.0);
+}
+
+TEST_CASE(ExifReaderReadsBigEndianTags)
+{
+    ExifImageInfo info;
+
+    CHECK(GetExifImageInfo(ExifBuilder(true).Build(8, 3, 720, 360, 10), info));
+    CHECK(info.orientation == 8);
+    CHECK(info.resolutionUnit == 3);
+    CHECK(info.xResolution == 72.0);
+    CHECK(info.yResolution == 36.0);
+}
+
+TEST_CASE(ExifReaderIgnoresInvalidResolutions)
+{
+    ExifImageInfo info;
+
+    // A zero denominator leaves the resolution unset, the other tags are still read.
+    CHECK(GetExifImageInfo(ExifBuilder(false).Build(3, 2, 300, 300, 0), info));
+    CHECK(info.orientation == 3);
+    CHECK(info.resolutionUnit == 2);
+    CHECK(info.xResolution == 0.0);
+    CHECK(info.yResolution == 0.0);
+
+    // The rational values are past the end of the truncated data.
+    std::vector<uint8_t> exif = ExifBuilder(true).Build(1, 2, 96, 96, 1);
+    exif.resize(exif.size() - 16);
+    CHECK(GetExifImageInfo(exif, info));
+    CHECK(info.orientation == 1);
+    CHECK(info.xResolution == 0.0);
+}
+
+TEST_CASE(ExifReaderRejectsInvalidData)
+{
+    ExifImageInfo info;
+
+    // The IFD entries extend past the end of the data.
+    std::vector<uint8_t> truncated = ExifBuilder(false).Build(6, 2, 300, 300, 1);
+    truncated.resize(40);
+    CHECK(!GetExifImageInfo(truncated, info));
+    CHECK(info.orientation == 0);
+
+    std::vector<uint8_t> badByteOrder = ExifBuilder(false).Build(6, 2, 300, 300, 1);
+    badByteOrder[0] = 'X';
+    CHECK(!GetExifImageInfo(badByteOrder, info));
+
+    std::vector<uint8_t> badSignature = ExifBuilder(true).Build(6, 2, 300, 300, 1);
+    badSignature[3] = 43;
+    CHECK(!GetExifImageInfo(badSignature, info));
+
+    std::vector<uint8_t> badIfdOffset = ExifBuilder(false).Build(6, 2, 300, 300, 1);
+    badIfdOffset[4] = 0xff;
+    badIfdOffset[5] = 0xff;
+    CHECK(!GetExifImageInfo(badIfdOffset, info));
+}
+
+TEST_CASE(ExifReaderRequiresAnExifChunk)
+{
+    const int stride = 16 * 4;
+    const std::vector<uint8_t> pixels = CreateTestImage(16, 16, stride);
+    const std::vector<uint8_t> image = EncodeImage(pixels.data(), 16, 16, stride, CreateEncodeOptions(false), nullptr);
+
+    ExifImageInfo info;
+
+    CHECK(!WebPGetExifImageInfo(image.data(), image.size(), &info));
+    CHECK(!WebPGetExifImageInfo(image.data(), image.size(), nullptr));
+}
@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "Tests.h"
+
+namespace
+{
+    const int ImageWidth = 97;
+    const int ImageHeight = 61;
+
+    std::vector<uint8_t> savedImage;
+
+    WebPEncodingError __stdcall WriteSavedImage(const uint8_t* image, const size_t imageSize)
+    {
+        savedImage.assign(image, image + imageSize);
+
+        return VP8_ENC_OK;
+    }
+
+    struct TestMetadata
+    {
+        TestMetadata() : iccProfile(301, 0x11), exif(), xmp(57, 'x'), params()
+        {
+            const uint8_t exifHeader[] = { 'I', 'I', 42, 0, 8, 0, 0, 0, 0, 0 };
+            exif.assign(exifHeader, exifHeader + sizeof(exifHeader));
+
+            params.iccProfile = iccProfile.data();
+            params.iccProfileSize = iccProfile.size();
+            params.exif = exif.data();
+            params.exifSize = exif.size();
+            params.xmp = xmp.data();
+            params.xmpSize = xmp.size();
+        }
+
+        std::vector<uint8_t> iccProfile;
+        std::vector<uint8_t> exif;
+        std::vector<uint8_t> xmp;
+        MetadataParams params;
+    };
+}
+
+TEST_CASE(SaveToBufferMatchesWebPSave)
+{
+    const int stride = ImageWidth * 4;
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+    const TestMetadata metadata;
+
+    for (int lossless = 0; lossless < 2; lossless++)
+    {
+        for (int withMetadata = 0; withMetadata < 2; withMetadata++)
+        {
+            const EncodeParams encodeOptions = CreateEncodeOptions(lossless != 0);
+            const MetadataParams* params = withMetadata != 0 ? &metadata.params : nullptr;
+
+            CHECK(WebPSave(WriteSavedImage, pixels.data(), ImageWidth, ImageHeight, stride, &encodeOptions, params, nullptr) == VP8_ENC_OK);
+
+            const std::vector<uint8_t> buffered = EncodeImage(pixels.data(), ImageWidth, ImageHeight, stride, encodeOptions, params);
+            CHECK(!buffered.empty());
+            CHECK(buffered == savedImage);
+        }
+    }
+}
+
+TEST_CASE(SaveToBufferReportsTheRequiredSize)
+{
+    const int stride = ImageWidth * 4;
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+    const TestMetadata metadata;
+    const EncodeParams encodeOptions = CreateEncodeOptions(true);
+
+    size_t requiredSize = 0;
+    CHECK(WebPSaveToBuffer(pixels.data(), ImageWidth, ImageHeight, stride, &encodeOptions, &metadata.params, nullptr, nullptr, 0, &requiredSize) == errBufferTooSmall);
+    CHECK(requiredSize > 0);
+
+    // The bytes after the capacity must not be written when the image does not fit.
+    std::vector<uint8_t> output(requiredSize + 16, 0xcd);
+    size_t outputSize = 0;
+
+    CHECK(WebPSaveToBuffer(pixels.data(), ImageWidth, ImageHeight, stride, &encodeOptions, &metadata.params, nullptr, output.data(), requiredSize - 1, &outputSize) == errBufferTooSmall);
+    CHECK(outputSize == requiredSize);
+    CHECK(output[requiredSize - 1] == 0xcd);
+
+    CHECK(WebPSaveToBuffer(pixels.data(), ImageWidth, ImageHeight, stride, &encodeOptions, &metadata.params, nullptr, output.data(), requiredSize, &outputSize) == VP8_ENC_OK);
+    CHECK(outputSize == requiredSize);
+    CHECK(output[requiredSize] == 0xcd);
+
+    size_t errorOffset = 0;
+    CHECK(WebPValidate(output.data(), outputSize, &errorOffset) == WebPValidationOk);
+}
+
+TEST_CASE(SaveToBufferRoundTrip)
+{
+    const int stride = ImageWidth * 4 + 12;
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+    const std::vector<uint8_t> encoded = EncodeImage(pixels.data(), ImageWidth, ImageHeight, stride, CreateEncodeOptions(true), nullptr);
+    CHECK(!encoded.empty());
+
+    std::vector<uint8_t> decoded(static_cast<size_t>(stride) * ImageHeight);
+    CHECK(WebPLoad(encoded.data(), encoded.size(), decoded.data(), decoded.size(), stride) == VP8_STATUS_OK);
+    CHECK(ImagesEqual(decoded.data(), stride, pixels.data(), stride, ImageWidth, ImageHeight));
+}
+
+TEST_CASE(SaveToBufferRejectsInvalidParameters)
+{
+    const int stride = ImageWidth * 4;
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+    const EncodeParams encodeOptions = CreateEncodeOptions(false);
+
+    std::vector<uint8_t> output(65536);
+    size_t outputSize = 1;
+
+    CHECK(WebPSaveToBuffer(nullptr, ImageWidth, ImageHeight, stride, &encodeOptions, nullptr, nullptr, output.data(), output.size(), &outputSize) == VP8_ENC_ERROR_NULL_PARAMETER);
+    CHECK(WebPSaveToBuffer(pixels.data(), ImageWidth, ImageHeight, stride, &encodeOptions, nullptr, nullptr, output.data(), output.size(), nullptr) == VP8_ENC_ERROR_NULL_PARAMETER);
+
+    CHECK(WebPSaveToBuffer(pixels.data(), 0, ImageHeight, stride, &encodeOptions, nullptr, nullptr, output.data(), output.size(), &outputSize) != VP8_ENC_OK);
+    CHECK(outputSize == 0);
+}
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <string.h>
+#include "Tests.h"
+#include "LinearConversion.h"
+
+namespace
+{
+    typedef void (*ConvertRowFn)(uint8_t* row, int width, const SrgbToLinearTable& table);
+
+    // The widths cover rows that are shorter than a group of four pixels, and every remainder after the groups.
+    const int RowWidths[] = { 1, 2, 3, 4, 5, 6, 7, 8, 65539 };
+
+    // Creates a row with room for the expanded pixels, the first 65536 pixels contain every color and alpha pair.
+    std::vector<uint8_t> CreateRow(int width)
+    {
+        std::vector<uint8_t> row(static_cast<size_t>(width) * 16);
+
+        for (int x = 0; x < width; x++)
+        {
+            uint8_t* pixel = &row[static_cast<size_t>(x) * 4];
+
+            pixel[0] = static_cast<uint8_t>(x);
+            pixel[1] = static_cast<uint8_t>((x * 7) + 1);
+            pixel[2] = static_cast<uint8_t>((x * 13) + 2);
+            pixel[3] = static_cast<uint8_t>((x >> 8) + 255);
+        }
+
+        return row;
+    }
+
+    bool ConvertersMatch(ConvertRowFn expected, ConvertRowFn actual, size_t bytesPerPixel)
+    {
+        const SrgbToLinearTable& table = GetSrgbToLinearTable();
+
+        for (int width : RowWidths)
+        {
+            std::vector<uint8_t> expectedRow = CreateRow(width);
+            std::vector<uint8_t> actualRow = CreateRow(width);
+
+            expected(expectedRow.data(), width, table);
+            actual(actualRow.data(), width, table);
+
+            if (memcmp(expectedRow.data(), actualRow.data(), static_cast<size_t>(width) * bytesPerPixel) != 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+TEST_CASE(FloatToHalfRoundsToNearestEven)
+{
+    CHECK(FloatToHalf(0.0f) == 0x0000);
+    CHECK(FloatToHalf(1.0f) == 0x3c00);
+    CHECK(FloatToHalf(-1.0f) == 0xbc00);
+    CHECK(FloatToHalf(0.5f) == 0x3800);
+
+    // A value halfway between two half precision values is rounded to the one with an even mantissa.
+    CHECK(FloatToHalf(1.0f + ldexpf(1.0f, -11)) == 0x3c00);
+    CHECK(FloatToHalf(1.0f + ldexpf(3.0f, -11)) == 0x3c02);
+    CHECK(FloatToHalf(1.0f + ldexpf(1.0f, -11) + ldexpf(1.0f, -20)) == 0x3c01);
+
+    // A carry out of the mantissa increments the exponent.
+    CHECK(FloatToHalf(2.0f - ldexpf(1.0f, -12)) == 0x4000);
+}
+
+TEST_CASE(FloatToHalfConvertsSubnormals)
+{
+    CHECK(FloatToHalf(ldexpf(1.0f, -14)) == 0x0400);
+    CHECK(FloatToHalf(ldexpf(1023.0f, -24)) == 0x03ff);
+    CHECK(FloatToHalf(ldexpf(1.0f, -24)) == 0x0001);
+    CHECK(FloatToHalf(ldexpf(1.0f, -25)) == 0x0000);
+    CHECK(FloatToHalf(ldexpf(3.0f, -25)) == 0x0002);
+    CHECK(FloatToHalf(ldexpf(1.0f, -25) + ldexpf(1.0f, -40)) == 0x0001);
+    CHECK(FloatToHalf(ldexpf(1.0f, -30)) == 0x0000);
+
+    // The largest subnormal rounds up to the smallest normal value.
+    CHECK(FloatToHalf(ldexpf(2047.0f, -25)) == 0x0400);
+}
+
+TEST_CASE(FloatToHalfOverflowsToInfinity)
+{
+    CHECK(FloatToHalf(65504.0f) == 0x7bff);
+    CHECK(FloatToHalf(65519.0f) == 0x7bff);
+    CHECK(FloatToHalf(65520.0f) == 0x7c00);
+    CHECK(FloatToHalf(65536.0f) == 0x7c00);
+    CHECK(FloatToHalf(1.0e10f) == 0x7c00);
+    CHECK(FloatToHalf(-1.0e10f) == 0xfc00);
+}
+
+TEST_CASE(Float32RowIsPremultipliedLinearLight)
+{
+    const SrgbToLinearTable& table = GetSrgbToLinearTable();
+
+    uint8_t row[48] = { 255, 0, 128, 255, 255, 255, 255, 51, 10, 20, 30, 0 };
+    ConvertRowToFloat32(row, 3, table);
+
+    float pixels[12];
+    memcpy(pixels, row, sizeof(pixels));
+
+    CHECK(pixels[0] == 1.0f && pixels[1] == 0.0f && pixels[2] == table[128] && pixels[3] == 1.0f);
+    CHECK(pixels[4] == 51 * (1.0f / 255.0f) && pixels[7] == 51 * (1.0f / 255.0f));
+    CHECK(pixels[8] == 0.0f && pixels[9] == 0.0f && pixels[10] == 0.0f && pixels[11] == 0.0f);
+}
+
+#ifdef LINEAR_CONVERSION_SIMD_SUPPORTED
+TEST_CASE(Float32Sse2MatchesScalar)
+{
+    CHECK(ConvertersMatch(ConvertRowToFloat32Scalar, ConvertRowToFloat32Sse2, 16));
+}
+
+TEST_CASE(Float16HardwareMatchesSoftware)
+{
+    // The test passes without checking anything on a processor that does not support F16C.
+    if (IsF16cSupported())
+    {
+        CHECK(ConvertersMatch(ConvertRowToFloat16Software, ConvertRowToFloat16Hardware, 8));
+    }
+}
+#endif
@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "Tests.h"
+
+namespace
+{
+    const int ImageWidth = 48;
+    const int ImageHeight = 36;
+    const int ImageStride = ImageWidth * 4;
+
+    // A little-endian TIFF header with an IFD that only contains an orientation tag of 6.
+    const uint8_t ExifData[] =
+    {
+        'I', 'I', 42, 0, 8, 0, 0, 0,
+        1, 0,
+        0x12, 0x01, 3, 0, 1, 0, 0, 0, 6, 0, 0, 0,
+        0, 0, 0, 0
+    };
+
+    bool SpanEquals(const std::vector<uint8_t>& data, const MetadataSpan& span, const std::vector<uint8_t>& expected)
+    {
+        return span.size == expected.size() &&
+               span.offset <= data.size() &&
+               data.size() - span.offset >= span.size &&
+               memcmp(data.data() + span.offset, expected.data(), expected.size()) == 0;
+    }
+}
+
+TEST_CASE(LoadWithMetadataLocatesTheMetadata)
+{
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, ImageStride);
+
+    std::vector<uint8_t> iccProfile(128);
+    std::vector<uint8_t> exif(ExifData, ExifData + sizeof(ExifData));
+    std::vector<uint8_t> xmp(33);
+
+    for (size_t i = 0; i < iccProfile.size(); i++)
+    {
+        iccProfile[i] = static_cast<uint8_t>(i);
+    }
+
+    for (size_t i = 0; i < xmp.size(); i++)
+    {
+        xmp[i] = static_cast<uint8_t>('a' + (i % 26));
+    }
+
+    MetadataParams metadata;
+    metadata.iccProfile = iccProfile.data();
+    metadata.iccProfileSize = iccProfile.size();
+    metadata.exif = exif.data();
+    metadata.exifSize = exif.size();
+    metadata.xmp = xmp.data();
+    metadata.xmpSize = xmp.size();
+
+    const std::vector<uint8_t> image = EncodeImage(pixels.data(), ImageWidth, ImageHeight, ImageStride, CreateEncodeOptions(true), &metadata);
+    CHECK(!image.empty());
+
+    std::vector<uint8_t> output(static_cast<size_t>(ImageStride) * ImageHeight);
+    LoadResult result;
+
+    // The sizing call does not locate the metadata, the call that decodes the image does.
+    CHECK(WebPLoadWithMetadata(image.data(), image.size(), nullptr, 0, 0, &result) == errBufferTooSmall);
+    CHECK(result.info.width == ImageWidth);
+    CHECK(result.exif.size == 0);
+
+    CHECK(WebPLoadWithMetadata(image.data(), image.size(), output.data(), output.size() - 1, ImageStride, &result) == errBufferTooSmall);
+    CHECK(SpanEquals(image, result.exif, exif));
+
+    CHECK(WebPLoadWithMetadata(image.data(), image.size(), output.data(), output.size(), ImageStride, &result) == VP8_STATUS_OK);
+    CHECK(result.info.width == ImageWidth);
+    CHECK(result.info.height == ImageHeight);
+    CHECK(!result.info.hasAnimation);
+    CHECK(ImagesEqual(pixels.data(), ImageStride, output.data(), ImageStride, ImageWidth, ImageHeight));
+
+    CHECK(SpanEquals(image, result.iccProfile, iccProfile));
+    CHECK(SpanEquals(image, result.exif, exif));
+    CHECK(SpanEquals(image, result.xmp, xmp));
+
+    CHECK(result.exifInfo.orientation == 6);
+    CHECK(result.exifInfo.resolutionUnit == 0);
+    CHECK(result.exifInfo.xResolution == 0.0);
+}
+
+TEST_CASE(LoadWithMetadataReportsTheRequiredBuffer)
+{
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, ImageStride);
+    const std::vector<uint8_t> image = EncodeImage(pixels.data(), ImageWidth, ImageHeight, ImageStride, CreateEncodeOptions(false), nullptr);
+
+    LoadResult result;
+
+    // The first call only reads the image information.
+    CHECK(WebPLoadWithMetadata(image.data(), image.size(), nullptr, 0, 0, &result) == errBufferTooSmall);
+    CHECK(result.info.width == ImageWidth);
+    CHECK(result.info.height == ImageHeight);
+    CHECK(result.iccProfile.size == 0);
+    CHECK(result.exif.size == 0);
+    CHECK(result.xmp.size == 0);
+    CHECK(result.exifInfo.orientation == 0);
+
+    std::vector<uint8_t> output(static_cast<size_t>(ImageStride) * ImageHeight);
+
+    CHECK(WebPLoadWithMetadata(image.data(), image.size(), output.data(), output.size() - 1, ImageStride, &result) == errBufferTooSmall);
+    CHECK(WebPLoadWithMetadata(image.data(), image.size(), output.data(), output.size(), ImageStride - 4, &result) == errBufferTooSmall);
+    CHECK(WebPLoadWithMetadata(image.data(), image.size(), output.data(), output.size(), ImageStride, &result) == VP8_STATUS_OK);
+}
+
+TEST_CASE(LoadWithMetadataRejectsInvalidData)
+{
+    const uint8_t notWebP[16] = {};
+    LoadResult result;
+
+    CHECK(WebPLoadWithMetadata(notWebP, sizeof(notWebP), nullptr, 0, 0, &result) != VP8_STATUS_OK);
+    CHECK(WebPLoadWithMetadata(notWebP, sizeof(notWebP), nullptr, 0, 0, &result) != errBufferTooSmall);
+    CHECK(WebPLoadWithMetadata(nullptr, 0, nullptr, 0, 0, &result) == VP8_STATUS_INVALID_PARAM);
+    CHECK(WebPLoadWithMetadata(notWebP, sizeof(notWebP), nullptr, 0, 0, nullptr) == VP8_STATUS_INVALID_PARAM);
+}
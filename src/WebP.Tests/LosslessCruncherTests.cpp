@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "Tests.h"
+
+namespace
+{
+    const int ImageWidth = 96;
+    const int ImageHeight = 64;
+    const int ImageStride = ImageWidth * 4;
+
+    // The test image with a fully transparent band that keeps the colors of the gradient.
+    std::vector<uint8_t> CreateTransparentImage()
+    {
+        std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, ImageStride);
+
+        for (int y = ImageHeight / 4; y < ImageHeight / 2; y++)
+        {
+            uint8_t* row = pixels.data() + (static_cast<size_t>(y) * ImageStride);
+
+            for (int x = 0; x < ImageWidth; x++)
+            {
+                row[x * 4 + 3] = 0;
+            }
+        }
+
+        return pixels;
+    }
+
+    bool VisiblePixelsEqual(const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual)
+    {
+        for (size_t i = 0; i < expected.size(); i += 4)
+        {
+            if (expected[i + 3] != actual[i + 3] ||
+                (expected[i + 3] != 0 && (expected[i] != actual[i] || expected[i + 1] != actual[i + 1] || expected[i + 2] != actual[i + 2])))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+TEST_CASE(CrunchIsNotLargerThanLossless)
+{
+    const std::vector<uint8_t> pixels = CreateTransparentImage();
+
+    const std::vector<uint8_t> lossless = EncodeImage(pixels.data(), ImageWidth, ImageHeight, ImageStride, CreateEncodeOptions(true), nullptr);
+
+    EncodeParams crunchOptions = CreateEncodeOptions(true);
+    crunchOptions.crunch = true;
+
+    const std::vector<uint8_t> crunched = EncodeImage(pixels.data(), ImageWidth, ImageHeight, ImageStride, crunchOptions, nullptr);
+
+    CHECK(!lossless.empty());
+    CHECK(!crunched.empty());
+    CHECK(crunched.size() <= lossless.size());
+
+    std::vector<uint8_t> decoded(pixels.size());
+
+    CHECK(WebPLoad(crunched.data(), crunched.size(), decoded.data(), decoded.size(), ImageStride) == VP8_STATUS_OK);
+    CHECK(VisiblePixelsEqual(pixels, decoded));
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include "Tests.h"
+
+namespace
+{
+    const int ImageWidth = 128;
+    const int ImageHeight = 96;
+    const int ImageStride = ImageWidth * 4;
+
+    bool EstimateQuality(const std::vector<uint8_t>& image, QualityEstimate& estimate)
+    {
+        return WebPEstimateQuality(image.data(), image.size(), &estimate) == VP8_STATUS_OK;
+    }
+}
+
+TEST_CASE(QualityEstimateMatchesTheLossyQuality)
+{
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, ImageStride);
+    const float qualities[] = { 50.0f, 75.0f, 90.0f };
+
+    for (float quality : qualities)
+    {
+        EncodeParams encodeOptions = CreateEncodeOptions(false);
+        encodeOptions.quality = quality;
+
+        const std::vector<uint8_t> image = EncodeImage(pixels.data(), ImageWidth, ImageHeight, ImageStride, encodeOptions, nullptr);
+        QualityEstimate estimate;
+
+        CHECK(EstimateQuality(image, estimate));
+        CHECK(!estimate.lossless);
+        CHECK(fabsf(estimate.quality - quality) <= 2.0f);
+    }
+}
+
+TEST_CASE(QualityEstimateReportsLosslessImages)
+{
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, ImageStride);
+    const std::vector<uint8_t> image = EncodeImage(pixels.data(), ImageWidth, ImageHeight, ImageStride, CreateEncodeOptions(true), nullptr);
+
+    QualityEstimate estimate;
+
+    CHECK(EstimateQuality(image, estimate));
+    CHECK(estimate.lossless);
+    CHECK(estimate.quality == 100.0f);
+}
+
+TEST_CASE(QualityEstimateRejectsInvalidData)
+{
+    const uint8_t notWebP[16] = {};
+    QualityEstimate estimate;
+
+    CHECK(WebPEstimateQuality(notWebP, sizeof(notWebP), &estimate) != VP8_STATUS_OK);
+    CHECK(WebPEstimateQuality(nullptr, 0, &estimate) != VP8_STATUS_OK);
+}
@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "Tests.h"
+#include "RiffReader.h"
+
+TEST_CASE(RiffReaderReadsChunksInOrder)
+{
+    std::vector<uint8_t> data = CreateRiffHeader();
+    AppendChunk(data, "VP8X", std::vector<uint8_t>(VP8XChunkSize, 0));
+    AppendChunk(data, "ICCP", std::vector<uint8_t>(5, 1));
+    AppendChunk(data, "VP8L", std::vector<uint8_t>(6, 2));
+    UpdateRiffSize(data);
+
+    RiffChunkReader reader(data.data(), data.size());
+    RiffChunk chunk;
+
+    CHECK(reader.IsValid());
+    CHECK(!reader.IsTruncated(data.size()));
+
+    CHECK(reader.Next(chunk));
+    CHECK(chunk.fourcc == VP8XFourCC);
+    CHECK(chunk.offset == RiffHeaderSize);
+    CHECK(chunk.payloadSize == VP8XChunkSize);
+    CHECK(chunk.payload == data.data() + RiffHeaderSize + ChunkHeaderSize);
+
+    // The odd sized ICCP payload is followed by a padding byte.
+    CHECK(reader.Next(chunk));
+    CHECK(chunk.fourcc == IccpFourCC);
+    CHECK(chunk.offset == 30);
+    CHECK(chunk.payloadSize == 5);
+
+    CHECK(reader.Next(chunk));
+    CHECK(chunk.fourcc == VP8LFourCC);
+    CHECK(chunk.offset == 44);
+    CHECK(chunk.payloadSize == 6);
+    CHECK(chunk.payload[0] == 2);
+
+    CHECK(!reader.Next(chunk));
+    CHECK(!reader.HasError());
+}
+
+TEST_CASE(RiffReaderAcceptsAMissingFinalPaddingByte)
+{
+    std::vector<uint8_t> data = CreateRiffHeader();
+    AppendChunk(data, "VP8L", std::vector<uint8_t>(7, 0));
+    data.pop_back();
+    UpdateRiffSize(data);
+
+    RiffChunkReader reader(data.data(), data.size());
+    RiffChunk chunk;
+
+    CHECK(reader.Next(chunk));
+    CHECK(chunk.payloadSize == 7);
+    CHECK(!reader.Next(chunk));
+    CHECK(!reader.HasError());
+}
+
+TEST_CASE(RiffReaderIgnoresTrailingData)
+{
+    std::vector<uint8_t> data = CreateRiffHeader();
+    AppendChunk(data, "VP8 ", std::vector<uint8_t>(10, 0));
+    UpdateRiffSize(data);
+    AppendChunk(data, "EXIF", std::vector<uint8_t>(4, 0));
+
+    RiffChunkReader reader(data.data(), data.size());
+    RiffChunk chunk;
+
+    CHECK(reader.Next(chunk));
+    CHECK(chunk.fourcc == VP8FourCC);
+    CHECK(!reader.Next(chunk));
+    CHECK(!reader.HasError());
+}
+
+TEST_CASE(RiffReaderReportsOverrunningChunks)
+{
+    std::vector<uint8_t> data = CreateRiffHeader();
+    AppendChunk(data, "VP8X", std::vector<uint8_t>(VP8XChunkSize, 0));
+    AppendChunk(data, "ICCP", std::vector<uint8_t>(8, 0));
+    UpdateRiffSize(data);
+    WriteLE32(data.data() + 34, 9);
+
+    RiffChunkReader reader(data.data(), data.size());
+    RiffChunk chunk;
+
+    CHECK(reader.Next(chunk));
+    CHECK(!reader.Next(chunk));
+    CHECK(reader.HasError());
+
+    // A partial chunk header is also an error.
+    std::vector<uint8_t> partialHeader = CreateRiffHeader();
+    partialHeader.insert(partialHeader.end(), { 'V', 'P', '8' });
+    UpdateRiffSize(partialHeader);
+
+    RiffChunkReader partialReader(partialHeader.data(), partialHeader.size());
+
+    CHECK(!partialReader.Next(chunk));
+    CHECK(partialReader.HasError());
+}
+
+TEST_CASE(RiffReaderDetectsTruncatedAndInvalidFiles)
+{
+    std::vector<uint8_t> data = CreateRiffHeader();
+    AppendChunk(data, "VP8L", std::vector<uint8_t>(20, 0));
+    UpdateRiffSize(data);
+
+    const size_t truncatedSize = data.size() - 8;
+
+    RiffChunkReader reader(data.data(), truncatedSize);
+    RiffChunk chunk;
+
+    CHECK(reader.IsValid());
+    CHECK(reader.IsTruncated(truncatedSize));
+    CHECK(!reader.Next(chunk));
+    CHECK(reader.HasError());
+
+    data[8] = 'X';
+    CHECK(!RiffChunkReader(data.data(), data.size()).IsValid());
+    CHECK(!RiffChunkReader(data.data(), RiffHeaderSize - 1).IsValid());
+    CHECK(!RiffChunkReader(nullptr, 0).IsValid());
+}
+
+TEST_CASE(RiffReaderReadsNestedChunkSequences)
+{
+    std::vector<uint8_t> frame;
+    AppendChunk(frame, "ALPH", std::vector<uint8_t>(3, 0));
+    AppendChunk(frame, "VP8 ", std::vector<uint8_t>(4, 0));
+
+    RiffChunkReader reader = RiffChunkReader::ForChunkSequence(frame.data(), frame.size());
+    RiffChunk chunk;
+
+    CHECK(reader.IsValid());
+    CHECK(reader.Next(chunk));
+    CHECK(chunk.fourcc == AlphFourCC);
+    CHECK(chunk.offset == 0);
+    CHECK(reader.Next(chunk));
+    CHECK(chunk.fourcc == VP8FourCC);
+    CHECK(chunk.offset == 12);
+    CHECK(!reader.Next(chunk));
+    CHECK(!reader.HasError());
+
+    CHECK(!RiffChunkReader::ForChunkSequence(nullptr, 0).IsValid());
+}
@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+// Runs the tests of the exported functions.
+//
+// Usage: WebP.Tests [name]
+//
+// When a name is specified only the tests whose name contains it are run.
+
+#include <stdio.h>
+#include <string.h>
+#include "Tests.h"
+
+namespace
+{
+    struct TestCase
+    {
+        const char* name;
+        TestFunction function;
+    };
+
+    // The registrations run during static initialization, a function local vector is
+    // constructed before its first use regardless of the initialization order of the files.
+    std::vector<TestCase>& GetTestCases()
+    {
+        static std::vector<TestCase> testCases;
+
+        return testCases;
+    }
+
+    int failureCount = 0;
+}
+
+TestRegistration::TestRegistration(const char* name, TestFunction function)
+{
+    GetTestCases().push_back({ name, function });
+}
+
+void ReportFailure(const char* file, int line, const char* expression)
+{
+    printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+    failureCount++;
+}
+
+std::vector<uint8_t> CreateTestImage(int width, int height, int stride)
+{
+    std::vector<uint8_t> pixels(static_cast<size_t>(stride) * height, 0xcd);
+    uint32_t seed = 1;
+
+    for (int y = 0; y < height; y++)
+    {
+        uint8_t* row = pixels.data() + (static_cast<size_t>(y) * stride);
+
+        for (int x = 0; x < width; x++)
+        {
+            seed = seed * 1103515245 + 12345;
+            const int noise = (seed >> 16) & 7;
+
+            row[x * 4] = static_cast<uint8_t>((x * 255) / width + noise);
+            row[x * 4 + 1] = static_cast<uint8_t>((y * 255) / height + noise);
+            row[x * 4 + 2] = static_cast<uint8_t>(((x + y) * 255) / (width + height));
+            row[x * 4 + 3] = static_cast<uint8_t>(x < width / 2 ? 255 : 128 + (y * 127) / height);
+        }
+    }
+
+    return pixels;
+}
+
+EncodeParams CreateEncodeOptions(bool lossless)
+{
+    EncodeParams encodeOptions;
+    memset(&encodeOptions, 0, sizeof(encodeOptions));
+    encodeOptions.quality = 75;
+    encodeOptions.preset = WEBP_PRESET_DEFAULT;
+    encodeOptions.lossless = lossless;
+    encodeOptions.alphaCompression = -1;
+    encodeOptions.alphaFiltering = -1;
+    encodeOptions.alphaQuality = -1;
+    encodeOptions.method = -1;
+
+    return encodeOptions;
+}
+
+std::vector<uint8_t> EncodeImage(
+    const uint8_t* pixels,
+    int width,
+    int height,
+    int stride,
+    const EncodeParams& encodeOptions,
+    const MetadataParams* metadata)
+{
+    std::vector<uint8_t> output(static_cast<size_t>(stride) * height + 65536);
+    size_t outputSize = 0;
+
+    int error = WebPSaveToBuffer(pixels, width, height, stride, &encodeOptions, metadata, nullptr, output.data(), output.size(), &outputSize);
+
+    if (error == errBufferTooSmall)
+    {
+        output.resize(outputSize);
+        error = WebPSaveToBuffer(pixels, width, height, stride, &encodeOptions, metadata, nullptr, output.data(), output.size(), &outputSize);
+    }
+
+    if (error != VP8_ENC_OK)
+    {
+        return std::vector<uint8_t>();
+    }
+
+    output.resize(outputSize);
+
+    return output;
+}
+
+bool ImagesEqual(const uint8_t* first, int firstStride, const uint8_t* second, int secondStride, int width, int height)
+{
+    for (int y = 0; y < height; y++)
+    {
+        if (memcmp(first + (static_cast<size_t>(y) * firstStride), second + (static_cast<size_t>(y) * secondStride), static_cast<size_t>(width) * 4) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::vector<uint8_t> CreateRiffHeader()
+{
+    std::vector<uint8_t> data = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'E', 'B', 'P' };
+
+    UpdateRiffSize(data);
+
+    return data;
+}
+
+void AppendChunk(std::vector<uint8_t>& data, const char* fourcc, const std::vector<uint8_t>& payload)
+{
+    const size_t offset = data.size();
+
+    data.insert(data.end(), fourcc, fourcc + 4);
+    data.resize(offset + 8);
+    WriteLE32(data.data() + offset + 4, static_cast<uint32_t>(payload.size()));
+    data.insert(data.end(), payload.begin(), payload.end());
+
+    if ((payload.size() & 1) != 0)
+    {
+        data.push_back(0);
+    }
+}
+
+void UpdateRiffSize(std::vector<uint8_t>& data)
+{
+    WriteLE32(data.data() + 4, static_cast<uint32_t>(data.size() - 8));
+}
+
+void WriteLE32(uint8_t* data, uint32_t value)
+{
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+    data[2] = static_cast<uint8_t>(value >> 16);
+    data[3] = static_cast<uint8_t>(value >> 24);
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    int testCount = 0;
+    int failedTestCount = 0;
+
+    for (const TestCase& testCase : GetTestCases())
+    {
+        if (filter != nullptr && strstr(testCase.name, filter) == nullptr)
+        {
+            continue;
+        }
+
+        const int previousFailureCount = failureCount;
+
+        testCase.function();
+        testCount++;
+
+        if (failureCount != previousFailureCount)
+        {
+            printf("[ FAILED ] %s\n", testCase.name);
+            failedTestCount++;
+        }
+        else
+        {
+            printf("[ PASSED ] %s\n", testCase.name);
+        }
+    }
+
+    printf("%d of %d tests passed\n", testCount - failedTestCount, testCount);
+
+    return failedTestCount == 0 ? 0 : 1;
+}
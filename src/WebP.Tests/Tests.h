@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "WebP.h"
+
+// The tests are registered by TEST_CASE and run by WebP.Tests.exe, which returns a non-zero exit code
+// if any check failed. A check failure is reported and the test continues, so one run lists every failure.
+
+typedef void (*TestFunction)();
+
+class TestRegistration
+{
+public:
+    TestRegistration(const char* name, TestFunction function);
+};
+
+void ReportFailure(const char* file, int line, const char* expression);
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static TestRegistration name##Registration(#name, name); \
+    static void name()
+
+#define CHECK(expression) \
+    do \
+    { \
+        if (!(expression)) \
+        { \
+            ReportFailure(__FILE__, __LINE__, #expression); \
+        } \
+    } while (false)
+
+// Creates a BGRA image with gradients, noise and partial transparency. The padding at the end
+// of each row is filled with a marker value, so a test can detect a write outside of the image.
+std::vector<uint8_t> CreateTestImage(int width, int height, int stride);
+
+// Returns encoder options that use the default preset, and the lossless or lossy encoder.
+EncodeParams CreateEncodeOptions(bool lossless);
+
+// Encodes the image with WebPSaveToBuffer, the result is empty if the image could not be saved.
+std::vector<uint8_t> EncodeImage(
+    const uint8_t* pixels,
+    int width,
+    int height,
+    int stride,
+    const EncodeParams& encodeOptions,
+    const MetadataParams* metadata);
+
+// Compares the width * 4 bytes of each row in two BGRA images that may use different strides.
+bool ImagesEqual(const uint8_t* first, int firstStride, const uint8_t* second, int secondStride, int width, int height);
+
+// Creates the 12 byte header of a WebP RIFF container, UpdateRiffSize sets the size after the chunks have been added.
+std::vector<uint8_t> CreateRiffHeader();
+
+// Appends a chunk and its padding byte.
+void AppendChunk(std::vector<uint8_t>& data, const char* fourcc, const std::vector<uint8_t>& payload);
+
+void UpdateRiffSize(std::vector<uint8_t>& data);
+
+void WriteLE32(uint8_t* data, uint32_t value);
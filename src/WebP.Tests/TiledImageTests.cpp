@@ -0,0 +1,267 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "Tests.h"
+
+namespace
+{
+    // The image size is not a multiple of the tile size, so the right and bottom tiles are partial.
+    const int ImageWidth = 150;
+    const int ImageHeight = 100;
+    const int TileWidth = 64;
+    const int TileHeight = 48;
+    const int TileStride = TileWidth * 4 + 16;
+
+    std::vector<uint8_t> savedImage;
+
+    WebPEncodingError __stdcall WriteSavedImage(const uint8_t* image, const size_t imageSize)
+    {
+        savedImage.assign(image, image + imageSize);
+
+        return VP8_ENC_OK;
+    }
+
+    class TileGrid
+    {
+    public:
+        TileGrid(int width, int height, int tileHeight = TileHeight) : tiles(), pointers(), layout()
+        {
+            layout.tileWidth = TileWidth;
+            layout.tileHeight = tileHeight;
+            layout.tileStride = TileStride;
+            layout.gridWidth = (width + TileWidth - 1) / TileWidth;
+            layout.gridHeight = (height + tileHeight - 1) / tileHeight;
+
+            tiles.resize(static_cast<size_t>(layout.gridWidth) * layout.gridHeight, std::vector<uint8_t>(static_cast<size_t>(TileStride) * tileHeight, 0xcd));
+
+            for (std::vector<uint8_t>& tile : tiles)
+            {
+                pointers.push_back(tile.data());
+            }
+
+            layout.tiles = pointers.data();
+        }
+
+        const TileLayout& GetLayout() const
+        {
+            return layout;
+        }
+
+        const uint8_t* GetPixel(int x, int y) const
+        {
+            const std::vector<uint8_t>& tile = tiles[static_cast<size_t>(y / layout.tileHeight) * layout.gridWidth + (x / TileWidth)];
+
+            return tile.data() + (static_cast<size_t>(y % layout.tileHeight) * TileStride) + (static_cast<size_t>(x % TileWidth) * 4);
+        }
+
+        uint8_t* GetPixel(int x, int y)
+        {
+            return const_cast<uint8_t*>(static_cast<const TileGrid*>(this)->GetPixel(x, y));
+        }
+
+    private:
+        std::vector<std::vector<uint8_t>> tiles;
+        std::vector<uint8_t*> pointers;
+        TileLayout layout;
+    };
+
+    bool TilesMatchImage(const TileGrid& grid, const uint8_t* pixels, int stride)
+    {
+        for (int y = 0; y < ImageHeight; y++)
+        {
+            for (int x = 0; x < ImageWidth; x++)
+            {
+                if (memcmp(grid.GetPixel(x, y), pixels + (static_cast<size_t>(y) * stride) + (static_cast<size_t>(x) * 4), 4) != 0)
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void CopyImageToTiles(const uint8_t* pixels, int stride, TileGrid& grid)
+    {
+        for (int y = 0; y < ImageHeight; y++)
+        {
+            for (int x = 0; x < ImageWidth; x++)
+            {
+                memcpy(grid.GetPixel(x, y), pixels + (static_cast<size_t>(y) * stride) + (static_cast<size_t>(x) * 4), 4);
+            }
+        }
+    }
+}
+
+TEST_CASE(TiledLoadMatchesLinearLoad)
+{
+    const int stride = ImageWidth * 4;
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+
+    for (int lossless = 0; lossless < 2; lossless++)
+    {
+        const std::vector<uint8_t> encoded = EncodeImage(pixels.data(), ImageWidth, ImageHeight, stride, CreateEncodeOptions(lossless != 0), nullptr);
+        CHECK(!encoded.empty());
+
+        std::vector<uint8_t> decoded(static_cast<size_t>(stride) * ImageHeight);
+        CHECK(WebPLoad(encoded.data(), encoded.size(), decoded.data(), decoded.size(), stride) == VP8_STATUS_OK);
+
+        TileGrid grid(ImageWidth, ImageHeight);
+        CHECK(WebPLoadTiled(encoded.data(), encoded.size(), &grid.GetLayout()) == VP8_STATUS_OK);
+        CHECK(TilesMatchImage(grid, decoded.data(), stride));
+    }
+}
+
+TEST_CASE(TiledLoadLeavesTilePaddingUnchanged)
+{
+    const int stride = ImageWidth * 4;
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+    const std::vector<uint8_t> encoded = EncodeImage(pixels.data(), ImageWidth, ImageHeight, stride, CreateEncodeOptions(true), nullptr);
+
+    TileGrid grid(ImageWidth, ImageHeight);
+    CHECK(WebPLoadTiled(encoded.data(), encoded.size(), &grid.GetLayout()) == VP8_STATUS_OK);
+
+    // The last tile column is 22 pixels wide and the last tile row is 4 pixels high.
+    CHECK(grid.GetPixel(ImageWidth, 0)[0] == 0xcd);
+    CHECK(grid.GetPixel(0, ImageHeight)[0] == 0xcd);
+    CHECK(grid.GetPixel(TileWidth * 3 - 1, TileHeight * 3 - 1)[3] == 0xcd);
+}
+
+TEST_CASE(TiledSaveMatchesLinearSave)
+{
+    const int stride = ImageWidth * 4 + 8;
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+
+    TileGrid grid(ImageWidth, ImageHeight);
+    CopyImageToTiles(pixels.data(), stride, grid);
+
+    for (int lossless = 0; lossless < 2; lossless++)
+    {
+        const EncodeParams encodeOptions = CreateEncodeOptions(lossless != 0);
+
+        CHECK(WebPSave(WriteSavedImage, pixels.data(), ImageWidth, ImageHeight, stride, &encodeOptions, nullptr, nullptr) == VP8_ENC_OK);
+        const std::vector<uint8_t> linearImage = savedImage;
+
+        CHECK(WebPSaveTiled(WriteSavedImage, &grid.GetLayout(), ImageWidth, ImageHeight, &encodeOptions, nullptr, nullptr) == VP8_ENC_OK);
+        CHECK(!savedImage.empty());
+        CHECK(savedImage == linearImage);
+    }
+}
+
+TEST_CASE(TiledLossySaveMatchesLinearSaveForEveryBand)
+{
+    const int stride = ImageWidth * 4;
+    std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+
+    // The lossy tiled save converts the image one band of rows at a time, the bottom half is opaque
+    // so some bands have no alpha plane of their own.
+    for (int y = ImageHeight / 2; y < ImageHeight; y++)
+    {
+        for (int x = 0; x < ImageWidth; x++)
+        {
+            pixels[(static_cast<size_t>(y) * stride) + (static_cast<size_t>(x) * 4) + 3] = 255;
+        }
+    }
+
+    const EncodeParams encodeOptions = CreateEncodeOptions(false);
+
+    CHECK(WebPSave(WriteSavedImage, pixels.data(), ImageWidth, ImageHeight, stride, &encodeOptions, nullptr, nullptr) == VP8_ENC_OK);
+    const std::vector<uint8_t> linearImage = savedImage;
+
+    // An odd tile height does not line up with the chroma rows.
+    const int tileHeights[] = { 1, 7, TileHeight, ImageHeight };
+
+    for (int tileHeight : tileHeights)
+    {
+        TileGrid grid(ImageWidth, ImageHeight, tileHeight);
+        CopyImageToTiles(pixels.data(), stride, grid);
+
+        CHECK(WebPSaveTiled(WriteSavedImage, &grid.GetLayout(), ImageWidth, ImageHeight, &encodeOptions, nullptr, nullptr) == VP8_ENC_OK);
+        CHECK(savedImage == linearImage);
+    }
+}
+
+TEST_CASE(TiledSaveAndLoadRoundTrip)
+{
+    const int stride = ImageWidth * 4;
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+
+    TileGrid input(ImageWidth, ImageHeight);
+    CopyImageToTiles(pixels.data(), stride, input);
+
+    const EncodeParams encodeOptions = CreateEncodeOptions(true);
+    CHECK(WebPSaveTiled(WriteSavedImage, &input.GetLayout(), ImageWidth, ImageHeight, &encodeOptions, nullptr, nullptr) == VP8_ENC_OK);
+
+    ImageInfo info;
+    CHECK(WebPGetImageInfo(savedImage.data(), savedImage.size(), &info) == VP8_STATUS_OK);
+    CHECK(info.width == ImageWidth && info.height == ImageHeight);
+
+    TileGrid output(ImageWidth, ImageHeight);
+    CHECK(WebPLoadTiled(savedImage.data(), savedImage.size(), &output.GetLayout()) == VP8_STATUS_OK);
+    CHECK(TilesMatchImage(output, pixels.data(), stride));
+}
+
+TEST_CASE(TileGridMismatchIsRejected)
+{
+    const int stride = ImageWidth * 4;
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+    const std::vector<uint8_t> encoded = EncodeImage(pixels.data(), ImageWidth, ImageHeight, stride, CreateEncodeOptions(true), nullptr);
+    const EncodeParams encodeOptions = CreateEncodeOptions(true);
+
+    TileGrid grid(ImageWidth, ImageHeight);
+
+    TileLayout tooNarrow = grid.GetLayout();
+    tooNarrow.gridWidth--;
+
+    TileLayout tooShort = grid.GetLayout();
+    tooShort.gridHeight--;
+
+    TileLayout tooWide = grid.GetLayout();
+    tooWide.gridWidth++;
+
+    CHECK(WebPLoadTiled(encoded.data(), encoded.size(), &tooNarrow) == VP8_STATUS_INVALID_PARAM);
+    CHECK(WebPLoadTiled(encoded.data(), encoded.size(), &tooShort) == VP8_STATUS_INVALID_PARAM);
+    CHECK(WebPLoadTiled(encoded.data(), encoded.size(), &tooWide) == VP8_STATUS_INVALID_PARAM);
+
+    CHECK(WebPSaveTiled(WriteSavedImage, &tooNarrow, ImageWidth, ImageHeight, &encodeOptions, nullptr, nullptr) == VP8_ENC_ERROR_BAD_DIMENSION);
+    CHECK(WebPSaveTiled(WriteSavedImage, &tooShort, ImageWidth, ImageHeight, &encodeOptions, nullptr, nullptr) == VP8_ENC_ERROR_BAD_DIMENSION);
+    CHECK(WebPSaveTiled(WriteSavedImage, &tooWide, ImageWidth, ImageHeight, &encodeOptions, nullptr, nullptr) == VP8_ENC_ERROR_BAD_DIMENSION);
+}
+
+TEST_CASE(InvalidTileLayoutIsRejected)
+{
+    const int stride = ImageWidth * 4;
+    const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+    const std::vector<uint8_t> encoded = EncodeImage(pixels.data(), ImageWidth, ImageHeight, stride, CreateEncodeOptions(true), nullptr);
+    const EncodeParams encodeOptions = CreateEncodeOptions(true);
+
+    TileGrid grid(ImageWidth, ImageHeight);
+
+    TileLayout noTiles = grid.GetLayout();
+    noTiles.tiles = nullptr;
+
+    TileLayout strideTooSmall = grid.GetLayout();
+    strideTooSmall.tileStride = TileWidth * 4 - 1;
+
+    TileLayout emptyGrid = grid.GetLayout();
+    emptyGrid.gridWidth = 0;
+
+    CHECK(WebPLoadTiled(encoded.data(), encoded.size(), nullptr) == VP8_STATUS_INVALID_PARAM);
+    CHECK(WebPLoadTiled(encoded.data(), encoded.size(), &noTiles) == VP8_STATUS_INVALID_PARAM);
+    CHECK(WebPLoadTiled(encoded.data(), encoded.size(), &strideTooSmall) == VP8_STATUS_INVALID_PARAM);
+    CHECK(WebPLoadTiled(encoded.data(), encoded.size(), &emptyGrid) == VP8_STATUS_INVALID_PARAM);
+    CHECK(WebPLoadTiled(nullptr, 0, &grid.GetLayout()) == VP8_STATUS_INVALID_PARAM);
+
+    CHECK(WebPSaveTiled(WriteSavedImage, &noTiles, ImageWidth, ImageHeight, &encodeOptions, nullptr, nullptr) == VP8_ENC_ERROR_NULL_PARAMETER);
+    CHECK(WebPSaveTiled(WriteSavedImage, &strideTooSmall, ImageWidth, ImageHeight, &encodeOptions, nullptr, nullptr) == VP8_ENC_ERROR_NULL_PARAMETER);
+}
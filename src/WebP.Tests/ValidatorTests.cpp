@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "Tests.h"
+
+namespace
+{
+    const int ImageWidth = 40;
+    const int ImageHeight = 30;
+
+    // Returns the offset of the first top-level chunk with the specified FourCC, or 0 if it is not present.
+    size_t FindChunk(const std::vector<uint8_t>& data, const char* fourcc)
+    {
+        size_t offset = 12;
+
+        while (offset + 8 <= data.size())
+        {
+            if (memcmp(data.data() + offset, fourcc, 4) == 0)
+            {
+                return offset;
+            }
+
+            const uint32_t payloadSize = data[offset + 4] | (data[offset + 5] << 8) | (data[offset + 6] << 16) | (static_cast<uint32_t>(data[offset + 7]) << 24);
+
+            offset += 8 + payloadSize + (payloadSize & 1);
+        }
+
+        return 0;
+    }
+
+    // Encodes a lossy image with an alpha channel and every metadata type, which is saved in the extended format.
+    std::vector<uint8_t> CreateExtendedFile()
+    {
+        const int stride = ImageWidth * 4;
+        const std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+
+        std::vector<uint8_t> iccProfile(64, 1);
+        std::vector<uint8_t> exif(16, 2);
+        std::vector<uint8_t> xmp(9, 3);
+
+        MetadataParams metadata;
+        metadata.iccProfile = iccProfile.data();
+        metadata.iccProfileSize = iccProfile.size();
+        metadata.exif = exif.data();
+        metadata.exifSize = exif.size();
+        metadata.xmp = xmp.data();
+        metadata.xmpSize = xmp.size();
+
+        return EncodeImage(pixels.data(), ImageWidth, ImageHeight, stride, CreateEncodeOptions(false), &metadata);
+    }
+
+    std::vector<uint8_t> CreateSimpleFile(bool lossless)
+    {
+        const int stride = ImageWidth * 4;
+        std::vector<uint8_t> pixels = CreateTestImage(ImageWidth, ImageHeight, stride);
+
+        // An opaque image without metadata is saved in the simple format.
+        for (size_t i = 3; i < pixels.size(); i += 4)
+        {
+            pixels[i] = 255;
+        }
+
+        return EncodeImage(pixels.data(), ImageWidth, ImageHeight, stride, CreateEncodeOptions(lossless), nullptr);
+    }
+
+    int Validate(const std::vector<uint8_t>& data, size_t& errorOffset)
+    {
+        errorOffset = SIZE_MAX;
+
+        return WebPValidate(data.data(), data.size(), &errorOffset);
+    }
+}
+
+TEST_CASE(ValidatorAcceptsEncodedImages)
+{
+    size_t errorOffset;
+
+    const std::vector<uint8_t> lossy = CreateSimpleFile(false);
+    CHECK(FindChunk(lossy, "VP8 ") == 12);
+    CHECK(Validate(lossy, errorOffset) == WebPValidationOk);
+
+    const std::vector<uint8_t> lossless = CreateSimpleFile(true);
+    CHECK(FindChunk(lossless, "VP8L") == 12);
+    CHECK(Validate(lossless, errorOffset) == WebPValidationOk);
+
+    const std::vector<uint8_t> extended = CreateExtendedFile();
+    CHECK(FindChunk(extended, "VP8X") == 12);
+    CHECK(FindChunk(extended, "ALPH") != 0);
+    CHECK(FindChunk(extended, "ICCP") != 0);
+    CHECK(Validate(extended, errorOffset) == WebPValidationOk);
+}
+
+TEST_CASE(ValidatorAcceptsUnknownChunksAndTrailingData)
+{
+    size_t errorOffset;
+
+    std::vector<uint8_t> data = CreateSimpleFile(false);
+    AppendChunk(data, "abcd", std::vector<uint8_t>(3, 0));
+    UpdateRiffSize(data);
+
+    // The data after the RIFF size is not part of the file.
+    data.insert(data.end(), 7, 0xff);
+
+    CHECK(Validate(data, errorOffset) == WebPValidationOk);
+}
+
+TEST_CASE(ValidatorRejectsContainerErrors)
+{
+    size_t errorOffset;
+
+    std::vector<uint8_t> notWebP = CreateSimpleFile(false);
+    memcpy(notWebP.data() + 8, "WAVE", 4);
+    CHECK(Validate(notWebP, errorOffset) == WebPValidationNotWebP);
+    CHECK(errorOffset == 0);
+
+    const std::vector<uint8_t> tooShort = { 'R', 'I', 'F', 'F' };
+    CHECK(Validate(tooShort, errorOffset) == WebPValidationNotWebP);
+    CHECK(WebPValidate(nullptr, 0, &errorOffset) == WebPValidationNotWebP);
+
+    std::vector<uint8_t> badRiffSize = CreateSimpleFile(false);
+    WriteLE32(badRiffSize.data() + 4, 4);
+    CHECK(Validate(badRiffSize, errorOffset) == WebPValidationBadRiffSize);
+    CHECK(errorOffset == 4);
+
+    std::vector<uint8_t> truncated = CreateSimpleFile(false);
+    truncated.resize(truncated.size() - 10);
+    CHECK(Validate(truncated, errorOffset) == WebPValidationTruncated);
+    CHECK(errorOffset == truncated.size());
+
+    std::vector<uint8_t> badChunkSize = CreateSimpleFile(true);
+    WriteLE32(badChunkSize.data() + 16, static_cast<uint32_t>(badChunkSize.size()));
+    CHECK(Validate(badChunkSize, errorOffset) == WebPValidationBadChunkSize);
+    CHECK(errorOffset == 12);
+}
+
+TEST_CASE(ValidatorRejectsChunkErrors)
+{
+    size_t errorOffset;
+
+    // The simple format cannot contain metadata chunks.
+    std::vector<uint8_t> unexpected = CreateSimpleFile(false);
+    const size_t exifOffset = unexpected.size();
+    AppendChunk(unexpected, "EXIF", std::vector<uint8_t>(4, 0));
+    UpdateRiffSize(unexpected);
+    CHECK(Validate(unexpected, errorOffset) == WebPValidationUnexpectedChunk);
+    CHECK(errorOffset == exifOffset);
+
+    std::vector<uint8_t> missingImage = CreateRiffHeader();
+    AppendChunk(missingImage, "VP8X", std::vector<uint8_t>(10, 0));
+    UpdateRiffSize(missingImage);
+    CHECK(Validate(missingImage, errorOffset) == WebPValidationMissingImage);
+
+    std::vector<uint8_t> badVP8 = CreateSimpleFile(false);
+    badVP8[20 + 3] = 0;
+    CHECK(Validate(badVP8, errorOffset) == WebPValidationBadVP8Header);
+    CHECK(errorOffset == 12);
+
+    std::vector<uint8_t> badVP8L = CreateSimpleFile(true);
+    badVP8L[20] = 0;
+    CHECK(Validate(badVP8L, errorOffset) == WebPValidationBadVP8LHeader);
+    CHECK(errorOffset == 12);
+}
+
+TEST_CASE(ValidatorRejectsVP8XErrors)
+{
+    size_t errorOffset;
+
+    const std::vector<uint8_t> extended = CreateExtendedFile();
+    const size_t flagsOffset = 20;
+
+    std::vector<uint8_t> reservedFlag = extended;
+    reservedFlag[flagsOffset] |= 0x01;
+    CHECK(Validate(reservedFlag, errorOffset) == WebPValidationBadVP8X);
+    CHECK(errorOffset == 12);
+
+    // The ICC profile flag is 0x20.
+    std::vector<uint8_t> flagMismatch = extended;
+    flagMismatch[flagsOffset] &= ~0x20;
+    CHECK(Validate(flagMismatch, errorOffset) == WebPValidationFlagMismatch);
+
+    // The canvas width is stored as width - 1 in the 24 bits after the flags.
+    std::vector<uint8_t> dimensionMismatch = extended;
+    dimensionMismatch[flagsOffset + 4]++;
+    CHECK(Validate(dimensionMismatch, errorOffset) == WebPValidationDimensionMismatch);
+}
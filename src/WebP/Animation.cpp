@@ -0,0 +1,368 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Animation.h"
+#include "scoped.h"
+#include "ImageMemory.h"
+#include "WorkerPool.h"
+
+namespace
+{
+    // The memory that may be used by the frames that are decoded ahead of the compositor.
+    const uint64_t DecodeAheadMemoryBudget = 256 * 1024 * 1024;
+
+    struct DecodedFrame
+    {
+        DecodedFrame() : pixels(), x(0), y(0), width(0), height(0), duration(0),
+            dispose(WEBP_MUX_DISPOSE_NONE), blend(WEBP_MUX_BLEND), hasAlpha(false), status(VP8_STATUS_OK), decoded(false)
+        {
+        }
+
+        ScopedImageMemory pixels;
+        int x;
+        int y;
+        int width;
+        int height;
+        int duration;
+        WebPMuxAnimDispose dispose;
+        WebPMuxAnimBlend blend;
+        bool hasAlpha;
+        VP8StatusCode status;
+        bool decoded;
+    };
+
+    struct AnimationDecodeState
+    {
+        AnimationDecodeState(const WebPDemuxer* demux, int frameCount)
+            : demux(demux), frames(frameCount), cancelled(false), mutex(), frameDecoded()
+        {
+        }
+
+        const WebPDemuxer* demux;
+        std::vector<DecodedFrame> frames;
+        std::atomic<bool> cancelled;
+        std::mutex mutex;
+        std::condition_variable frameDecoded;
+    };
+
+    VP8StatusCode DecodeFrameBitstream(const WebPIterator& iter, DecodedFrame& frame)
+    {
+        WebPDecoderConfig config;
+
+        if (!WebPInitDecoderConfig(&config))
+        {
+            return VP8_STATUS_INVALID_PARAM;
+        }
+
+        const size_t stride = static_cast<size_t>(iter.width) * 4;
+        const size_t size = stride * iter.height;
+
+        frame.pixels.reset(static_cast<uint8_t*>(AllocateImageMemory(size)));
+        if (frame.pixels == nullptr)
+        {
+            return VP8_STATUS_OUT_OF_MEMORY;
+        }
+
+        config.output.colorspace = MODE_BGRA;
+        config.output.is_external_memory = 1;
+        config.output.u.RGBA.rgba = frame.pixels.get();
+        config.output.u.RGBA.size = size;
+        config.output.u.RGBA.stride = static_cast<int>(stride);
+
+        VP8StatusCode status = WebPDecode(iter.fragment.bytes, iter.fragment.size, &config);
+
+        WebPFreeDecBuffer(&config.output);
+
+        return status;
+    }
+
+    // Decodes a single frame, the demuxer is only read so the frames can be decoded concurrently.
+    void DecodeFrame(AnimationDecodeState* state, int index)
+    {
+        DecodedFrame& frame = state->frames[index];
+        VP8StatusCode status = VP8_STATUS_USER_ABORT;
+
+        if (!state->cancelled.load())
+        {
+            WebPIterator iter;
+
+            if (WebPDemuxGetFrame(state->demux, index + 1, &iter))
+            {
+                frame.x = iter.x_offset;
+                frame.y = iter.y_offset;
+                frame.width = iter.width;
+                frame.height = iter.height;
+                frame.duration = iter.duration;
+                frame.dispose = iter.dispose_method;
+                frame.blend = iter.blend_method;
+                frame.hasAlpha = iter.has_alpha != 0;
+
+                status = DecodeFrameBitstream(iter, frame);
+
+                WebPDemuxReleaseIterator(&iter);
+            }
+            else
+            {
+                status = VP8_STATUS_BITSTREAM_ERROR;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        frame.status = status;
+        frame.decoded = true;
+        state->frameDecoded.notify_all();
+    }
+
+    void WaitForFrame(AnimationDecodeState* state, TaskGroup& group, int index)
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+
+        while (!state->frames[index].decoded)
+        {
+            // Help with the queued frames instead of blocking, the frame that is being
+            // waited on may still be in the queue when the pool is busy.
+            lock.unlock();
+            const bool ranJob = group.TryRunPendingJob();
+            lock.lock();
+
+            // Every frame has been started when there is no job to run, the thread that is decoding
+            // the frame notifies the condition variable while it holds the mutex.
+            if (!ranJob && !state->frames[index].decoded)
+            {
+                state->frameDecoded.wait(lock);
+            }
+        }
+    }
+
+    // Blends a non-premultiplied BGRA pixel over the canvas pixel, as described in the WebP container specification.
+    inline void BlendPixel(const uint8_t* src, uint8_t* dst)
+    {
+        const uint32_t srcAlpha = src[3];
+
+        if (srcAlpha == 255)
+        {
+            memcpy(dst, src, 4);
+        }
+        else if (srcAlpha != 0)
+        {
+            const uint32_t dstAlpha = (dst[3] * (255 - srcAlpha) + 127) / 255;
+            const uint32_t blendAlpha = srcAlpha + dstAlpha;
+
+            for (int i = 0; i < 3; i++)
+            {
+                dst[i] = static_cast<uint8_t>((src[i] * srcAlpha + dst[i] * dstAlpha + (blendAlpha / 2)) / blendAlpha);
+            }
+
+            dst[3] = static_cast<uint8_t>(blendAlpha);
+        }
+    }
+
+    void CompositeFrame(const DecodedFrame& frame, uint8_t* canvas, int canvasStride)
+    {
+        const size_t rowSize = static_cast<size_t>(frame.width) * 4;
+        const bool blend = frame.blend == WEBP_MUX_BLEND && frame.hasAlpha;
+
+        for (int y = 0; y < frame.height; y++)
+        {
+            const uint8_t* src = frame.pixels.get() + (rowSize * y);
+            uint8_t* dst = canvas + (static_cast<int64_t>(frame.y + y) * canvasStride) + (static_cast<int64_t>(frame.x) * 4);
+
+            if (blend)
+            {
+                for (int x = 0; x < frame.width; x++)
+                {
+                    BlendPixel(src, dst);
+                    src += 4;
+                    dst += 4;
+                }
+            }
+            else
+            {
+                memcpy(dst, src, rowSize);
+            }
+        }
+    }
+
+    void DisposeFrame(const DecodedFrame& frame, uint8_t* canvas, int canvasStride)
+    {
+        if (frame.dispose == WEBP_MUX_DISPOSE_BACKGROUND)
+        {
+            // The background color in the ANIM chunk is only a hint, the canvas is cleared
+            // to transparent in the same way as the libwebp animation decoder.
+            for (int y = 0; y < frame.height; y++)
+            {
+                uint8_t* dst = canvas + (static_cast<int64_t>(frame.y + y) * canvasStride) + (static_cast<int64_t>(frame.x) * 4);
+
+                memset(dst, 0, static_cast<size_t>(frame.width) * 4);
+            }
+        }
+    }
+}
+
+VP8StatusCode CompositeAnimationFrames(
+    const WebPDemuxer* demux,
+    uint8_t* canvas,
+    int canvasStride,
+    int firstFrame,
+    int lastFrame,
+    AnimationFrameFn frameCallback)
+{
+    const int canvasWidth = static_cast<int>(WebPDemuxGetI(demux, WEBP_FF_CANVAS_WIDTH));
+    const int canvasHeight = static_cast<int>(WebPDemuxGetI(demux, WEBP_FF_CANVAS_HEIGHT));
+    const int endFrame = lastFrame + 1;
+
+    for (int y = 0; y < canvasHeight; y++)
+    {
+        memset(canvas + (static_cast<int64_t>(y) * canvasStride), 0, static_cast<size_t>(canvasWidth) * 4);
+    }
+
+    WorkerPool& pool = WorkerPool::GetInstance();
+
+    // Only blending and disposal depend on the previous frames, so the frame bitstreams are
+    // decoded concurrently and composited in order on this thread.
+    // The number of frames that are decoded ahead of the compositor is limited to bound the
+    // memory that is used by frames which are waiting to be composited, a frame is never
+    // larger than the canvas.
+    const uint64_t canvasSize = static_cast<uint64_t>(canvasWidth) * canvasHeight * 4;
+    const uint64_t budgetFrames = canvasSize > 0 ? DecodeAheadMemoryBudget / canvasSize : 1;
+    const int decodeWindow = static_cast<int>(std::max<uint64_t>(1, std::min<uint64_t>(budgetFrames, static_cast<uint64_t>(pool.GetWorkerCount()) * 2)));
+
+    // The state is indexed by the frame number, the entries before the first frame are not used.
+    AnimationDecodeState state(demux, endFrame);
+    VP8StatusCode status = VP8_STATUS_OK;
+
+    {
+        // The group must be destroyed before the state, the destructor waits for the queued frames.
+        TaskGroup group;
+        int submitted = firstFrame;
+
+        for (int i = firstFrame; i < endFrame; i++)
+        {
+            while (submitted < endFrame && submitted < i + decodeWindow)
+            {
+                const int index = submitted++;
+                AnimationDecodeState* statePtr = &state;
+
+                group.Run([statePtr, index]()
+                {
+                    DecodeFrame(statePtr, index);
+                });
+            }
+
+            WaitForFrame(&state, group, i);
+
+            DecodedFrame& frame = state.frames[i];
+
+            status = frame.status;
+            if (status != VP8_STATUS_OK)
+            {
+                break;
+            }
+
+            if (i > firstFrame)
+            {
+                DisposeFrame(state.frames[i - 1], canvas, canvasStride);
+                state.frames[i - 1].pixels.reset();
+            }
+
+            CompositeFrame(frame, canvas, canvasStride);
+
+            if (frameCallback != nullptr && !frameCallback(i, frame.duration))
+            {
+                status = VP8_STATUS_USER_ABORT;
+                break;
+            }
+        }
+
+        if (status != VP8_STATUS_OK)
+        {
+            state.cancelled.store(true);
+        }
+    }
+
+    return status;
+}
+
+bool IsKeyFrame(const WebPDemuxer* demux, int frameIndex)
+{
+    if (frameIndex == 0)
+    {
+        return true;
+    }
+
+    const int canvasWidth = static_cast<int>(WebPDemuxGetI(demux, WEBP_FF_CANVAS_WIDTH));
+    const int canvasHeight = static_cast<int>(WebPDemuxGetI(demux, WEBP_FF_CANVAS_HEIGHT));
+
+    WebPIterator iter;
+    bool keyFrame = false;
+
+    if (WebPDemuxGetFrame(demux, frameIndex + 1, &iter))
+    {
+        const bool coversCanvas = iter.x_offset == 0 && iter.y_offset == 0 && iter.width == canvasWidth && iter.height == canvasHeight;
+
+        keyFrame = coversCanvas && (!iter.has_alpha || iter.blend_method == WEBP_MUX_NO_BLEND);
+
+        // A frame is drawn on a transparent canvas when the previous frame covered the canvas and was disposed.
+        if (!keyFrame && WebPDemuxPrevFrame(&iter))
+        {
+            keyFrame = iter.dispose_method == WEBP_MUX_DISPOSE_BACKGROUND &&
+                       iter.x_offset == 0 && iter.y_offset == 0 && iter.width == canvasWidth && iter.height == canvasHeight;
+        }
+
+        WebPDemuxReleaseIterator(&iter);
+    }
+
+    return keyFrame;
+}
+
+int __stdcall WebPLoadAnimation(
+    const uint8_t* data,
+    size_t dataSize,
+    uint8_t* canvas,
+    size_t canvasSize,
+    int canvasStride,
+    AnimationFrameFn frameCallback)
+{
+    if (data == nullptr || canvas == nullptr || frameCallback == nullptr)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    WebPData webpData;
+    webpData.bytes = data;
+    webpData.size = dataSize;
+
+    ScopedWebPDemuxer demux(WebPDemux(&webpData));
+    if (demux == nullptr)
+    {
+        return VP8_STATUS_BITSTREAM_ERROR;
+    }
+
+    const int canvasWidth = static_cast<int>(WebPDemuxGetI(demux.get(), WEBP_FF_CANVAS_WIDTH));
+    const int canvasHeight = static_cast<int>(WebPDemuxGetI(demux.get(), WEBP_FF_CANVAS_HEIGHT));
+    const int frameCount = static_cast<int>(WebPDemuxGetI(demux.get(), WEBP_FF_FRAME_COUNT));
+
+    if (canvasStride < 0 ||
+        static_cast<int64_t>(canvasStride) < static_cast<int64_t>(canvasWidth) * 4 ||
+        canvasSize < (static_cast<size_t>(canvasStride) * (canvasHeight - 1)) + (static_cast<size_t>(canvasWidth) * 4))
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    return CompositeAnimationFrames(demux.get(), canvas, canvasStride, 0, frameCount - 1, frameCallback);
+}
@@ -0,0 +1,29 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WebP.h"
+
+// Clears the canvas to transparent and composites the frames in the range [firstFrame, lastFrame] onto it,
+// the frame indexes are zero-based. The first frame must be a key frame, see IsKeyFrame.
+// The frame callback is optional.
+VP8StatusCode CompositeAnimationFrames(
+    const WebPDemuxer* demux,
+    uint8_t* canvas,
+    int canvasStride,
+    int firstFrame,
+    int lastFrame,
+    AnimationFrameFn frameCallback);
+
+// Returns true if the frame does not depend on the canvas left by the previous frames.
+bool IsKeyFrame(const WebPDemuxer* demux, int frameIndex);
@@ -0,0 +1,744 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <memory>
+#include "AnimationWriter.h"
+#include "scoped.h"
+#include "EncoderConfig.h"
+#include "ImageAnalysis.h"
+#include "PoolWorkerInterface.h"
+#include "RiffWriter.h"
+#include "WorkerPool.h"
+
+namespace
+{
+    const size_t AnimChunkPayloadSize = 6;
+    const int MaxCanvasDimension = 1 << 24;
+    const int MaxFrameDuration = (1 << 24) - 1;
+
+    int ProgressReport(int percent, const WebPPicture* picture)
+    {
+        ProgressFn progressCallback = reinterpret_cast<ProgressFn>(picture->user_data);
+
+        // The progress checkpoints are where a background encode gives way to interactive work.
+        WorkerPool::GetInstance().YieldToInteractiveWork();
+
+        return progressCallback == nullptr || progressCallback(percent) ? 1 : 0;
+    }
+
+    // Encodes a frame as a still image, the frame chunks are the image chunks that follow the optional VP8X chunk.
+    int EncodeFrame(
+        const void* bitmap,
+        int width,
+        int height,
+        int stride,
+        bool hasTransparency,
+        const EncodeParams& encodeOptions,
+        ProgressFn progressCallback,
+        ScopedWebPMemoryWriter& output)
+    {
+        WebPConfig config;
+        ScopedWebPPicture pic;
+
+        if (pic == nullptr || output == nullptr)
+        {
+            return VP8_ENC_ERROR_OUT_OF_MEMORY;
+        }
+
+        if (!InitializeEncoderConfig(encodeOptions, config) || !pic.IsInitalized())
+        {
+            return errVersionMismatch;
+        }
+
+        InstallPoolWorkerInterface();
+
+        pic->use_argb = encodeOptions.lossless ? 1 : 0;
+        pic->width = width;
+        pic->height = height;
+        pic->writer = WebPMemoryWrite;
+        pic->custom_ptr = output.Get();
+
+        if (progressCallback != nullptr || WorkerPool::GetCurrentPriority() == JobPriorityBackground)
+        {
+            pic->user_data = reinterpret_cast<void*>(progressCallback);
+            pic->progress_hook = ProgressReport;
+        }
+
+        const uint8_t* scan0 = static_cast<const uint8_t*>(bitmap);
+        const int imported = hasTransparency ? WebPPictureImportBGRA(pic.Get(), scan0, stride) : WebPPictureImportBGRX(pic.Get(), scan0, stride);
+
+        if (!imported)
+        {
+            return VP8_ENC_ERROR_OUT_OF_MEMORY;
+        }
+
+        if (!WebPEncode(&config, pic.Get()))
+        {
+            return static_cast<int>(pic->error_code);
+        }
+
+        return VP8_ENC_OK;
+    }
+
+    // Gets the range of the encoder output that holds the frame chunks.
+    bool GetFrameChunks(const ScopedWebPMemoryWriter& output, const uint8_t*& frameData, size_t& frameSize)
+    {
+        const uint8_t* data = output.GetBuffer();
+        const size_t dataSize = output.GetBufferSize();
+
+        RiffChunkReader reader(data, dataSize);
+        RiffChunk chunk;
+
+        if (!reader.Next(chunk))
+        {
+            return false;
+        }
+
+        if (chunk.fourcc == VP8XFourCC && !reader.Next(chunk))
+        {
+            return false;
+        }
+
+        if (chunk.fourcc != AlphFourCC && chunk.fourcc != VP8FourCC && chunk.fourcc != VP8LFourCC)
+        {
+            return false;
+        }
+
+        const size_t riffEnd = static_cast<size_t>(ReadLE32(data + 4)) + ChunkHeaderSize;
+
+        frameData = data + chunk.offset;
+        frameSize = (riffEnd < dataSize ? riffEnd : dataSize) - chunk.offset;
+
+        return true;
+    }
+
+    // Finds the smallest rectangle that contains every pixel that differs between the two canvases.
+    // Returns false if the canvases are identical.
+    bool FindChangedRect(
+        const uint8_t* previous,
+        const uint8_t* current,
+        int currentStride,
+        int width,
+        int height,
+        int& left,
+        int& top,
+        int& right,
+        int& bottom)
+    {
+        const size_t previousStride = static_cast<size_t>(width) * 4;
+
+        left = width;
+        top = height;
+        right = -1;
+        bottom = -1;
+
+        for (int y = 0; y < height; y++)
+        {
+            const uint32_t* previousRow = reinterpret_cast<const uint32_t*>(previous + (previousStride * y));
+            const uint32_t* currentRow = reinterpret_cast<const uint32_t*>(current + (static_cast<int64_t>(y) * currentStride));
+
+            if (memcmp(previousRow, currentRow, previousStride) == 0)
+            {
+                continue;
+            }
+
+            int x = 0;
+            while (previousRow[x] == currentRow[x])
+            {
+                x++;
+            }
+
+            int lastX = width - 1;
+            while (previousRow[lastX] == currentRow[lastX])
+            {
+                lastX--;
+            }
+
+            left = x < left ? x : left;
+            right = lastX > right ? lastX : right;
+            top = y < top ? y : top;
+            bottom = y;
+        }
+
+        return right >= 0;
+    }
+}
+
+AnimationWriter::AnimationWriter(WriteImageFn writeCallback, SeekFn seekCallback, int canvasWidth, int canvasHeight)
+    : writeCallback(writeCallback), seekCallback(seekCallback), canvasWidth(canvasWidth), canvasHeight(canvasHeight),
+      flags(ANIMATION_FLAG), position(0), frameCount(0), error(VP8_ENC_OK), finished(false), trailer(),
+      replacedOffset(0), replacedSize(0), canvas(), canvasValid(true)
+{
+}
+
+int AnimationWriter::Write(const uint8_t* data, size_t dataSize)
+{
+    if (error == VP8_ENC_OK)
+    {
+        error = writeCallback(data, dataSize);
+        position += dataSize;
+    }
+
+    return error;
+}
+
+void AnimationWriter::AppendTrailerChunk(uint32_t fourcc, const uint8_t* payload, size_t payloadSize)
+{
+    const size_t offset = trailer.size();
+
+    trailer.resize(offset + GetChunkSize(payloadSize));
+    WriteChunkHeader(trailer.data() + offset, fourcc, static_cast<uint32_t>(payloadSize));
+    memcpy(trailer.data() + offset + ChunkHeaderSize, payload, payloadSize);
+}
+
+int AnimationWriter::Start(int loopCount, uint32_t backgroundColor, const MetadataParams* metadata)
+{
+    if (canvasWidth <= 0 || canvasHeight <= 0 ||
+        canvasWidth > MaxCanvasDimension || canvasHeight > MaxCanvasDimension ||
+        static_cast<uint64_t>(canvasWidth) * canvasHeight > UINT32_MAX)
+    {
+        return error = VP8_ENC_ERROR_BAD_DIMENSION;
+    }
+
+    if (loopCount < 0 || loopCount > 0xffff)
+    {
+        return error = VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    const uint8_t* iccProfile = nullptr;
+    size_t iccProfileSize = 0;
+
+    if (metadata != nullptr)
+    {
+        if (metadata->iccProfileSize > 0)
+        {
+            iccProfile = metadata->iccProfile;
+            iccProfileSize = metadata->iccProfileSize;
+            flags |= ICCP_FLAG;
+        }
+
+        // The EXIF and XMP chunks follow the frames, the caller does not need to keep the data alive.
+        if (metadata->exifSize > 0)
+        {
+            AppendTrailerChunk(ExifFourCC, metadata->exif, metadata->exifSize);
+            flags |= EXIF_FLAG;
+        }
+
+        if (metadata->xmpSize > 0)
+        {
+            AppendTrailerChunk(XmpFourCC, metadata->xmp, metadata->xmpSize);
+            flags |= XMP_FLAG;
+        }
+    }
+
+    // The RIFF size is written when the writer is finished.
+    uint8_t header[RiffHeaderSize + ChunkHeaderSize + VP8XChunkSize + ChunkHeaderSize];
+
+    WriteRiffHeader(header, 0);
+    WriteVP8XChunk(header + RiffHeaderSize, flags, canvasWidth, canvasHeight);
+
+    if (iccProfile != nullptr)
+    {
+        WriteChunkHeader(header + RiffHeaderSize + GetChunkSize(VP8XChunkSize), IccpFourCC, static_cast<uint32_t>(iccProfileSize));
+
+        const uint8_t padding = 0;
+
+        if (Write(header, sizeof(header)) != VP8_ENC_OK ||
+            Write(iccProfile, iccProfileSize) != VP8_ENC_OK ||
+            ((iccProfileSize & 1) != 0 && Write(&padding, 1) != VP8_ENC_OK))
+        {
+            return error;
+        }
+    }
+    else if (Write(header, RiffHeaderSize + GetChunkSize(VP8XChunkSize)) != VP8_ENC_OK)
+    {
+        return error;
+    }
+
+    uint8_t anim[ChunkHeaderSize + AnimChunkPayloadSize];
+
+    WriteChunkHeader(anim, AnimFourCC, AnimChunkPayloadSize);
+    WriteLE32(anim + ChunkHeaderSize, backgroundColor);
+    WriteLE16(anim + ChunkHeaderSize + 4, static_cast<uint32_t>(loopCount));
+
+    return Write(anim, sizeof(anim));
+}
+
+int AnimationWriter::Open(const uint8_t* data, size_t dataSize, const void* previousFrame, int previousFrameStride)
+{
+    size_t errorOffset;
+
+    if (WebPValidate(data, dataSize, &errorOffset) != WebPValidationOk)
+    {
+        return error = VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    RiffChunkReader reader(data, dataSize);
+    RiffChunk chunk;
+
+    if (!reader.Next(chunk) || chunk.fourcc != VP8XFourCC || (ReadLE32(chunk.payload) & ANIMATION_FLAG) == 0)
+    {
+        return error = VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    flags = ReadLE32(chunk.payload);
+    canvasWidth = static_cast<int>(ReadLE24(chunk.payload + 4) + 1);
+    canvasHeight = static_cast<int>(ReadLE24(chunk.payload + 7) + 1);
+
+    RiffChunk lastFrame = {};
+    size_t framesEnd = 0;
+
+    while (reader.Next(chunk))
+    {
+        if (chunk.fourcc == AnmfFourCC)
+        {
+            lastFrame = chunk;
+            framesEnd = chunk.offset + GetChunkSize(chunk.payloadSize);
+            frameCount++;
+        }
+    }
+
+    // The chunks that follow the last frame are written again after the new frames.
+    reader = RiffChunkReader(data, dataSize);
+
+    while (reader.Next(chunk))
+    {
+        if (chunk.offset >= framesEnd)
+        {
+            AppendTrailerChunk(chunk.fourcc, chunk.payload, chunk.payloadSize);
+        }
+    }
+
+    // The validator has checked that the RIFF data is within the file, any data after it is ignored by readers.
+    const size_t riffEnd = static_cast<size_t>(ReadLE32(data + 4)) + ChunkHeaderSize;
+
+    replacedOffset = framesEnd;
+    replacedSize = riffEnd - framesEnd;
+
+    canvasValid = previousFrame != nullptr;
+
+    if (previousFrame != nullptr)
+    {
+        const size_t canvasStride = static_cast<size_t>(canvasWidth) * 4;
+
+        canvas.reset(static_cast<uint8_t*>(AllocateImageMemory(canvasStride * canvasHeight)));
+        if (canvas == nullptr)
+        {
+            return error = VP8_ENC_ERROR_OUT_OF_MEMORY;
+        }
+
+        const uint8_t* scan0 = static_cast<const uint8_t*>(previousFrame);
+
+        for (int y = 0; y < canvasHeight; y++)
+        {
+            memcpy(canvas.get() + (canvasStride * y), scan0 + (static_cast<int64_t>(y) * previousFrameStride), canvasStride);
+        }
+
+        // The last frame is disposed before the next frame is drawn.
+        if ((lastFrame.payload[15] & 1) != 0)
+        {
+            const int x = static_cast<int>(ReadLE24(lastFrame.payload)) * 2;
+            const int y = static_cast<int>(ReadLE24(lastFrame.payload + 3)) * 2;
+            const int width = static_cast<int>(ReadLE24(lastFrame.payload + 6) + 1);
+            const int height = static_cast<int>(ReadLE24(lastFrame.payload + 9) + 1);
+
+            for (int row = y; row < y + height; row++)
+            {
+                memset(canvas.get() + (canvasStride * row) + (static_cast<size_t>(x) * 4), 0, static_cast<size_t>(width) * 4);
+            }
+        }
+    }
+
+    position = riffEnd;
+
+    return error = seekCallback(riffEnd);
+}
+
+int AnimationWriter::AddFrame(
+    const void* bitmap,
+    int width,
+    int height,
+    int stride,
+    int x,
+    int y,
+    int duration,
+    WebPMuxAnimDispose dispose,
+    WebPMuxAnimBlend blend,
+    const EncodeParams& encodeOptions,
+    ProgressFn progressCallback)
+{
+    // The canvas is not composited for frames that are added directly.
+    canvasValid = false;
+
+    return WriteFrame(bitmap, width, height, stride, x, y, duration, dispose, blend, encodeOptions, progressCallback);
+}
+
+int AnimationWriter::AddCanvasFrame(const void* bitmap, int stride, int duration, const EncodeParams& encodeOptions, ProgressFn progressCallback)
+{
+    if (error != VP8_ENC_OK)
+    {
+        return error;
+    }
+
+    const size_t canvasStride = static_cast<size_t>(canvasWidth) * 4;
+
+    if (canvas == nullptr)
+    {
+        canvas.reset(static_cast<uint8_t*>(AllocateImageMemory(canvasStride * canvasHeight)));
+        if (canvas == nullptr)
+        {
+            return VP8_ENC_ERROR_OUT_OF_MEMORY;
+        }
+
+        // The canvas of a new animation starts out transparent.
+        memset(canvas.get(), 0, canvasStride * canvasHeight);
+    }
+
+    int left = 0;
+    int top = 0;
+    int right = canvasWidth - 1;
+    int bottom = canvasHeight - 1;
+
+    const uint8_t* scan0 = static_cast<const uint8_t*>(bitmap);
+
+    if (canvasValid && !FindChangedRect(canvas.get(), scan0, stride, canvasWidth, canvasHeight, left, top, right, bottom))
+    {
+        // A frame still has to be written for the duration, it replaces a single pixel with the same value.
+        left = 0;
+        top = 0;
+        right = 0;
+        bottom = 0;
+    }
+
+    // The ANMF chunk stores the frame offset divided by 2.
+    left &= ~1;
+    top &= ~1;
+
+    const int width = right - left + 1;
+    const int height = bottom - top + 1;
+    const uint8_t* frameScan0 = scan0 + (static_cast<int64_t>(top) * stride) + (static_cast<int64_t>(left) * 4);
+
+    int frameError = WriteFrame(
+        frameScan0,
+        width,
+        height,
+        stride,
+        left,
+        top,
+        duration,
+        WEBP_MUX_DISPOSE_NONE,
+        WEBP_MUX_NO_BLEND,
+        encodeOptions,
+        progressCallback);
+
+    if (frameError == VP8_ENC_OK)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            memcpy(
+                canvas.get() + (canvasStride * (top + y)) + (static_cast<size_t>(left) * 4),
+                frameScan0 + (static_cast<int64_t>(y) * stride),
+                static_cast<size_t>(width) * 4);
+        }
+
+        canvasValid = true;
+    }
+
+    return frameError;
+}
+
+int AnimationWriter::WriteFrame(
+    const void* bitmap,
+    int width,
+    int height,
+    int stride,
+    int x,
+    int y,
+    int duration,
+    WebPMuxAnimDispose dispose,
+    WebPMuxAnimBlend blend,
+    const EncodeParams& encodeOptions,
+    ProgressFn progressCallback)
+{
+    if (error != VP8_ENC_OK)
+    {
+        return error;
+    }
+
+    if (finished)
+    {
+        return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    // The ANMF chunk stores the frame offset divided by 2.
+    if (width <= 0 || height <= 0 || x < 0 || y < 0 || (x & 1) != 0 || (y & 1) != 0 ||
+        static_cast<int64_t>(x) + width > canvasWidth || static_cast<int64_t>(y) + height > canvasHeight)
+    {
+        return VP8_ENC_ERROR_BAD_DIMENSION;
+    }
+
+    if (duration < 0 || duration > MaxFrameDuration)
+    {
+        return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    PixelTraits traits;
+    ScanPixelTraits(bitmap, width, height, stride, traits);
+
+    const bool hasTransparency = traits.hasTransparency;
+    ScopedWebPMemoryWriter output;
+
+    int encodeError = EncodeFrame(bitmap, width, height, stride, hasTransparency, encodeOptions, progressCallback, output);
+
+    // A cancelled or failed frame does not leave a partial chunk in the output, so the caller can still finish the animation.
+    if (encodeError != VP8_ENC_OK)
+    {
+        return encodeError;
+    }
+
+    const uint8_t* frameData;
+    size_t frameSize;
+
+    if (!GetFrameChunks(output, frameData, frameSize))
+    {
+        return error = VP8_ENC_ERROR_BAD_WRITE;
+    }
+
+    const uint64_t anmfPayloadSize = AnmfHeaderSize + static_cast<uint64_t>(frameSize);
+
+    if (position + ChunkHeaderSize + anmfPayloadSize > UINT32_MAX)
+    {
+        return error = VP8_ENC_ERROR_FILE_TOO_BIG;
+    }
+
+    uint8_t anmf[ChunkHeaderSize + AnmfHeaderSize];
+
+    WriteChunkHeader(anmf, AnmfFourCC, static_cast<uint32_t>(anmfPayloadSize));
+    WriteLE24(anmf + ChunkHeaderSize, static_cast<uint32_t>(x / 2));
+    WriteLE24(anmf + ChunkHeaderSize + 3, static_cast<uint32_t>(y / 2));
+    WriteLE24(anmf + ChunkHeaderSize + 6, static_cast<uint32_t>(width - 1));
+    WriteLE24(anmf + ChunkHeaderSize + 9, static_cast<uint32_t>(height - 1));
+    WriteLE24(anmf + ChunkHeaderSize + 12, static_cast<uint32_t>(duration));
+    anmf[ChunkHeaderSize + 15] = static_cast<uint8_t>((blend == WEBP_MUX_NO_BLEND ? 2 : 0) | (dispose == WEBP_MUX_DISPOSE_BACKGROUND ? 1 : 0));
+
+    if (Write(anmf, sizeof(anmf)) != VP8_ENC_OK || Write(frameData, frameSize) != VP8_ENC_OK)
+    {
+        return error;
+    }
+
+    if (hasTransparency)
+    {
+        flags |= ALPHA_FLAG;
+    }
+
+    frameCount++;
+
+    return VP8_ENC_OK;
+}
+
+int AnimationWriter::Finish()
+{
+    if (error != VP8_ENC_OK)
+    {
+        return error;
+    }
+
+    if (finished || frameCount == 0)
+    {
+        return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    finished = true;
+
+    if (!trailer.empty())
+    {
+        if (position + trailer.size() > UINT32_MAX)
+        {
+            return error = VP8_ENC_ERROR_FILE_TOO_BIG;
+        }
+
+        if (Write(trailer.data(), trailer.size()) != VP8_ENC_OK)
+        {
+            return error;
+        }
+    }
+
+    const uint64_t fileSize = position;
+
+    // Rewrite the RIFF size and the VP8X chunk, the alpha flag is only known after all of the frames have been encoded.
+    uint8_t header[RiffHeaderSize + ChunkHeaderSize + VP8XChunkSize];
+
+    WriteRiffHeader(header, static_cast<uint32_t>(fileSize - ChunkHeaderSize));
+    WriteVP8XChunk(header + RiffHeaderSize, flags, canvasWidth, canvasHeight);
+
+    if ((error = seekCallback(4)) != VP8_ENC_OK ||
+        (error = writeCallback(header + 4, sizeof(header) - 4)) != VP8_ENC_OK)
+    {
+        return error;
+    }
+
+    // The appended file now holds the trailer chunks twice, readers use the first copy of each chunk
+    // and both copies are identical. The first copy is replaced by a JUNK chunk of the same size.
+    if (replacedSize > 0)
+    {
+        uint8_t junk[ChunkHeaderSize];
+        WriteChunkHeader(junk, JunkFourCC, static_cast<uint32_t>(replacedSize - ChunkHeaderSize));
+
+        if ((error = seekCallback(replacedOffset)) != VP8_ENC_OK ||
+            (error = writeCallback(junk, sizeof(junk))) != VP8_ENC_OK)
+        {
+            return error;
+        }
+
+        const uint8_t zeros[256] = {};
+        uint64_t remaining = replacedSize - ChunkHeaderSize;
+
+        while (remaining > 0)
+        {
+            const size_t count = remaining < sizeof(zeros) ? static_cast<size_t>(remaining) : sizeof(zeros);
+
+            if ((error = writeCallback(zeros, count)) != VP8_ENC_OK)
+            {
+                return error;
+            }
+
+            remaining -= count;
+        }
+    }
+
+    return error = seekCallback(fileSize);
+}
+
+int __stdcall WebPAnimationWriterCreate(
+    const WriteImageFn writeImageCallback,
+    const SeekFn seekCallback,
+    const int canvasWidth,
+    const int canvasHeight,
+    const int loopCount,
+    const uint32_t backgroundColor,
+    const MetadataParams* metadata,
+    AnimationWriter** writer)
+{
+    if (writeImageCallback == nullptr || seekCallback == nullptr || writer == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    *writer = nullptr;
+
+    std::unique_ptr<AnimationWriter> animationWriter(new (std::nothrow) AnimationWriter(writeImageCallback, seekCallback, canvasWidth, canvasHeight));
+    if (animationWriter == nullptr)
+    {
+        return VP8_ENC_ERROR_OUT_OF_MEMORY;
+    }
+
+    const int error = animationWriter->Start(loopCount, backgroundColor, metadata);
+
+    if (error == VP8_ENC_OK)
+    {
+        *writer = animationWriter.release();
+    }
+
+    return error;
+}
+
+int __stdcall WebPAnimationWriterOpen(
+    const uint8_t* data,
+    size_t dataSize,
+    const WriteImageFn writeImageCallback,
+    const SeekFn seekCallback,
+    const void* previousFrame,
+    const int previousFrameStride,
+    AnimationWriter** writer)
+{
+    if (data == nullptr || writeImageCallback == nullptr || seekCallback == nullptr || writer == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    *writer = nullptr;
+
+    std::unique_ptr<AnimationWriter> animationWriter(new (std::nothrow) AnimationWriter(writeImageCallback, seekCallback, 0, 0));
+    if (animationWriter == nullptr)
+    {
+        return VP8_ENC_ERROR_OUT_OF_MEMORY;
+    }
+
+    const int error = animationWriter->Open(data, dataSize, previousFrame, previousFrameStride);
+
+    if (error == VP8_ENC_OK)
+    {
+        *writer = animationWriter.release();
+    }
+
+    return error;
+}
+
+int __stdcall WebPAnimationWriterAddFrame(
+    AnimationWriter* writer,
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const AnimationFrameParams* frameParams,
+    const EncodeParams* encodeOptions,
+    ProgressFn callback)
+{
+    if (writer == nullptr || bitmap == nullptr || frameParams == nullptr || encodeOptions == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    return writer->AddFrame(
+        bitmap,
+        width,
+        height,
+        stride,
+        frameParams->x,
+        frameParams->y,
+        frameParams->duration,
+        frameParams->dispose,
+        frameParams->blend,
+        *encodeOptions,
+        callback);
+}
+
+int __stdcall WebPAnimationWriterAddCanvasFrame(
+    AnimationWriter* writer,
+    const void* bitmap,
+    const int stride,
+    const int duration,
+    const EncodeParams* encodeOptions,
+    ProgressFn callback)
+{
+    if (writer == nullptr || bitmap == nullptr || encodeOptions == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    return writer->AddCanvasFrame(bitmap, stride, duration, *encodeOptions, callback);
+}
+
+int __stdcall WebPAnimationWriterFinish(AnimationWriter* writer)
+{
+    if (writer == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    return writer->Finish();
+}
+
+void __stdcall WebPAnimationWriterDelete(AnimationWriter* writer)
+{
+    delete writer;
+}
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include "WebP.h"
+#include "ImageMemory.h"
+
+// Writes an animated WebP file to a stream one frame at a time.
+//
+// The RIFF, VP8X and ANIM headers are written when the writer is started, and each frame is written
+// as an ANMF chunk as soon as it has been encoded. When the writer is finished the EXIF and XMP chunks
+// are appended and the RIFF size and VP8X flags are updated through the seek callback, so only the
+// frame that is being encoded is held in memory.
+//
+// A writer can also append frames to an existing animation in place. The new frames are staged after the
+// end of the existing RIFF data, where readers do not see them, and the file only changes at Finish:
+// the chunks that followed the last existing frame are written after the new frames, the RIFF size is
+// updated, and the old copies of those chunks are then replaced by a JUNK chunk. The file is a valid
+// animation after each of these writes, so an append that is cancelled or fails leaves the original intact.
+struct AnimationWriter
+{
+public:
+    AnimationWriter(WriteImageFn writeCallback, SeekFn seekCallback, int canvasWidth, int canvasHeight);
+
+    // Disable copying and assignment.
+    AnimationWriter(const AnimationWriter&) = delete;
+    const AnimationWriter& operator=(const AnimationWriter&) = delete;
+
+    // Writes the container headers and the color profile.
+    int Start(int loopCount, uint32_t backgroundColor, const MetadataParams* metadata);
+
+    // Positions the stream after the end of an existing animation, the stream must contain the same data.
+    // If previousFrame is not nullptr it is the canvas that was passed for the last existing frame, the first
+    // new canvas frame is then stored as the difference from it.
+    int Open(const uint8_t* data, size_t dataSize, const void* previousFrame, int previousFrameStride);
+
+    // Encodes a frame and writes it as an ANMF chunk, the frame offset must be even.
+    int AddFrame(
+        const void* bitmap,
+        int width,
+        int height,
+        int stride,
+        int x,
+        int y,
+        int duration,
+        WebPMuxAnimDispose dispose,
+        WebPMuxAnimBlend blend,
+        const EncodeParams& encodeOptions,
+        ProgressFn progressCallback);
+
+    // Encodes a frame that covers the whole canvas, only the rectangle that differs from the previous canvas
+    // is written. The frame replaces the pixels in that rectangle instead of being blended with them.
+    int AddCanvasFrame(const void* bitmap, int stride, int duration, const EncodeParams& encodeOptions, ProgressFn progressCallback);
+
+    // Writes the metadata chunks and updates the container header.
+    int Finish();
+
+private:
+    int Write(const uint8_t* data, size_t dataSize);
+    int WriteFrame(
+        const void* bitmap,
+        int width,
+        int height,
+        int stride,
+        int x,
+        int y,
+        int duration,
+        WebPMuxAnimDispose dispose,
+        WebPMuxAnimBlend blend,
+        const EncodeParams& encodeOptions,
+        ProgressFn progressCallback);
+    void AppendTrailerChunk(uint32_t fourcc, const uint8_t* payload, size_t payloadSize);
+
+    WriteImageFn writeCallback;
+    SeekFn seekCallback;
+    int canvasWidth;
+    int canvasHeight;
+    uint32_t flags;
+    uint64_t position;
+    int frameCount;
+    // The first error is returned from every later call, the output is incomplete after an error.
+    int error;
+    bool finished;
+    // The chunks that are written after the frames, e.g. the EXIF and XMP metadata.
+    std::vector<uint8_t> trailer;
+    // The range of the existing file that held the trailer chunks, it is replaced by a JUNK chunk at Finish.
+    uint64_t replacedOffset;
+    uint64_t replacedSize;
+    // The source pixels of the canvas after the last frame, only valid when every frame so far was added by AddCanvasFrame.
+    // The frames are compared against the source pixels instead of the decoded frames, a lossy frame never
+    // decodes to the exact pixels that it was encoded from.
+    ScopedImageMemory canvas;
+    bool canvasValid;
+};
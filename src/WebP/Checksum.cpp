@@ -0,0 +1,340 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "Checksum.h"
+
+#ifdef CRC32C_HARDWARE_SUPPORTED
+#include <intrin.h>
+#include <nmmintrin.h>
+#endif
+
+namespace
+{
+    const uint32_t Crc32cPolynomial = 0x82F63B78; // The reversed Castagnoli polynomial.
+
+    const uint64_t XxhPrime1 = 11400714785074694791ULL;
+    const uint64_t XxhPrime2 = 14029467366897019727ULL;
+    const uint64_t XxhPrime3 = 1609587929392839161ULL;
+    const uint64_t XxhPrime4 = 9650029242287828579ULL;
+    const uint64_t XxhPrime5 = 2870177450012600261ULL;
+
+    struct Crc32cTables
+    {
+        uint32_t table[8][256];
+
+        Crc32cTables()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t value = i;
+
+                for (int j = 0; j < 8; j++)
+                {
+                    value = (value & 1) != 0 ? (value >> 1) ^ Crc32cPolynomial : value >> 1;
+                }
+
+                table[0][i] = value;
+            }
+
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                for (int j = 1; j < 8; j++)
+                {
+                    table[j][i] = (table[j - 1][i] >> 8) ^ table[0][table[j - 1][i] & 0xff];
+                }
+            }
+        }
+    };
+
+    inline uint32_t ReadUInt32(const uint8_t* data)
+    {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t ReadUInt64(const uint8_t* data)
+    {
+        uint64_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t RotateLeft(uint64_t value, int count)
+    {
+        return (value << count) | (value >> (64 - count));
+    }
+
+    inline uint64_t XxhRound(uint64_t accumulator, uint64_t input)
+    {
+        accumulator += input * XxhPrime2;
+        accumulator = RotateLeft(accumulator, 31);
+        return accumulator * XxhPrime1;
+    }
+
+    inline uint64_t XxhMergeRound(uint64_t accumulator, uint64_t value)
+    {
+        accumulator ^= XxhRound(0, value);
+        return accumulator * XxhPrime1 + XxhPrime4;
+    }
+}
+
+uint32_t UpdateCrc32cSoftware(uint32_t crc, const uint8_t* data, size_t dataSize)
+{
+    static const Crc32cTables tables;
+    const uint32_t (*table)[256] = tables.table;
+
+    // Slicing-by-8, the data is read as little-endian.
+    while (dataSize >= 8)
+    {
+        const uint32_t low = ReadUInt32(data) ^ crc;
+        const uint32_t high = ReadUInt32(data + 4);
+
+        crc = table[7][low & 0xff] ^
+              table[6][(low >> 8) & 0xff] ^
+              table[5][(low >> 16) & 0xff] ^
+              table[4][low >> 24] ^
+              table[3][high & 0xff] ^
+              table[2][(high >> 8) & 0xff] ^
+              table[1][(high >> 16) & 0xff] ^
+              table[0][high >> 24];
+
+        data += 8;
+        dataSize -= 8;
+    }
+
+    while (dataSize > 0)
+    {
+        crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xff];
+        data++;
+        dataSize--;
+    }
+
+    return crc;
+}
+
+#ifdef CRC32C_HARDWARE_SUPPORTED
+bool IsCrc32cHardwareSupported()
+{
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+
+    return (cpuInfo[2] & (1 << 20)) != 0;
+}
+
+uint32_t UpdateCrc32cHardware(uint32_t crc, const uint8_t* data, size_t dataSize)
+{
+#ifdef _M_X64
+    uint64_t crc64 = crc;
+
+    while (dataSize >= 8)
+    {
+        crc64 = _mm_crc32_u64(crc64, ReadUInt64(data));
+        data += 8;
+        dataSize -= 8;
+    }
+
+    crc = static_cast<uint32_t>(crc64);
+#endif
+
+    while (dataSize >= 4)
+    {
+        crc = _mm_crc32_u32(crc, ReadUInt32(data));
+        data += 4;
+        dataSize -= 4;
+    }
+
+    while (dataSize > 0)
+    {
+        crc = _mm_crc32_u8(crc, *data);
+        data++;
+        dataSize--;
+    }
+
+    return crc;
+}
+#endif
+
+namespace
+{
+    uint32_t UpdateCrc32c(uint32_t crc, const uint8_t* data, size_t dataSize)
+    {
+#ifdef CRC32C_HARDWARE_SUPPORTED
+        static const bool hardwareSupported = IsCrc32cHardwareSupported();
+
+        if (hardwareSupported)
+        {
+            return UpdateCrc32cHardware(crc, data, dataSize);
+        }
+#endif
+
+        return UpdateCrc32cSoftware(crc, data, dataSize);
+    }
+}
+
+StreamChecksum::StreamChecksum(ChecksumType type) : type(type)
+{
+    Reset();
+}
+
+void StreamChecksum::Reset()
+{
+    crc = 0xffffffff;
+    xxhState[0] = XxhPrime1 + XxhPrime2;
+    xxhState[1] = XxhPrime2;
+    xxhState[2] = 0;
+    xxhState[3] = 0 - XxhPrime1;
+    xxhBufferSize = 0;
+    totalSize = 0;
+}
+
+void StreamChecksum::Update(const uint8_t* data, size_t dataSize)
+{
+    if (data == nullptr || dataSize == 0)
+    {
+        return;
+    }
+
+    switch (type)
+    {
+    case ChecksumCrc32c:
+        crc = UpdateCrc32c(crc, data, dataSize);
+        break;
+    case ChecksumXxHash64:
+        UpdateXxHash64(data, dataSize);
+        break;
+    case ChecksumNone:
+    default:
+        break;
+    }
+
+    totalSize += dataSize;
+}
+
+uint64_t StreamChecksum::GetValue() const
+{
+    uint64_t value = 0;
+
+    switch (type)
+    {
+    case ChecksumCrc32c:
+        value = crc ^ 0xffffffff;
+        break;
+    case ChecksumXxHash64:
+    {
+        uint64_t hash;
+
+        if (totalSize >= sizeof(xxhBuffer))
+        {
+            hash = RotateLeft(xxhState[0], 1) +
+                   RotateLeft(xxhState[1], 7) +
+                   RotateLeft(xxhState[2], 12) +
+                   RotateLeft(xxhState[3], 18);
+
+            for (int i = 0; i < 4; i++)
+            {
+                hash = XxhMergeRound(hash, xxhState[i]);
+            }
+        }
+        else
+        {
+            hash = XxhPrime5;
+        }
+
+        hash += totalSize;
+
+        const uint8_t* ptr = xxhBuffer;
+        size_t remaining = xxhBufferSize;
+
+        while (remaining >= 8)
+        {
+            hash ^= XxhRound(0, ReadUInt64(ptr));
+            hash = RotateLeft(hash, 27) * XxhPrime1 + XxhPrime4;
+            ptr += 8;
+            remaining -= 8;
+        }
+
+        if (remaining >= 4)
+        {
+            hash ^= static_cast<uint64_t>(ReadUInt32(ptr)) * XxhPrime1;
+            hash = RotateLeft(hash, 23) * XxhPrime2 + XxhPrime3;
+            ptr += 4;
+            remaining -= 4;
+        }
+
+        while (remaining > 0)
+        {
+            hash ^= *ptr * XxhPrime5;
+            hash = RotateLeft(hash, 11) * XxhPrime1;
+            ptr++;
+            remaining--;
+        }
+
+        hash ^= hash >> 33;
+        hash *= XxhPrime2;
+        hash ^= hash >> 29;
+        hash *= XxhPrime3;
+        hash ^= hash >> 32;
+
+        value = hash;
+        break;
+    }
+    case ChecksumNone:
+    default:
+        break;
+    }
+
+    return value;
+}
+
+void StreamChecksum::UpdateXxHash64(const uint8_t* data, size_t dataSize)
+{
+    if (xxhBufferSize > 0)
+    {
+        const size_t copySize = dataSize < sizeof(xxhBuffer) - xxhBufferSize ? dataSize : sizeof(xxhBuffer) - xxhBufferSize;
+
+        memcpy(xxhBuffer + xxhBufferSize, data, copySize);
+        xxhBufferSize += copySize;
+        data += copySize;
+        dataSize -= copySize;
+
+        if (xxhBufferSize < sizeof(xxhBuffer))
+        {
+            return;
+        }
+
+        for (int i = 0; i < 4; i++)
+        {
+            xxhState[i] = XxhRound(xxhState[i], ReadUInt64(xxhBuffer + (i * 8)));
+        }
+
+        xxhBufferSize = 0;
+    }
+
+    while (dataSize >= sizeof(xxhBuffer))
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            xxhState[i] = XxhRound(xxhState[i], ReadUInt64(data + (i * 8)));
+        }
+
+        data += sizeof(xxhBuffer);
+        dataSize -= sizeof(xxhBuffer);
+    }
+
+    if (dataSize > 0)
+    {
+        memcpy(xxhBuffer, data, dataSize);
+        xxhBufferSize = dataSize;
+    }
+}
@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WebP.h"
+
+#if defined(_M_X64) || defined(_M_IX86)
+#define CRC32C_HARDWARE_SUPPORTED 1
+#endif
+
+// Updates a CRC-32C value with the slicing-by-8 tables, the value is not inverted before or after the update.
+uint32_t UpdateCrc32cSoftware(uint32_t crc, const uint8_t* data, size_t dataSize);
+
+#ifdef CRC32C_HARDWARE_SUPPORTED
+// Returns true if the processor supports the SSE 4.2 CRC32 instruction.
+bool IsCrc32cHardwareSupported();
+
+// Updates a CRC-32C value with the SSE 4.2 CRC32 instruction, the result is the same as UpdateCrc32cSoftware.
+uint32_t UpdateCrc32cHardware(uint32_t crc, const uint8_t* data, size_t dataSize);
+#endif
+
+// Computes a checksum of a byte stream that is supplied in one or more blocks.
+class StreamChecksum
+{
+public:
+    explicit StreamChecksum(ChecksumType type);
+
+    // Disable copying and assignment.
+    StreamChecksum(const StreamChecksum&) = delete;
+    const StreamChecksum& operator=(const StreamChecksum&) = delete;
+
+    ChecksumType GetType() const
+    {
+        return type;
+    }
+
+    void Reset();
+
+    void Update(const uint8_t* data, size_t dataSize);
+
+    // Gets the checksum of the data supplied since the last reset.
+    // CRC-32C values are returned in the low 32 bits.
+    uint64_t GetValue() const;
+
+private:
+    void UpdateXxHash64(const uint8_t* data, size_t dataSize);
+
+    ChecksumType type;
+    uint32_t crc;
+    uint64_t xxhState[4];
+    uint8_t xxhBuffer[32];
+    size_t xxhBufferSize;
+    uint64_t totalSize;
+};
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "EncoderConfig.h"
+
+bool InitializeEncoderConfig(const EncodeParams& encodeOptions, WebPConfig& config)
+{
+    if (!WebPConfigPreset(&config, static_cast<WebPPreset>(encodeOptions.preset), encodeOptions.quality))
+    {
+        return false;
+    }
+
+    // 6 is the highest quality encoding
+    config.method = encodeOptions.method >= 0 && encodeOptions.method <= 6 ? encodeOptions.method : 6;
+    config.thread_level = 1;
+
+    // The alpha plane is compressed with the same effort as the color planes, the libwebp
+    // alpha encoder does not have a separate method setting.
+    if (encodeOptions.alphaCompression >= 0)
+    {
+        config.alpha_compression = encodeOptions.alphaCompression;
+    }
+
+    if (encodeOptions.alphaFiltering >= 0)
+    {
+        config.alpha_filtering = encodeOptions.alphaFiltering;
+    }
+
+    if (encodeOptions.alphaQuality >= 0)
+    {
+        config.alpha_quality = encodeOptions.alphaQuality;
+    }
+
+    if (encodeOptions.lossless)
+    {
+        config.lossless = 1;
+
+        switch (encodeOptions.preset)
+        {
+        case WEBP_PRESET_PHOTO:
+            config.image_hint = WEBP_HINT_PHOTO;
+            break;
+        case WEBP_PRESET_PICTURE:
+            config.image_hint = WEBP_HINT_PICTURE;
+            break;
+        case WEBP_PRESET_DRAWING:
+            config.image_hint = WEBP_HINT_GRAPH;
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool ApplyContentShortcuts(const PixelTraits& traits, WebPConfig& config)
+{
+    // Flat fills, masks and bilevel scans are stored exactly by the lossless palette encoding in a
+    // small fraction of the lossy size, and the fastest method compresses them as well as the slowest.
+    if (traits.colorCount <= MaxTraitColors)
+    {
+        config.lossless = 1;
+        config.method = 0;
+        return true;
+    }
+
+    // The alpha level quantization cannot reduce an alpha plane that only has two levels.
+    if (!config.lossless && traits.hasTransparency && traits.binaryAlpha)
+    {
+        config.alpha_quality = 100;
+    }
+
+    return false;
+}
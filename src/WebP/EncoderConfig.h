@@ -0,0 +1,24 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WebP.h"
+#include "ImageAnalysis.h"
+
+// Initializes the libwebp encoder configuration from the encoding options.
+// Returns false if the libwebp library version does not match the headers.
+bool InitializeEncoderConfig(const EncodeParams& encodeOptions, WebPConfig& config);
+
+// Adjusts the configuration for flat content that a specialized configuration encodes faster and smaller.
+// Returns true if the image is encoded losslessly because it has at most MaxTraitColors colors.
+bool ApplyContentShortcuts(const PixelTraits& traits, WebPConfig& config);
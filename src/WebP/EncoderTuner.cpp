@@ -0,0 +1,439 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "WebP.h"
+#include "scoped.h"
+#include "EncoderConfig.h"
+#include "ImageAnalysis.h"
+#include "ImageMemory.h"
+#include "PoolWorkerInterface.h"
+#include "WorkerPool.h"
+
+namespace
+{
+    // Images with a lower edge density than this are classified as smooth.
+    const float SmoothEdgeDensity = 0.08f;
+
+    struct Measurement
+    {
+        Measurement() : encodeTime(0.0), size(0), ssim(0.0f), error(VP8_ENC_OK)
+        {
+        }
+
+        double encodeTime;
+        size_t size;
+        float ssim;
+        int error;
+        // The encoded image, kept until the SSIM has been computed.
+        std::vector<uint8_t> encoded;
+    };
+
+    struct CorpusImage
+    {
+        CorpusImage() : image(nullptr), features(), cluster(ContentPalette), source()
+        {
+        }
+
+        const TuneImage* image;
+        ImageFeatures features;
+        ContentCluster cluster;
+        ScopedWebPPicture source;
+    };
+
+    ContentCluster ClassifyImage(const ImageFeatures& features)
+    {
+        if (features.colorCount <= 256)
+        {
+            return ContentPalette;
+        }
+
+        return features.edgeDensity < SmoothEdgeDensity ? ContentSmooth : ContentDetailed;
+    }
+
+    EncodeParams MakeCandidate(WebPPreset preset, float quality, int method, bool lossless)
+    {
+        EncodeParams params;
+        memset(&params, 0, sizeof(params));
+
+        params.quality = quality;
+        params.preset = preset;
+        params.lossless = lossless;
+        params.alphaCompression = -1;
+        params.alphaFiltering = -1;
+        params.alphaQuality = -1;
+        params.method = method;
+
+        return params;
+    }
+
+    std::vector<EncodeParams> GetDefaultCandidates()
+    {
+        static const WebPPreset presets[] = { WEBP_PRESET_PICTURE, WEBP_PRESET_PHOTO, WEBP_PRESET_DRAWING };
+        static const float qualities[] = { 50.0f, 65.0f, 75.0f, 85.0f, 95.0f };
+        static const int methods[] = { 2, 4, 6 };
+
+        std::vector<EncodeParams> candidates;
+
+        for (WebPPreset preset : presets)
+        {
+            for (float quality : qualities)
+            {
+                for (int method : methods)
+                {
+                    candidates.push_back(MakeCandidate(preset, quality, method, false));
+                }
+            }
+        }
+
+        // For lossless encoding the quality controls the encoder effort.
+        candidates.push_back(MakeCandidate(WEBP_PRESET_DRAWING, 25.0f, 2, true));
+        candidates.push_back(MakeCandidate(WEBP_PRESET_DRAWING, 75.0f, 4, true));
+
+        return candidates;
+    }
+
+    // WebPPictureDistortion reports the SSIM in decibels.
+    float SsimFromDecibels(float decibels)
+    {
+        return static_cast<float>(1.0 - pow(10.0, -decibels / 10.0));
+    }
+
+    bool ImportSource(const TuneImage& image, bool hasTransparency, WebPPicture* picture)
+    {
+        picture->use_argb = 1;
+        picture->width = image.width;
+        picture->height = image.height;
+
+        const uint8_t* bitmap = static_cast<const uint8_t*>(image.bitmap);
+
+        if (hasTransparency)
+        {
+            return WebPPictureImportBGRA(picture, bitmap, image.stride) != 0;
+        }
+        else
+        {
+            return WebPPictureImportBGRX(picture, bitmap, image.stride) != 0;
+        }
+    }
+
+    // Encodes the image with the candidate configuration and records the encode time and size.
+    // The candidates are encoded one at a time so that the time only includes the work of a single encode,
+    // the encoder still uses the worker pool for its own threads.
+    void EncodeCandidate(const CorpusImage& image, const EncodeParams& candidate, Measurement& measurement)
+    {
+        WebPConfig config;
+        ScopedWebPPicture picture;
+        ScopedWebPMemoryWriter writer;
+
+        if (picture == nullptr || writer == nullptr)
+        {
+            measurement.error = VP8_ENC_ERROR_OUT_OF_MEMORY;
+            return;
+        }
+
+        if (!InitializeEncoderConfig(candidate, config) || !picture.IsInitalized())
+        {
+            measurement.error = errVersionMismatch;
+            return;
+        }
+
+        // The encoder modifies the picture, so each candidate encodes its own copy of the source.
+        if (!WebPPictureCopy(image.source.Get(), picture.Get()))
+        {
+            measurement.error = VP8_ENC_ERROR_OUT_OF_MEMORY;
+            return;
+        }
+
+        picture->writer = WebPMemoryWrite;
+        picture->custom_ptr = writer.Get();
+
+        const auto start = std::chrono::steady_clock::now();
+
+        if (!WebPEncode(&config, picture.Get()))
+        {
+            measurement.error = static_cast<int>(picture->error_code);
+            return;
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+
+        measurement.encodeTime = std::chrono::duration<double, std::milli>(end - start).count();
+        measurement.size = writer.GetBufferSize();
+        measurement.encoded.assign(writer.GetBuffer(), writer.GetBuffer() + writer.GetBufferSize());
+    }
+
+    // Decodes the encoded image and computes its SSIM against the source, this is not timed
+    // so the candidates are scored concurrently.
+    void ScoreCandidate(const CorpusImage& image, Measurement& measurement)
+    {
+        const int width = image.image->width;
+        const int height = image.image->height;
+        const size_t decodedStride = static_cast<size_t>(width) * 4;
+        const size_t decodedSize = decodedStride * height;
+
+        ScopedImageMemory decoded(static_cast<uint8_t*>(AllocateImageMemory(decodedSize)));
+        ScopedWebPPicture reference;
+
+        if (decoded == nullptr || reference == nullptr)
+        {
+            measurement.error = VP8_ENC_ERROR_OUT_OF_MEMORY;
+            return;
+        }
+
+        if (WebPDecodeBGRAInto(measurement.encoded.data(), measurement.encoded.size(), decoded.get(), decodedSize, static_cast<int>(decodedStride)) == nullptr)
+        {
+            measurement.error = VP8_ENC_ERROR_BAD_WRITE;
+            return;
+        }
+
+        std::vector<uint8_t>().swap(measurement.encoded);
+
+        reference->use_argb = 1;
+        reference->width = width;
+        reference->height = height;
+
+        float distortion[5];
+
+        if (!WebPPictureImportBGRA(reference.Get(), decoded.get(), static_cast<int>(decodedStride)) ||
+            !WebPPictureDistortion(image.source.Get(), reference.Get(), 1, distortion))
+        {
+            measurement.error = VP8_ENC_ERROR_OUT_OF_MEMORY;
+            return;
+        }
+
+        measurement.ssim = SsimFromDecibels(distortion[4]);
+    }
+
+    // Selects the candidate that meets the SSIM target on every image in the cluster with the lowest
+    // total encode time, when no candidate meets the target the one with the highest average SSIM is used.
+    void SelectProfile(
+        const std::vector<CorpusImage>& images,
+        const std::vector<EncodeParams>& candidates,
+        const std::vector<Measurement>& measurements,
+        ContentCluster cluster,
+        float targetSsim,
+        TuneProfile& profile)
+    {
+        const size_t candidateCount = candidates.size();
+
+        memset(&profile, 0, sizeof(profile));
+
+        int bestCandidate = -1;
+        bool bestMeetsTarget = false;
+        double bestTime = 0.0;
+        double bestSize = 0.0;
+        double bestSsim = 0.0;
+
+        for (size_t c = 0; c < candidateCount; c++)
+        {
+            int imageCount = 0;
+            bool meetsTarget = true;
+            double totalTime = 0.0;
+            double totalSize = 0.0;
+            double totalSsim = 0.0;
+
+            for (size_t i = 0; i < images.size(); i++)
+            {
+                if (images[i].cluster != cluster)
+                {
+                    continue;
+                }
+
+                const Measurement& measurement = measurements[(i * candidateCount) + c];
+
+                imageCount++;
+                meetsTarget = meetsTarget && measurement.ssim >= targetSsim;
+                totalTime += measurement.encodeTime;
+                totalSize += static_cast<double>(measurement.size);
+                totalSsim += measurement.ssim;
+            }
+
+            if (imageCount == 0)
+            {
+                return;
+            }
+
+            bool better;
+
+            if (bestCandidate < 0 || meetsTarget != bestMeetsTarget)
+            {
+                better = bestCandidate < 0 || meetsTarget;
+            }
+            else if (meetsTarget)
+            {
+                better = totalTime < bestTime || (totalTime == bestTime && totalSize < bestSize);
+            }
+            else
+            {
+                better = totalSsim > bestSsim;
+            }
+
+            if (better)
+            {
+                bestCandidate = static_cast<int>(c);
+                bestMeetsTarget = meetsTarget;
+                bestTime = totalTime;
+                bestSize = totalSize;
+                bestSsim = totalSsim;
+
+                profile.imageCount = imageCount;
+                profile.meetsTarget = meetsTarget;
+                profile.averageEncodeTime = totalTime / imageCount;
+                profile.averageSize = totalSize / imageCount;
+                profile.averageSsim = static_cast<float>(totalSsim / imageCount);
+            }
+        }
+
+        if (bestCandidate >= 0)
+        {
+            profile.params = candidates[bestCandidate];
+        }
+    }
+}
+
+int __stdcall WebPTuneEncodeParams(
+    const TuneImage* images,
+    int imageCount,
+    const TuneParams* tuneParams,
+    TuneProfile* profiles)
+{
+    if (images == nullptr || imageCount <= 0 || tuneParams == nullptr || profiles == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    std::vector<EncodeParams> candidates;
+
+    if (tuneParams->candidates != nullptr && tuneParams->candidateCount > 0)
+    {
+        candidates.assign(tuneParams->candidates, tuneParams->candidates + tuneParams->candidateCount);
+    }
+    else
+    {
+        candidates = GetDefaultCandidates();
+    }
+
+    // Large corpora are sampled at evenly spaced positions.
+    const int sampleCount = tuneParams->sampleCount > 0 && tuneParams->sampleCount < imageCount ? tuneParams->sampleCount : imageCount;
+
+    std::vector<CorpusImage> corpus(static_cast<size_t>(sampleCount));
+
+    for (int i = 0; i < sampleCount; i++)
+    {
+        CorpusImage& item = corpus[i];
+
+        item.image = &images[(static_cast<int64_t>(i) * imageCount) / sampleCount];
+
+        if (item.image->bitmap == nullptr)
+        {
+            return VP8_ENC_ERROR_NULL_PARAMETER;
+        }
+
+        if (item.source == nullptr)
+        {
+            return VP8_ENC_ERROR_OUT_OF_MEMORY;
+        }
+
+        if (!item.source.IsInitalized())
+        {
+            return errVersionMismatch;
+        }
+    }
+
+    InstallPoolWorkerInterface();
+
+    std::vector<Measurement> measurements(corpus.size() * candidates.size());
+    int error = VP8_ENC_OK;
+
+    {
+        TaskGroup group;
+
+        for (CorpusImage& item : corpus)
+        {
+            CorpusImage* itemPtr = &item;
+
+            group.Run([itemPtr]()
+            {
+                AnalyzeImage(itemPtr->image->bitmap, itemPtr->image->width, itemPtr->image->height, itemPtr->image->stride, itemPtr->features);
+                itemPtr->cluster = ClassifyImage(itemPtr->features);
+            });
+        }
+
+        group.Wait();
+
+        for (CorpusImage& item : corpus)
+        {
+            if (!ImportSource(*item.image, item.features.hasTransparency, item.source.Get()))
+            {
+                return VP8_ENC_ERROR_OUT_OF_MEMORY;
+            }
+        }
+
+        for (size_t i = 0; i < corpus.size() && error == VP8_ENC_OK; i++)
+        {
+            for (size_t c = 0; c < candidates.size(); c++)
+            {
+                Measurement& measurement = measurements[(i * candidates.size()) + c];
+
+                EncodeCandidate(corpus[i], candidates[c], measurement);
+
+                if (measurement.error != VP8_ENC_OK)
+                {
+                    error = measurement.error;
+                    break;
+                }
+            }
+        }
+
+        if (error == VP8_ENC_OK)
+        {
+            for (size_t i = 0; i < corpus.size(); i++)
+            {
+                for (size_t c = 0; c < candidates.size(); c++)
+                {
+                    const CorpusImage* image = &corpus[i];
+                    Measurement* measurement = &measurements[(i * candidates.size()) + c];
+
+                    group.Run([image, measurement]()
+                    {
+                        ScoreCandidate(*image, *measurement);
+                    });
+                }
+            }
+        }
+
+        group.Wait();
+    }
+
+    for (const Measurement& measurement : measurements)
+    {
+        if (measurement.error != VP8_ENC_OK)
+        {
+            error = measurement.error;
+            break;
+        }
+    }
+
+    if (error == VP8_ENC_OK)
+    {
+        for (int cluster = 0; cluster < ContentClusterCount; cluster++)
+        {
+            SelectProfile(corpus, candidates, measurements, static_cast<ContentCluster>(cluster), tuneParams->targetSsim, profiles[cluster]);
+        }
+    }
+
+    return error;
+}
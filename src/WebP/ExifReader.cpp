@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "ExifReader.h"
+
+namespace
+{
+    const uint16_t LittleEndianByteOrderMarker = 0x4949;
+    const uint16_t BigEndianByteOrderMarker = 0x4d4d;
+    const uint16_t TiffSignature = 42;
+
+    const uint16_t OrientationTag = 274;
+    const uint16_t XResolutionTag = 282;
+    const uint16_t YResolutionTag = 283;
+    const uint16_t ResolutionUnitTag = 296;
+
+    const uint16_t ShortType = 3;
+    const uint16_t RationalType = 5;
+
+    const size_t IfdEntrySize = 12;
+
+    class TiffReader
+    {
+    public:
+        TiffReader(const uint8_t* data, size_t size, bool bigEndian) : data(data), size(size), bigEndian(bigEndian)
+        {
+        }
+
+        bool ReadUInt16(size_t offset, uint16_t& value) const
+        {
+            if (offset > size || size - offset < 2)
+            {
+                return false;
+            }
+
+            const uint8_t* p = data + offset;
+            value = bigEndian ? static_cast<uint16_t>((p[0] << 8) | p[1]) : static_cast<uint16_t>(p[0] | (p[1] << 8));
+            return true;
+        }
+
+        bool ReadUInt32(size_t offset, uint32_t& value) const
+        {
+            if (offset > size || size - offset < 4)
+            {
+                return false;
+            }
+
+            const uint8_t* p = data + offset;
+
+            if (bigEndian)
+            {
+                value = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+            }
+            else
+            {
+                value = p[0] | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+            }
+
+            return true;
+        }
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        bool bigEndian;
+    };
+
+    // A SHORT value with a count of one is stored in the first two bytes of the value field.
+    bool ReadShortValue(const TiffReader& reader, size_t entryOffset, uint16_t type, uint32_t count, uint16_t& value)
+    {
+        return type == ShortType && count == 1 && reader.ReadUInt16(entryOffset + 8, value);
+    }
+
+    // A RATIONAL value does not fit in the value field, which holds the offset of the numerator and denominator.
+    bool ReadRationalValue(const TiffReader& reader, size_t entryOffset, uint16_t type, uint32_t count, double& value)
+    {
+        uint32_t valueOffset;
+        uint32_t numerator;
+        uint32_t denominator;
+
+        if (type != RationalType ||
+            count != 1 ||
+            !reader.ReadUInt32(entryOffset + 8, valueOffset) ||
+            !reader.ReadUInt32(valueOffset, numerator) ||
+            !reader.ReadUInt32(static_cast<size_t>(valueOffset) + 4, denominator) ||
+            denominator == 0)
+        {
+            return false;
+        }
+
+        value = static_cast<double>(numerator) / denominator;
+        return true;
+    }
+}
+
+bool ReadExifImageInfo(const uint8_t* exif, size_t exifSize, ExifImageInfo& info)
+{
+    memset(&info, 0, sizeof(info));
+
+    if (exif == nullptr || exifSize < 8)
+    {
+        return false;
+    }
+
+    // The byte order marker is the same in either byte order.
+    const uint16_t byteOrderMarker = static_cast<uint16_t>(exif[0] | (exif[1] << 8));
+
+    if (byteOrderMarker != LittleEndianByteOrderMarker && byteOrderMarker != BigEndianByteOrderMarker)
+    {
+        return false;
+    }
+
+    const TiffReader reader(exif, exifSize, byteOrderMarker == BigEndianByteOrderMarker);
+
+    uint16_t signature;
+    uint32_t ifdOffset;
+    uint16_t entryCount;
+
+    if (!reader.ReadUInt16(2, signature) ||
+        signature != TiffSignature ||
+        !reader.ReadUInt32(4, ifdOffset) ||
+        !reader.ReadUInt16(ifdOffset, entryCount))
+    {
+        return false;
+    }
+
+    const size_t firstEntry = static_cast<size_t>(ifdOffset) + 2;
+
+    if (firstEntry > exifSize || (exifSize - firstEntry) / IfdEntrySize < entryCount)
+    {
+        return false;
+    }
+
+    // Only the tags that the load path uses are read, the other entries are skipped without being parsed.
+    for (uint16_t i = 0; i < entryCount; i++)
+    {
+        const size_t entryOffset = firstEntry + (static_cast<size_t>(i) * IfdEntrySize);
+
+        uint16_t tag;
+        uint16_t type;
+        uint32_t count;
+
+        reader.ReadUInt16(entryOffset, tag);
+        reader.ReadUInt16(entryOffset + 2, type);
+        reader.ReadUInt32(entryOffset + 4, count);
+
+        switch (tag)
+        {
+        case OrientationTag:
+            ReadShortValue(reader, entryOffset, type, count, info.orientation);
+            break;
+        case ResolutionUnitTag:
+            ReadShortValue(reader, entryOffset, type, count, info.resolutionUnit);
+            break;
+        case XResolutionTag:
+            ReadRationalValue(reader, entryOffset, type, count, info.xResolution);
+            break;
+        case YResolutionTag:
+            ReadRationalValue(reader, entryOffset, type, count, info.yResolution);
+            break;
+        }
+    }
+
+    return true;
+}
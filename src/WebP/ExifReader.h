@@ -0,0 +1,20 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WebP.h"
+
+// Reads the orientation and resolution tags from the first IFD of an EXIF chunk in place.
+// The chunk must start with the TIFF header, in the same way as the managed ExifParser expects.
+// Returns false if the TIFF header or the IFD is not valid.
+bool ReadExifImageInfo(const uint8_t* exif, size_t exifSize, ExifImageInfo& info);
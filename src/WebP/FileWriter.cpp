@@ -0,0 +1,313 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <string.h>
+#include "FileWriter.h"
+
+namespace
+{
+    // The sector size that is assumed when the volume does not report one.
+    const size_t DefaultSectorSize = 4096;
+
+    size_t GetSectorSize(HANDLE file)
+    {
+        FILE_STORAGE_INFO storageInfo;
+
+        if (GetFileInformationByHandleEx(file, FileStorageInfo, &storageInfo, sizeof(storageInfo)))
+        {
+            const size_t size = storageInfo.PhysicalBytesPerSectorForPerformance;
+
+            // The staging buffer is page aligned, so a larger sector size cannot be honored.
+            if (size != 0 && (size & (size - 1)) == 0 && size <= DefaultSectorSize)
+            {
+                return size;
+            }
+        }
+
+        return DefaultSectorSize;
+    }
+
+    // Distinguishes the temporary files of the saves that run concurrently in this process.
+    std::atomic<unsigned int> temporaryFileCounter(0);
+
+    // The number of names that are tried before the temporary file creation fails.
+    const int MaxTemporaryFileAttempts = 16;
+}
+
+FileWriter::FileWriter()
+    : file(INVALID_HANDLE_VALUE),
+      path(),
+      temporaryPath(),
+      staging(nullptr),
+      stagingSize(0),
+      sectorSize(0),
+      fileSize(0),
+      allocatedSize(0),
+      allocationFailed(false),
+      flushPolicy(FileFlushNone),
+      committed(false)
+{
+}
+
+FileWriter::~FileWriter()
+{
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        if (!committed)
+        {
+            FILE_DISPOSITION_INFO dispositionInfo;
+            dispositionInfo.DeleteFile = TRUE;
+
+            SetFileInformationByHandle(file, FileDispositionInfo, &dispositionInfo, sizeof(dispositionInfo));
+        }
+
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+
+    if (staging != nullptr)
+    {
+        VirtualFree(staging, 0, MEM_RELEASE);
+        staging = nullptr;
+    }
+}
+
+int FileWriter::Open(const wchar_t* path, uint64_t expectedSize, bool unbuffered, FileFlushPolicy flushPolicy)
+{
+    if (path == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    if (flushPolicy < FileFlushNone || flushPolicy > FileFlushWriteThrough)
+    {
+        return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+
+    if (unbuffered)
+    {
+        flags |= FILE_FLAG_NO_BUFFERING;
+    }
+
+    if (flushPolicy == FileFlushWriteThrough)
+    {
+        flags |= FILE_FLAG_WRITE_THROUGH;
+    }
+
+    this->path = path;
+
+    if (!CreateTemporaryFile(flags))
+    {
+        return VP8_ENC_ERROR_BAD_WRITE;
+    }
+
+    if (expectedSize > 0)
+    {
+        Reserve(expectedSize);
+    }
+
+    if (unbuffered)
+    {
+        // VirtualAlloc returns page aligned memory, which satisfies the buffer alignment requirement.
+        staging = static_cast<uint8_t*>(VirtualAlloc(nullptr, StagingSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+        if (staging == nullptr)
+        {
+            return VP8_ENC_ERROR_OUT_OF_MEMORY;
+        }
+
+        sectorSize = GetSectorSize(file);
+    }
+
+    this->flushPolicy = flushPolicy;
+
+    return VP8_ENC_OK;
+}
+
+int FileWriter::Write(const uint8_t* data, size_t dataSize)
+{
+    if (file == INVALID_HANDLE_VALUE || committed)
+    {
+        return VP8_ENC_ERROR_BAD_WRITE;
+    }
+
+    // A failed reservation is not an error, the file system allocates the clusters as the file grows.
+    Reserve(fileSize + stagingSize + dataSize);
+
+    if (staging == nullptr)
+    {
+        if (!WriteBlock(data, dataSize))
+        {
+            return VP8_ENC_ERROR_BAD_WRITE;
+        }
+    }
+    else
+    {
+        while (dataSize > 0)
+        {
+            const size_t copySize = dataSize < StagingSize - stagingSize ? dataSize : StagingSize - stagingSize;
+
+            memcpy(staging + stagingSize, data, copySize);
+            stagingSize += copySize;
+            data += copySize;
+            dataSize -= copySize;
+
+            if (stagingSize == StagingSize)
+            {
+                if (!WriteBlock(staging, StagingSize))
+                {
+                    return VP8_ENC_ERROR_BAD_WRITE;
+                }
+
+                stagingSize = 0;
+            }
+        }
+    }
+
+    return VP8_ENC_OK;
+}
+
+int FileWriter::Commit()
+{
+    if (file == INVALID_HANDLE_VALUE || committed)
+    {
+        return VP8_ENC_ERROR_BAD_WRITE;
+    }
+
+    uint64_t finalSize = fileSize;
+
+    if (staging != nullptr && stagingSize > 0)
+    {
+        // Unbuffered writes must cover whole sectors, the padding is truncated below.
+        const size_t paddedSize = (stagingSize + sectorSize - 1) & ~(sectorSize - 1);
+
+        memset(staging + stagingSize, 0, paddedSize - stagingSize);
+        finalSize += stagingSize;
+
+        if (!WriteBlock(staging, paddedSize))
+        {
+            return VP8_ENC_ERROR_BAD_WRITE;
+        }
+
+        stagingSize = 0;
+    }
+
+    // Setting the end of file also releases the clusters that were reserved but not written.
+    FILE_END_OF_FILE_INFO endOfFileInfo;
+    endOfFileInfo.EndOfFile.QuadPart = static_cast<LONGLONG>(finalSize);
+
+    if (!SetFileInformationByHandle(file, FileEndOfFileInfo, &endOfFileInfo, sizeof(endOfFileInfo)))
+    {
+        return VP8_ENC_ERROR_BAD_WRITE;
+    }
+
+    if (flushPolicy == FileFlushOnCommit && !FlushFileBuffers(file))
+    {
+        return VP8_ENC_ERROR_BAD_WRITE;
+    }
+
+    fileSize = finalSize;
+
+    CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+
+    // The destination file is only replaced once the image has been written completely.
+    if (!MoveFileExW(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFileW(temporaryPath.c_str());
+        return VP8_ENC_ERROR_BAD_WRITE;
+    }
+
+    committed = true;
+
+    return VP8_ENC_OK;
+}
+
+bool FileWriter::CreateTemporaryFile(DWORD flags)
+{
+    const std::wstring processId = std::to_wstring(GetCurrentProcessId());
+
+    for (int i = 0; i < MaxTemporaryFileAttempts; i++)
+    {
+        // The name is based on the destination file, so the file is created in the same directory and
+        // the move in Commit is a rename on the same volume.
+        temporaryPath = path + L"." + processId + L"-" + std::to_wstring(temporaryFileCounter++) + L".tmp";
+
+        // DELETE access is required to remove the file if the save fails.
+        file = CreateFileW(temporaryPath.c_str(), GENERIC_WRITE | DELETE, FILE_SHARE_READ, nullptr, CREATE_NEW, flags, nullptr);
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            return true;
+        }
+
+        if (GetLastError() != ERROR_FILE_EXISTS)
+        {
+            break;
+        }
+    }
+
+    return false;
+}
+
+bool FileWriter::WriteBlock(const uint8_t* data, size_t dataSize)
+{
+    while (dataSize > 0)
+    {
+        // WriteFile is limited to 4 GB per call, the chunk size keeps unbuffered writes sector aligned.
+        const DWORD chunkSize = dataSize > 0x80000000 ? 0x80000000 : static_cast<DWORD>(dataSize);
+        DWORD bytesWritten = 0;
+
+        if (!WriteFile(file, data, chunkSize, &bytesWritten, nullptr) || bytesWritten != chunkSize)
+        {
+            return false;
+        }
+
+        data += chunkSize;
+        dataSize -= chunkSize;
+        fileSize += chunkSize;
+    }
+
+    return true;
+}
+
+bool FileWriter::Reserve(uint64_t size)
+{
+    if (size <= allocatedSize)
+    {
+        return true;
+    }
+
+    // The file system does not support reservations, the writes extend the file instead.
+    if (allocationFailed)
+    {
+        return false;
+    }
+
+    // The allocation is doubled, so the small blocks that the encoder writes only extend it a few times.
+    // Commit truncates the file to the size that was written.
+    const uint64_t newSize = size > allocatedSize * 2 ? size : allocatedSize * 2;
+
+    FILE_ALLOCATION_INFO allocationInfo;
+    allocationInfo.AllocationSize.QuadPart = static_cast<LONGLONG>(newSize);
+
+    if (!SetFileInformationByHandle(file, FileAllocationInfo, &allocationInfo, sizeof(allocationInfo)))
+    {
+        allocationFailed = true;
+        return false;
+    }
+
+    allocatedSize = newSize;
+
+    return true;
+}
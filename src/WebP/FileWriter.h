@@ -0,0 +1,70 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <string>
+#include "WebP.h"
+
+// Writes the encoder output directly to a file.
+//
+// The file allocation is reserved from an estimate of the image size when the file is opened, and
+// doubled when a write goes past it, so the file system can reserve the clusters in a few large extents. When unbuffered output is requested the data is
+// copied into a sector-aligned staging buffer and written in large blocks that bypass the
+// system cache, the padding of the last block is removed when the file is committed.
+//
+// The image is written to a temporary file in the same directory, which replaces the
+// destination file when it is committed. An existing file is left unchanged if the save fails,
+// a temporary file that has not been committed is deleted when the writer is destroyed.
+class FileWriter
+{
+public:
+    FileWriter();
+    ~FileWriter();
+
+    // Disable copying and assignment.
+    FileWriter(const FileWriter&) = delete;
+    const FileWriter& operator=(const FileWriter&) = delete;
+
+    // Creates the temporary file that replaces the specified file when it is committed,
+    // expectedSize is the initial file allocation or 0 if the size is not known.
+    int Open(const wchar_t* path, uint64_t expectedSize, bool unbuffered, FileFlushPolicy flushPolicy);
+
+    // Appends a block of the encoded image.
+    int Write(const uint8_t* data, size_t dataSize);
+
+    // Writes the remaining staged data, sets the final file size, applies the flush policy
+    // and moves the temporary file over the destination file.
+    int Commit();
+
+private:
+    bool WriteBlock(const uint8_t* data, size_t dataSize);
+    bool Reserve(uint64_t size);
+    bool CreateTemporaryFile(DWORD flags);
+
+    // The size of the unbuffered writes, this is a multiple of every sector size that Windows supports.
+    static const size_t StagingSize = 1024 * 1024;
+
+    HANDLE file;
+    std::wstring path;
+    std::wstring temporaryPath;
+    uint8_t* staging;
+    size_t stagingSize;
+    size_t sectorSize;
+    uint64_t fileSize;
+    uint64_t allocatedSize;
+    bool allocationFailed;
+    FileFlushPolicy flushPolicy;
+    bool committed;
+};
@@ -0,0 +1,248 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "FixedBufferWriter.h"
+#include "RiffWriter.h"
+
+namespace
+{
+    // The VP8L header is a signature byte followed by a 32-bit field, the alpha hint is bit 28 of that field.
+    const size_t VP8LHeaderEnd = RiffHeaderSize + ChunkHeaderSize + 5;
+    const uint8_t VP8LSignature = 0x2f;
+
+    size_t GetMetadataChunkSize(const uint8_t* data, size_t dataSize)
+    {
+        return data != nullptr && dataSize > 0 ? GetChunkSize(dataSize) : 0;
+    }
+}
+
+FixedBufferWriter::FixedBufferWriter(uint8_t* buffer, size_t capacity, const MetadataParams* metadata, int width, int height)
+    : buffer(buffer), capacity(buffer != nullptr ? capacity : 0), metadata(metadata), width(width), height(height),
+      staging(), stagingSize(0), headerParsed(false), invalid(false), useVP8X(false), alphaFlag(0),
+      headerSize(0), imageSize(0), requiredSize(0)
+{
+}
+
+int FixedBufferWriter::Write(const uint8_t* data, size_t dataSize, const WebPPicture* picture)
+{
+    FixedBufferWriter* writer = static_cast<FixedBufferWriter*>(picture->custom_ptr);
+
+    return writer->Append(data, dataSize) ? 1 : 0;
+}
+
+bool FixedBufferWriter::Append(const uint8_t* data, size_t dataSize)
+{
+    if (invalid)
+    {
+        return false;
+    }
+
+    if (!headerParsed)
+    {
+        const size_t count = dataSize < StagingSize - stagingSize ? dataSize : StagingSize - stagingSize;
+
+        memcpy(staging + stagingSize, data, count);
+        stagingSize += count;
+        data += count;
+        dataSize -= count;
+
+        switch (ParseEncoderHeader())
+        {
+        case HeaderState::NeedMoreData:
+            return true;
+        case HeaderState::Invalid:
+            invalid = true;
+            return false;
+        case HeaderState::Parsed:
+            break;
+        }
+    }
+
+    AppendImageData(data, dataSize);
+
+    return true;
+}
+
+FixedBufferWriter::HeaderState FixedBufferWriter::ParseEncoderHeader()
+{
+    if (stagingSize < RiffHeaderSize + ChunkHeaderSize)
+    {
+        return HeaderState::NeedMoreData;
+    }
+
+    if (ReadLE32(staging) != RiffFourCC || ReadLE32(staging + 8) != WebPFourCC)
+    {
+        return HeaderState::Invalid;
+    }
+
+    const uint32_t fourcc = ReadLE32(staging + RiffHeaderSize);
+    size_t encoderHeaderSize = RiffHeaderSize;
+
+    if (fourcc == VP8XFourCC)
+    {
+        encoderHeaderSize += ChunkHeaderSize + VP8XChunkSize;
+
+        if (stagingSize < encoderHeaderSize)
+        {
+            return HeaderState::NeedMoreData;
+        }
+
+        alphaFlag = ReadLE32(staging + RiffHeaderSize + ChunkHeaderSize) & ALPHA_FLAG;
+        useVP8X = true;
+    }
+    else if (fourcc == VP8LFourCC)
+    {
+        if (stagingSize < VP8LHeaderEnd)
+        {
+            return HeaderState::NeedMoreData;
+        }
+
+        const uint8_t* vp8lHeader = staging + RiffHeaderSize + ChunkHeaderSize;
+
+        if (vp8lHeader[0] != VP8LSignature)
+        {
+            return HeaderState::Invalid;
+        }
+
+        alphaFlag = ((ReadLE32(vp8lHeader + 1) >> 28) & 1) != 0 ? ALPHA_FLAG : 0;
+    }
+
+    size_t iccpChunkSize = 0;
+
+    if (metadata != nullptr)
+    {
+        iccpChunkSize = GetMetadataChunkSize(metadata->iccProfile, metadata->iccProfileSize);
+
+        if (iccpChunkSize > 0 ||
+            GetMetadataChunkSize(metadata->exif, metadata->exifSize) > 0 ||
+            GetMetadataChunkSize(metadata->xmp, metadata->xmpSize) > 0)
+        {
+            useVP8X = true;
+        }
+    }
+
+    // The color profile chunk must be placed before the image data.
+    headerSize = RiffHeaderSize + (useVP8X ? ChunkHeaderSize + VP8XChunkSize : 0) + iccpChunkSize;
+    headerParsed = true;
+
+    if (stagingSize > encoderHeaderSize)
+    {
+        AppendImageData(staging + encoderHeaderSize, stagingSize - encoderHeaderSize);
+    }
+
+    return HeaderState::Parsed;
+}
+
+void FixedBufferWriter::AppendImageData(const uint8_t* data, size_t dataSize)
+{
+    const size_t offset = headerSize + imageSize;
+
+    if (offset < capacity)
+    {
+        const size_t available = capacity - offset;
+
+        memcpy(buffer + offset, data, dataSize < available ? dataSize : available);
+    }
+
+    imageSize += dataSize;
+}
+
+int FixedBufferWriter::Finish()
+{
+    if (invalid || !headerParsed || imageSize == 0)
+    {
+        return VP8_ENC_ERROR_BAD_WRITE;
+    }
+
+    const size_t exifChunkSize = metadata != nullptr ? GetMetadataChunkSize(metadata->exif, metadata->exifSize) : 0;
+    const size_t xmpChunkSize = metadata != nullptr ? GetMetadataChunkSize(metadata->xmp, metadata->xmpSize) : 0;
+
+    requiredSize = headerSize + imageSize + exifChunkSize + xmpChunkSize;
+
+    if (requiredSize - 8 > UINT32_MAX)
+    {
+        return VP8_ENC_ERROR_FILE_TOO_BIG;
+    }
+
+    if (requiredSize > capacity)
+    {
+        return errBufferTooSmall;
+    }
+
+    uint8_t* ptr = buffer;
+
+    WriteRiffHeader(ptr, static_cast<uint32_t>(requiredSize - 8));
+    ptr += RiffHeaderSize;
+
+    if (useVP8X)
+    {
+        uint32_t flags = alphaFlag;
+
+        if (metadata != nullptr)
+        {
+            if (metadata->iccProfile != nullptr && metadata->iccProfileSize > 0)
+            {
+                flags |= ICCP_FLAG;
+            }
+
+            if (exifChunkSize > 0)
+            {
+                flags |= EXIF_FLAG;
+            }
+
+            if (xmpChunkSize > 0)
+            {
+                flags |= XMP_FLAG;
+            }
+        }
+
+        WriteVP8XChunk(ptr, flags, width, height);
+        ptr += ChunkHeaderSize + VP8XChunkSize;
+    }
+
+    const uint8_t* chunks[3] = { nullptr, nullptr, nullptr };
+    size_t chunkSizes[3] = { 0, 0, 0 };
+    const uint32_t fourccs[3] = { IccpFourCC, ExifFourCC, XmpFourCC };
+
+    if (metadata != nullptr)
+    {
+        chunks[0] = metadata->iccProfile;
+        chunkSizes[0] = metadata->iccProfileSize;
+        chunks[1] = metadata->exif;
+        chunkSizes[1] = metadata->exifSize;
+        chunks[2] = metadata->xmp;
+        chunkSizes[2] = metadata->xmpSize;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (i == 1)
+        {
+            // The EXIF and XMP chunks follow the image data.
+            ptr = buffer + headerSize + imageSize;
+        }
+
+        if (chunks[i] != nullptr && chunkSizes[i] > 0)
+        {
+            WriteChunkHeader(ptr, fourccs[i], static_cast<uint32_t>(chunkSizes[i]));
+            memcpy(ptr + ChunkHeaderSize, chunks[i], chunkSizes[i]);
+            ptr += ChunkHeaderSize + chunkSizes[i];
+
+            if (chunkSizes[i] & 1)
+            {
+                *ptr++ = 0;
+            }
+        }
+    }
+
+    return VP8_ENC_OK;
+}
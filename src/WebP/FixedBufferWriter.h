@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WebP.h"
+
+// Writes the encoder output directly into a caller-provided buffer.
+//
+// The RIFF header and any VP8X chunk that the encoder writes are replaced with a container
+// that also holds the metadata chunks, the space for the header and color profile is reserved
+// before the image chunks arrive, so the image data is never moved.
+// When the buffer is too small the writer keeps counting the bytes to report the required size.
+class FixedBufferWriter
+{
+public:
+    FixedBufferWriter(uint8_t* buffer, size_t capacity, const MetadataParams* metadata, int width, int height);
+
+    // Disable copying and assignment.
+    FixedBufferWriter(const FixedBufferWriter&) = delete;
+    const FixedBufferWriter& operator=(const FixedBufferWriter&) = delete;
+
+    // The WebPPicture writer function, the custom_ptr field of the picture must point to the writer.
+    static int Write(const uint8_t* data, size_t dataSize, const WebPPicture* picture);
+
+    // Appends a block of the encoder output.
+    bool Append(const uint8_t* data, size_t dataSize);
+
+    // Writes the container header and the metadata chunks.
+    // Returns errBufferTooSmall if the image does not fit in the buffer.
+    int Finish();
+
+    // Gets the size of the complete file, this is only valid after Finish has been called.
+    size_t GetRequiredSize() const
+    {
+        return requiredSize;
+    }
+
+private:
+    enum class HeaderState
+    {
+        NeedMoreData,
+        Parsed,
+        Invalid
+    };
+
+    HeaderState ParseEncoderHeader();
+    void AppendImageData(const uint8_t* data, size_t dataSize);
+
+    // The encoder header is at most a RIFF header and a VP8X chunk.
+    static const size_t StagingSize = 30;
+
+    uint8_t* buffer;
+    size_t capacity;
+    const MetadataParams* metadata;
+    int width;
+    int height;
+    uint8_t staging[StagingSize];
+    size_t stagingSize;
+    bool headerParsed;
+    bool invalid;
+    bool useVP8X;
+    uint32_t alphaFlag;
+    size_t headerSize;
+    size_t imageSize;
+    size_t requiredSize;
+};
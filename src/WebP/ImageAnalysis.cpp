@@ -0,0 +1,328 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "ImageAnalysis.h"
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define SSE2_SUPPORTED 1
+#endif
+
+namespace
+{
+    // The luma difference between neighboring pixels above which a pixel is counted as an edge.
+    const int EdgeThreshold = 32;
+
+    // The color set only needs to tell if an image fits in a 256 color palette.
+    const int MaxCountedColors = 256;
+
+    class ColorSet
+    {
+    public:
+        ColorSet() : count(0)
+        {
+            memset(used, 0, sizeof(used));
+        }
+
+        // Returns false when the set is full.
+        bool Add(uint32_t color)
+        {
+            uint32_t slot = (color * 0x9E3779B1) >> (32 - TableBits);
+
+            while (used[slot])
+            {
+                if (colors[slot] == color)
+                {
+                    return true;
+                }
+
+                slot = (slot + 1) & (TableSize - 1);
+            }
+
+            if (count == MaxCountedColors)
+            {
+                count++;
+                return false;
+            }
+
+            used[slot] = true;
+            colors[slot] = color;
+            count++;
+
+            return true;
+        }
+
+        int GetCount() const
+        {
+            return count;
+        }
+
+    private:
+        static const int TableBits = 9;
+        static const int TableSize = 1 << TableBits;
+
+        uint32_t colors[TableSize];
+        bool used[TableSize];
+        int count;
+    };
+
+    inline int GetLuma(const uint8_t* bgra)
+    {
+        return ((bgra[2] * 77) + (bgra[1] * 150) + (bgra[0] * 29)) >> 8;
+    }
+
+    inline bool IsGrayscale(uint32_t color)
+    {
+        // The blue and green, and the green and red bytes are compared in one operation.
+        return ((color ^ (color >> 8)) & 0xffff) == 0;
+    }
+
+    class PixelTraitsScanner
+    {
+    public:
+        PixelTraitsScanner() : opaque(true), binaryAlpha(true), grayscale(true), colorCount(0)
+        {
+        }
+
+        void AddPixel(uint32_t color)
+        {
+            const uint32_t alpha = color >> 24;
+
+            if (alpha != 255)
+            {
+                opaque = false;
+
+                if (alpha != 0)
+                {
+                    binaryAlpha = false;
+                }
+            }
+
+            if (!IsGrayscale(color))
+            {
+                grayscale = false;
+            }
+
+            AddColor(color);
+        }
+
+#ifdef SSE2_SUPPORTED
+        // Adds four pixels, the color comparisons are only done per pixel when a block contains a new color.
+        void AddPixels(const uint8_t* pixels)
+        {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000));
+
+            const __m128i alpha = _mm_and_si128(block, alphaMask);
+            const int opaqueMask = _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask));
+
+            if (opaqueMask != 0xffff)
+            {
+                opaque = false;
+
+                const int transparentMask = _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero));
+
+                if ((opaqueMask | transparentMask) != 0xffff)
+                {
+                    binaryAlpha = false;
+                }
+            }
+
+            if (grayscale)
+            {
+                const __m128i difference = _mm_and_si128(_mm_xor_si128(block, _mm_srli_epi32(block, 8)), _mm_set1_epi32(0xffff));
+
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(difference, zero)) != 0xffff)
+                {
+                    grayscale = false;
+                }
+            }
+
+            if (colorCount > 0 && colorCount <= MaxTraitColors)
+            {
+                __m128i known = _mm_cmpeq_epi32(block, _mm_set1_epi32(static_cast<int>(colors[0])));
+
+                if (colorCount > 1)
+                {
+                    known = _mm_or_si128(known, _mm_cmpeq_epi32(block, _mm_set1_epi32(static_cast<int>(colors[1]))));
+                }
+
+                if (_mm_movemask_epi8(known) == 0xffff)
+                {
+                    return;
+                }
+            }
+
+            if (colorCount <= MaxTraitColors)
+            {
+                for (int i = 0; i < 4; i++)
+                {
+                    AddColor(*reinterpret_cast<const uint32_t*>(pixels + (i * 4)));
+                }
+            }
+        }
+#endif
+
+        // Returns true when none of the traits can change.
+        bool IsComplete() const
+        {
+            return !binaryAlpha && !grayscale && colorCount > MaxTraitColors;
+        }
+
+        void GetTraits(PixelTraits& traits) const
+        {
+            traits.hasTransparency = !opaque;
+            traits.binaryAlpha = binaryAlpha;
+            traits.grayscale = grayscale;
+            traits.colorCount = colorCount;
+        }
+
+    private:
+        void AddColor(uint32_t color)
+        {
+            if (colorCount > MaxTraitColors)
+            {
+                return;
+            }
+
+            for (int i = 0; i < colorCount; i++)
+            {
+                if (colors[i] == color)
+                {
+                    return;
+                }
+            }
+
+            if (colorCount < MaxTraitColors)
+            {
+                colors[colorCount] = color;
+            }
+
+            colorCount++;
+        }
+
+        bool opaque;
+        bool binaryAlpha;
+        bool grayscale;
+        int colorCount;
+        uint32_t colors[MaxTraitColors];
+    };
+}
+
+void ScanPixelTraits(const void* bitmap, int width, int height, int stride, PixelTraits& traits)
+{
+    const uint8_t* scan0 = reinterpret_cast<const uint8_t*>(bitmap);
+    PixelTraitsScanner scanner;
+
+    for (int y = 0; y < height && !scanner.IsComplete(); y++)
+    {
+        const uint8_t* ptr = scan0 + (static_cast<int64_t>(y) * stride);
+        int x = 0;
+
+#ifdef SSE2_SUPPORTED
+        for (; x + 4 <= width; x += 4)
+        {
+            scanner.AddPixels(ptr);
+            ptr += 16;
+        }
+#endif
+
+        for (; x < width; x++)
+        {
+            scanner.AddPixel(*reinterpret_cast<const uint32_t*>(ptr));
+            ptr += 4;
+        }
+    }
+
+    scanner.GetTraits(traits);
+}
+
+void AnalyzeImage(const void* bitmap, int width, int height, int stride, ImageFeatures& features)
+{
+    const uint8_t* scan0 = reinterpret_cast<const uint8_t*>(bitmap);
+
+    ColorSet colors;
+    bool countingColors = true;
+    bool hasTransparency = false;
+    bool binaryAlpha = true;
+    bool grayscale = true;
+    int64_t edgePixels = 0;
+
+    std::vector<uint8_t> previousRowLuma(static_cast<size_t>(width));
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* ptr = scan0 + (static_cast<int64_t>(y) * stride);
+        uint32_t previousColor = 0;
+        int previousLuma = 0;
+
+        for (int x = 0; x < width; x++)
+        {
+            const uint32_t color = *reinterpret_cast<const uint32_t*>(ptr);
+            const int luma = GetLuma(ptr);
+
+            if (ptr[3] < 255)
+            {
+                hasTransparency = true;
+
+                if (ptr[3] != 0)
+                {
+                    binaryAlpha = false;
+                }
+            }
+
+            if (!IsGrayscale(color))
+            {
+                grayscale = false;
+            }
+
+            // Runs of the same color are common in the images that fit in a palette.
+            if (countingColors && (x == 0 || color != previousColor))
+            {
+                countingColors = colors.Add(color);
+            }
+
+            const int horizontal = x > 0 ? abs(luma - previousLuma) : 0;
+            const int vertical = y > 0 ? abs(luma - previousRowLuma[x]) : 0;
+
+            if (horizontal >= EdgeThreshold || vertical >= EdgeThreshold)
+            {
+                edgePixels++;
+            }
+
+            previousRowLuma[x] = static_cast<uint8_t>(luma);
+            previousColor = color;
+            previousLuma = luma;
+            ptr += 4;
+        }
+    }
+
+    features.colorCount = colors.GetCount();
+    features.edgeDensity = width > 0 && height > 0 ? static_cast<float>(static_cast<double>(edgePixels) / (static_cast<double>(width) * height)) : 0.0f;
+    features.hasTransparency = hasTransparency;
+    features.hasBinaryAlpha = binaryAlpha;
+    features.isGrayscale = grayscale;
+}
+
+void __stdcall WebPAnalyzeImage(const void* bitmap, int width, int height, int stride, ImageFeatures* features)
+{
+    if (bitmap == nullptr || features == nullptr)
+    {
+        return;
+    }
+
+    AnalyzeImage(bitmap, width, height, stride, *features);
+}
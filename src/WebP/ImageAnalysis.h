@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WebP.h"
+
+// The number of unique colors that ScanPixelTraits tracks, images with more colors report MaxTraitColors + 1.
+const int MaxTraitColors = 2;
+
+// The pixel properties that select the encoder shortcuts, see ApplyContentShortcuts.
+struct PixelTraits
+{
+    // At least one pixel is not fully opaque.
+    bool hasTransparency;
+    // Every alpha value is either 0 or 255.
+    bool binaryAlpha;
+    // The blue, green and red channels are equal in every pixel.
+    bool grayscale;
+    // The number of unique BGRA colors, up to MaxTraitColors + 1.
+    int colorCount;
+};
+
+// Computes the pixel traits of a BGRA bitmap in a single pass, the scan stops as soon as none of the
+// traits can change. This replaces the separate transparency scan of the encoder.
+void ScanPixelTraits(const void* bitmap, int width, int height, int stride, PixelTraits& traits);
+
+// Computes the content features of a BGRA bitmap in a single pass.
+void AnalyzeImage(const void* bitmap, int width, int height, int stride, ImageFeatures& features);
@@ -0,0 +1,173 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+#include <atomic>
+#include <new>
+#include "ImageMemory.h"
+
+namespace
+{
+    // Buffers smaller than this are allocated from the CRT heap.
+    const size_t VirtualAllocThreshold = 4 * 1024 * 1024;
+
+    enum AllocationKind : uint32_t
+    {
+        HeapAllocation = 0,
+        VirtualAllocation
+    };
+
+    // The header is stored in the IMAGE_MEMORY_ALIGNMENT bytes before the returned pointer.
+    struct AllocationHeader
+    {
+        AllocationKind kind;
+    };
+
+    // The large page size, or zero when large pages are not used.
+    std::atomic<size_t> largePageSize(0);
+
+    // Checks if the SeLockMemoryPrivilege is present and enabled in the process token.
+    // The token is only queried, the host is responsible for enabling the privilege.
+    bool HasLockMemoryPrivilege()
+    {
+        LUID lockMemory;
+        if (!LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &lockMemory))
+        {
+            return false;
+        }
+
+        HANDLE token;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token))
+        {
+            return false;
+        }
+
+        bool enabled = false;
+        DWORD size = 0;
+
+        GetTokenInformation(token, TokenPrivileges, nullptr, 0, &size);
+
+        if (size > 0)
+        {
+            std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[size]);
+
+            if (buffer != nullptr && GetTokenInformation(token, TokenPrivileges, buffer.get(), size, &size))
+            {
+                const TOKEN_PRIVILEGES* privileges = reinterpret_cast<const TOKEN_PRIVILEGES*>(buffer.get());
+
+                for (DWORD i = 0; i < privileges->PrivilegeCount; i++)
+                {
+                    const LUID_AND_ATTRIBUTES& privilege = privileges->Privileges[i];
+
+                    if (privilege.Luid.LowPart == lockMemory.LowPart &&
+                        privilege.Luid.HighPart == lockMemory.HighPart)
+                    {
+                        enabled = (privilege.Attributes & SE_PRIVILEGE_ENABLED) != 0;
+                        break;
+                    }
+                }
+            }
+        }
+
+        CloseHandle(token);
+
+        return enabled;
+    }
+
+    void* AllocateVirtualMemory(size_t size)
+    {
+        const size_t pageSize = largePageSize.load(std::memory_order_relaxed);
+
+        if (pageSize != 0)
+        {
+            const size_t largePageAllocationSize = (size + pageSize - 1) & ~(pageSize - 1);
+
+            void* memory = VirtualAlloc(nullptr, largePageAllocationSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (memory != nullptr)
+            {
+                return memory;
+            }
+
+            // The allocation fails when there is not enough contiguous physical memory,
+            // fall back to regular pages.
+        }
+
+        return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+}
+
+void* AllocateImageMemory(size_t size)
+{
+    if (size == 0 || size > SIZE_MAX - IMAGE_MEMORY_ALIGNMENT)
+    {
+        return nullptr;
+    }
+
+    const size_t allocationSize = size + IMAGE_MEMORY_ALIGNMENT;
+    uint8_t* base;
+    AllocationKind kind;
+
+    if (allocationSize >= VirtualAllocThreshold)
+    {
+        base = static_cast<uint8_t*>(AllocateVirtualMemory(allocationSize));
+        kind = VirtualAllocation;
+    }
+    else
+    {
+        base = static_cast<uint8_t*>(_aligned_malloc(allocationSize, IMAGE_MEMORY_ALIGNMENT));
+        kind = HeapAllocation;
+    }
+
+    if (base == nullptr)
+    {
+        return nullptr;
+    }
+
+    reinterpret_cast<AllocationHeader*>(base)->kind = kind;
+
+    return base + IMAGE_MEMORY_ALIGNMENT;
+}
+
+void FreeImageMemory(void* memory)
+{
+    if (memory == nullptr)
+    {
+        return;
+    }
+
+    uint8_t* base = static_cast<uint8_t*>(memory) - IMAGE_MEMORY_ALIGNMENT;
+
+    if (reinterpret_cast<const AllocationHeader*>(base)->kind == VirtualAllocation)
+    {
+        VirtualFree(base, 0, MEM_RELEASE);
+    }
+    else
+    {
+        _aligned_free(base);
+    }
+}
+
+bool EnableLargePageMemory(bool enabled)
+{
+    size_t pageSize = 0;
+
+    if (enabled && HasLockMemoryPrivilege())
+    {
+        pageSize = GetLargePageMinimum();
+    }
+
+    largePageSize.store(pageSize, std::memory_order_relaxed);
+
+    return pageSize != 0;
+}
@@ -0,0 +1,51 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+
+// The alignment of every image buffer, this is the cache line size of current x86 and ARM64 processors.
+#define IMAGE_MEMORY_ALIGNMENT 64
+
+// Allocates a buffer for image pixels, the returned pointer is aligned to IMAGE_MEMORY_ALIGNMENT.
+//
+// Buffers of at least a few megabytes are allocated directly from the virtual memory manager,
+// and use large pages when they have been enabled with EnableLargePageMemory.
+// A 16383 x 16383 image spans half a million 4 KB pages, so large pages remove most of
+// the TLB misses when the encoder walks the image.
+//
+// Only the buffers that this library allocates use this function, the lossy encoder's YUV planes
+// and the encoded output are allocated inside libwebp, and the decoders write to the caller's buffer.
+//
+// Returns nullptr if the memory could not be allocated.
+void* AllocateImageMemory(size_t size);
+
+void FreeImageMemory(void* memory);
+
+// Enables or disables large pages for the buffers that are allocated after the call.
+// Large pages cannot be paged out, so they are only used when the host asks for them and its
+// token already has the SeLockMemoryPrivilege enabled, the privilege is never enabled here.
+// Returns true if large pages will be used.
+bool EnableLargePageMemory(bool enabled);
+
+struct image_memory_deleter
+{
+    void operator()(uint8_t* memory)
+    {
+        FreeImageMemory(memory);
+    }
+};
+
+typedef std::unique_ptr<uint8_t, image_memory_deleter> ScopedImageMemory;
@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <string.h>
+#include "LinearConversion.h"
+
+#ifdef LINEAR_CONVERSION_SIMD_SUPPORTED
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // The rows are expanded in place, the 8-bit RGBA pixels that the decoder wrote at the start
+    // of the row are read from right to left so no source pixel is overwritten before it is read.
+
+    inline void ConvertPixelToFloat32(uint8_t* row, int x, const SrgbToLinearTable& table)
+    {
+        const uint8_t* src = row + (static_cast<size_t>(x) * 4);
+        const uint8_t r = src[0];
+        const uint8_t g = src[1];
+        const uint8_t b = src[2];
+        const float alpha = src[3] * (1.0f / 255.0f);
+
+        float* pixel = reinterpret_cast<float*>(row) + (static_cast<size_t>(x) * 4);
+        pixel[0] = table[r] * alpha;
+        pixel[1] = table[g] * alpha;
+        pixel[2] = table[b] * alpha;
+        pixel[3] = alpha;
+    }
+
+    inline void ConvertPixelToFloat16(uint8_t* row, int x, const SrgbToLinearTable& table)
+    {
+        const uint8_t* src = row + (static_cast<size_t>(x) * 4);
+        const uint8_t r = src[0];
+        const uint8_t g = src[1];
+        const uint8_t b = src[2];
+        const float alpha = src[3] * (1.0f / 255.0f);
+
+        uint16_t* pixel = reinterpret_cast<uint16_t*>(row) + (static_cast<size_t>(x) * 4);
+        pixel[0] = FloatToHalf(table[r] * alpha);
+        pixel[1] = FloatToHalf(table[g] * alpha);
+        pixel[2] = FloatToHalf(table[b] * alpha);
+        pixel[3] = FloatToHalf(alpha);
+    }
+
+#ifdef LINEAR_CONVERSION_SIMD_SUPPORTED
+    // Converts four 8-bit pixels to premultiplied linear light, the results are the same as the scalar conversion.
+    // The source pixels are read before any of the group is stored, because the first group overlaps its own source.
+    inline void PremultiplyPixels(const uint8_t* src, const SrgbToLinearTable& table, __m128 pixels[4])
+    {
+        const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        const __m128 alpha = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(packed, 24)), _mm_set1_ps(1.0f / 255.0f));
+
+        // The alpha lane of the color is 1, so the multiply stores the alpha unchanged.
+        pixels[0] = _mm_mul_ps(_mm_setr_ps(table[src[0]], table[src[1]], table[src[2]], 1.0f), _mm_shuffle_ps(alpha, alpha, _MM_SHUFFLE(0, 0, 0, 0)));
+        pixels[1] = _mm_mul_ps(_mm_setr_ps(table[src[4]], table[src[5]], table[src[6]], 1.0f), _mm_shuffle_ps(alpha, alpha, _MM_SHUFFLE(1, 1, 1, 1)));
+        pixels[2] = _mm_mul_ps(_mm_setr_ps(table[src[8]], table[src[9]], table[src[10]], 1.0f), _mm_shuffle_ps(alpha, alpha, _MM_SHUFFLE(2, 2, 2, 2)));
+        pixels[3] = _mm_mul_ps(_mm_setr_ps(table[src[12]], table[src[13]], table[src[14]], 1.0f), _mm_shuffle_ps(alpha, alpha, _MM_SHUFFLE(3, 3, 3, 3)));
+    }
+#endif
+}
+
+SrgbToLinearTable::SrgbToLinearTable()
+{
+    for (int i = 0; i < 256; i++)
+    {
+        const double value = i / 255.0;
+
+        table[i] = static_cast<float>(value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4));
+    }
+}
+
+const SrgbToLinearTable& GetSrgbToLinearTable()
+{
+    static const SrgbToLinearTable table;
+
+    return table;
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t absolute = bits & 0x7fffffff;
+
+    // The converted pixels are finite and non-negative, infinity and NaN do not need to be handled.
+    if (absolute >= 0x47800000)
+    {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+
+    if (absolute < 0x38800000)
+    {
+        // The value is a half precision subnormal, the mantissa is shifted with the implicit bit.
+        if (absolute < 0x33000000)
+        {
+            return static_cast<uint16_t>(sign);
+        }
+
+        const uint32_t exponent = absolute >> 23;
+        const uint32_t mantissa = (absolute & 0x7fffff) | 0x800000;
+        const uint32_t shift = 126 - exponent;
+        const uint32_t halfway = 1u << (shift - 1);
+        uint32_t result = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+
+        if (remainder > halfway || (remainder == halfway && (result & 1) != 0))
+        {
+            result++;
+        }
+
+        return static_cast<uint16_t>(sign | result);
+    }
+
+    // Rebias the exponent from 127 to 15 and round the 13 discarded mantissa bits,
+    // a carry out of the mantissa correctly increments the exponent.
+    const uint32_t rebiased = absolute - (112u << 23);
+    const uint32_t rounded = rebiased + 0xfff + ((rebiased >> 13) & 1);
+
+    return static_cast<uint16_t>(sign | (rounded >> 13));
+}
+
+void ConvertRowToFloat32Scalar(uint8_t* row, int width, const SrgbToLinearTable& table)
+{
+    for (int x = width - 1; x >= 0; x--)
+    {
+        ConvertPixelToFloat32(row, x, table);
+    }
+}
+
+void ConvertRowToFloat16Software(uint8_t* row, int width, const SrgbToLinearTable& table)
+{
+    for (int x = width - 1; x >= 0; x--)
+    {
+        ConvertPixelToFloat16(row, x, table);
+    }
+}
+
+#ifdef LINEAR_CONVERSION_SIMD_SUPPORTED
+void ConvertRowToFloat32Sse2(uint8_t* row, int width, const SrgbToLinearTable& table)
+{
+    const int vectorWidth = width & ~3;
+
+    // The pixels after the last group of four are the rightmost pixels, so they are converted first.
+    for (int x = width - 1; x >= vectorWidth; x--)
+    {
+        ConvertPixelToFloat32(row, x, table);
+    }
+
+    for (int x = vectorWidth - 4; x >= 0; x -= 4)
+    {
+        __m128 pixels[4];
+        PremultiplyPixels(row + (static_cast<size_t>(x) * 4), table, pixels);
+
+        float* dst = reinterpret_cast<float*>(row) + (static_cast<size_t>(x) * 4);
+        _mm_storeu_ps(dst, pixels[0]);
+        _mm_storeu_ps(dst + 4, pixels[1]);
+        _mm_storeu_ps(dst + 8, pixels[2]);
+        _mm_storeu_ps(dst + 12, pixels[3]);
+    }
+}
+
+bool IsF16cSupported()
+{
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+
+    // The VEX encoded instructions also require the operating system to save the AVX state.
+    const bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+    const bool avx = (cpuInfo[2] & (1 << 28)) != 0;
+    const bool f16c = (cpuInfo[2] & (1 << 29)) != 0;
+
+    return osxsave && avx && f16c && (_xgetbv(0) & 0x6) == 0x6;
+}
+
+void ConvertRowToFloat16Hardware(uint8_t* row, int width, const SrgbToLinearTable& table)
+{
+    const int vectorWidth = width & ~3;
+
+    // The pixels after the last group of four are the rightmost pixels, so they are converted first.
+    for (int x = width - 1; x >= vectorWidth; x--)
+    {
+        ConvertPixelToFloat16(row, x, table);
+    }
+
+    for (int x = vectorWidth - 4; x >= 0; x -= 4)
+    {
+        __m128 pixels[4];
+        PremultiplyPixels(row + (static_cast<size_t>(x) * 4), table, pixels);
+
+        // Each F16C conversion produces one pixel in the low half of the register.
+        const __m128i first = _mm_unpacklo_epi64(_mm_cvtps_ph(pixels[0], _MM_FROUND_TO_NEAREST_INT),
+                                                 _mm_cvtps_ph(pixels[1], _MM_FROUND_TO_NEAREST_INT));
+        const __m128i second = _mm_unpacklo_epi64(_mm_cvtps_ph(pixels[2], _MM_FROUND_TO_NEAREST_INT),
+                                                  _mm_cvtps_ph(pixels[3], _MM_FROUND_TO_NEAREST_INT));
+
+        uint8_t* dst = row + (static_cast<size_t>(x) * 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), first);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), second);
+    }
+}
+#endif
+
+void ConvertRowToFloat32(uint8_t* row, int width, const SrgbToLinearTable& table)
+{
+#ifdef LINEAR_CONVERSION_SIMD_SUPPORTED
+    // SSE2 is part of the x64 baseline, and the x86 build targets it by default.
+    ConvertRowToFloat32Sse2(row, width, table);
+#else
+    ConvertRowToFloat32Scalar(row, width, table);
+#endif
+}
+
+void ConvertRowToFloat16(uint8_t* row, int width, const SrgbToLinearTable& table)
+{
+#ifdef LINEAR_CONVERSION_SIMD_SUPPORTED
+    static const bool hardwareSupported = IsF16cSupported();
+
+    if (hardwareSupported)
+    {
+        ConvertRowToFloat16Hardware(row, width, table);
+        return;
+    }
+#endif
+
+    ConvertRowToFloat16Software(row, width, table);
+}
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#define LINEAR_CONVERSION_SIMD_SUPPORTED 1
+#endif
+
+// Maps the 8-bit sRGB values to linear light.
+class SrgbToLinearTable
+{
+public:
+    SrgbToLinearTable();
+
+    float operator[](uint8_t value) const
+    {
+        return table[value];
+    }
+
+private:
+    float table[256];
+};
+
+const SrgbToLinearTable& GetSrgbToLinearTable();
+
+// Converts a single precision value to half precision, rounding to the nearest even value.
+uint16_t FloatToHalf(float value);
+
+// The row converters expand a row of unpremultiplied 8-bit RGBA pixels in place to premultiplied
+// linear-light RGBA, the 8-bit pixels are stored at the start of the row.
+
+void ConvertRowToFloat32Scalar(uint8_t* row, int width, const SrgbToLinearTable& table);
+
+void ConvertRowToFloat16Software(uint8_t* row, int width, const SrgbToLinearTable& table);
+
+#ifdef LINEAR_CONVERSION_SIMD_SUPPORTED
+// Converts four pixels per iteration with SSE2, the result is the same as ConvertRowToFloat32Scalar.
+void ConvertRowToFloat32Sse2(uint8_t* row, int width, const SrgbToLinearTable& table);
+
+// Returns true if the processor and the operating system support the F16C instructions.
+bool IsF16cSupported();
+
+// Converts four pixels per iteration with SSE2 and F16C, the result is the same as ConvertRowToFloat16Software.
+void ConvertRowToFloat16Hardware(uint8_t* row, int width, const SrgbToLinearTable& table);
+#endif
+
+// Uses the fastest converter that the processor supports.
+void ConvertRowToFloat32(uint8_t* row, int width, const SrgbToLinearTable& table);
+
+// Uses the fastest converter that the processor supports.
+void ConvertRowToFloat16(uint8_t* row, int width, const SrgbToLinearTable& table);
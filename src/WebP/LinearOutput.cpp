@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "WebP.h"
+#include "LinearConversion.h"
+
+namespace
+{
+    void ConvertRows(uint8_t* outData, int outStride, int width, int firstRow, int lastRow, LinearPixelFormat format)
+    {
+        const SrgbToLinearTable& table = GetSrgbToLinearTable();
+
+        for (int y = firstRow; y < lastRow; y++)
+        {
+            uint8_t* row = outData + (static_cast<size_t>(y) * outStride);
+
+            if (format == LinearPixelFormatFloat32)
+            {
+                ConvertRowToFloat32(row, width, table);
+            }
+            else
+            {
+                ConvertRowToFloat16(row, width, table);
+            }
+        }
+    }
+}
+
+int __stdcall WebPLoadLinear(
+    const uint8_t* data,
+    size_t dataSize,
+    void* outData,
+    size_t outSize,
+    int outStride,
+    LinearPixelFormat format)
+{
+    if (data == nullptr || outData == nullptr)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    if (format != LinearPixelFormatFloat32 && format != LinearPixelFormatFloat16)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    const size_t bytesPerPixel = format == LinearPixelFormatFloat32 ? 16 : 8;
+    const size_t channelSize = bytesPerPixel / 4;
+
+    // Every row must start on a channel boundary.
+    if ((reinterpret_cast<uintptr_t>(outData) & (channelSize - 1)) != 0 || outStride < 0 || (outStride & (channelSize - 1)) != 0)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    WebPDecoderConfig config;
+
+    if (!WebPInitDecoderConfig(&config))
+    {
+        return errVersionMismatch;
+    }
+
+    VP8StatusCode status = WebPGetFeatures(data, dataSize, &config.input);
+    if (status != VP8_STATUS_OK)
+    {
+        return status;
+    }
+
+    const int width = config.input.width;
+    const int height = config.input.height;
+
+    if (static_cast<uint64_t>(outStride) < static_cast<uint64_t>(width) * bytesPerPixel ||
+        outSize < (static_cast<uint64_t>(outStride) * (height - 1)) + (static_cast<uint64_t>(width) * bytesPerPixel))
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    uint8_t* output = static_cast<uint8_t*>(outData);
+
+    // The alpha is premultiplied after the color has been converted to linear light,
+    // so the decoder writes unpremultiplied RGBA at the start of each output row.
+    config.output.colorspace = MODE_RGBA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = output;
+    config.output.u.RGBA.size = outSize;
+    config.output.u.RGBA.stride = outStride;
+
+    WebPIDecoder* idec = WebPIDecode(nullptr, 0, &config);
+    if (idec == nullptr)
+    {
+        return VP8_STATUS_OUT_OF_MEMORY;
+    }
+
+    // The completed rows are converted after each block of input, while they are still in the cache.
+    const size_t blockSize = 64 * 1024;
+    size_t available = 0;
+    int convertedRows = 0;
+
+    do
+    {
+        available = dataSize - available > blockSize ? available + blockSize : dataSize;
+
+        status = WebPIUpdate(idec, data, available);
+
+        int decodedRows = 0;
+        if ((status == VP8_STATUS_OK || status == VP8_STATUS_SUSPENDED) &&
+            WebPIDecGetRGB(idec, &decodedRows, nullptr, nullptr, nullptr) != nullptr &&
+            decodedRows > convertedRows)
+        {
+            ConvertRows(output, outStride, width, convertedRows, decodedRows, format);
+            convertedRows = decodedRows;
+        }
+    } while (status == VP8_STATUS_SUSPENDED && available < dataSize);
+
+    if (status == VP8_STATUS_SUSPENDED)
+    {
+        status = VP8_STATUS_NOT_ENOUGH_DATA;
+    }
+
+    WebPIDelete(idec);
+    WebPFreeDecBuffer(&config.output);
+
+    if (status == VP8_STATUS_OK && convertedRows < height)
+    {
+        ConvertRows(output, outStride, width, convertedRows, height, format);
+    }
+
+    return status;
+}
@@ -0,0 +1,293 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <Windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "LosslessCruncher.h"
+#include "WorkerPool.h"
+
+namespace
+{
+    // A rough upper bound of the memory that libwebp's lossless encoder allocates for each pixel:
+    // its copy of the ARGB pixels, the hash chain and the backward reference buffers.
+    const uint64_t LosslessEncoderBytesPerPixel = 40;
+
+    // The memory that the candidates can use, half of the physical memory that is currently available.
+    uint64_t GetCandidateMemoryBudget()
+    {
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+
+        if (!GlobalMemoryStatusEx(&status))
+        {
+            return 0;
+        }
+
+        return status.ullAvailPhys / 2;
+    }
+
+    struct CrunchState
+    {
+        CrunchState(int timeLimit, ProgressFn progressCallback)
+            : progressCallback(progressCallback), hasDeadline(timeLimit > 0), deadline(), cancelled(false),
+              bestSize(std::numeric_limits<size_t>::max()), bestIndex(-1), mutex()
+        {
+            if (hasDeadline)
+            {
+                deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeLimit);
+            }
+        }
+
+        bool IsPastDeadline() const
+        {
+            return hasDeadline && std::chrono::steady_clock::now() >= deadline;
+        }
+
+        ProgressFn progressCallback;
+        bool hasDeadline;
+        std::chrono::steady_clock::time_point deadline;
+        std::atomic<bool> cancelled;
+        std::atomic<size_t> bestSize;
+        int bestIndex;
+        std::mutex mutex;
+    };
+
+    struct CrunchCandidate
+    {
+        CrunchCandidate(const WebPConfig& config, CrunchState* state, int index)
+            : config(config), picture(), output(), state(state), index(index), error(VP8_ENC_OK)
+        {
+        }
+
+        bool IsBaseline() const
+        {
+            return index == 0;
+        }
+
+        WebPConfig config;
+        ScopedWebPPicture picture;
+        ScopedWebPMemoryWriter output;
+        CrunchState* state;
+        int index;
+        int error;
+    };
+
+    int CandidateWrite(const uint8_t* data, size_t dataSize, const WebPPicture* picture)
+    {
+        const CrunchCandidate* candidate = static_cast<const CrunchCandidate*>(picture->user_data);
+
+        // The lossless encoder writes the whole bitstream when it has finished encoding, so this only
+        // avoids copying an output that is larger than the current best, it does not stop the encode early.
+        if (!candidate->IsBaseline() && candidate->output.GetBufferSize() + dataSize >= candidate->state->bestSize.load())
+        {
+            return 0;
+        }
+
+        return WebPMemoryWrite(data, dataSize, picture);
+    }
+
+    int CandidateProgress(int percent, const WebPPicture* picture)
+    {
+        const CrunchCandidate* candidate = static_cast<const CrunchCandidate*>(picture->user_data);
+        CrunchState* state = candidate->state;
+
+        WorkerPool::GetInstance().YieldToInteractiveWork();
+
+        if (state->cancelled.load())
+        {
+            return 0;
+        }
+
+        if (candidate->IsBaseline())
+        {
+            if (state->progressCallback != nullptr && !state->progressCallback(percent))
+            {
+                state->cancelled.store(true);
+                return 0;
+            }
+
+            return 1;
+        }
+
+        return state->IsPastDeadline() ? 0 : 1;
+    }
+
+    void EncodeCandidate(CrunchCandidate* candidate, const WebPPicture* source)
+    {
+        CrunchState* state = candidate->state;
+
+        if (!candidate->IsBaseline() && (state->cancelled.load() || state->IsPastDeadline()))
+        {
+            candidate->error = VP8_ENC_ERROR_USER_ABORT;
+            return;
+        }
+
+        WebPPicture* picture = candidate->picture.Get();
+
+        if (picture == nullptr || candidate->output == nullptr)
+        {
+            candidate->error = VP8_ENC_ERROR_OUT_OF_MEMORY;
+            return;
+        }
+
+        // The encoder replaces the color of the transparent pixels in place when the exact option is not set,
+        // so those candidates encode their own copy. Otherwise the view shares the ARGB pixels of the source picture.
+        const bool imported = candidate->config.exact ?
+            WebPPictureView(source, 0, 0, source->width, source->height, picture) != 0 :
+            WebPPictureCopy(source, picture) != 0;
+
+        if (!imported)
+        {
+            candidate->error = VP8_ENC_ERROR_OUT_OF_MEMORY;
+            return;
+        }
+
+        picture->writer = CandidateWrite;
+        picture->custom_ptr = candidate->output.Get();
+        picture->user_data = candidate;
+        picture->progress_hook = CandidateProgress;
+        picture->stats = nullptr;
+
+        if (WebPEncode(&candidate->config, picture) != 0)
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            const size_t size = candidate->output.GetBufferSize();
+
+            if (size < state->bestSize.load())
+            {
+                state->bestSize.store(size);
+                state->bestIndex = candidate->index;
+            }
+        }
+        else
+        {
+            candidate->error = static_cast<int>(picture->error_code);
+        }
+
+        // Only the encoded output is kept until every candidate has finished.
+        candidate->picture.Release();
+    }
+}
+
+int CrunchLossless(
+    const WebPConfig& baseConfig,
+    WebPPicture* picture,
+    int timeLimit,
+    ProgressFn progressCallback,
+    ScopedWebPMemoryWriter& output)
+{
+    if (picture == nullptr || picture->argb == nullptr || !baseConfig.lossless)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    std::vector<WebPConfig> configs;
+    configs.push_back(baseConfig);
+
+    static const WebPImageHint imageHints[] =
+    {
+        WEBP_HINT_DEFAULT,
+        WEBP_HINT_PICTURE,
+        WEBP_HINT_PHOTO,
+        WEBP_HINT_GRAPH
+    };
+
+    for (WebPImageHint hint : imageHints)
+    {
+        if (hint != baseConfig.image_hint)
+        {
+            WebPConfig config = baseConfig;
+            config.image_hint = hint;
+            configs.push_back(config);
+        }
+    }
+
+    if (baseConfig.quality < 100.0f || baseConfig.method < 6)
+    {
+        // The maximum lossless compression effort.
+        WebPConfig config = baseConfig;
+        config.quality = 100.0f;
+        config.method = 6;
+        configs.push_back(config);
+    }
+
+    CrunchState state(timeLimit, progressCallback);
+    std::vector<std::unique_ptr<CrunchCandidate>> candidates;
+
+    for (size_t i = 0; i < configs.size(); i++)
+    {
+        candidates.push_back(std::unique_ptr<CrunchCandidate>(new CrunchCandidate(configs[i], &state, static_cast<int>(i))));
+    }
+
+    // Each encoder allocates its own state for the whole image, so the number of alternatives that run
+    // at the same time as the base configuration is limited by the available memory.
+    const uint64_t pixelCount = static_cast<uint64_t>(picture->width) * static_cast<uint64_t>(picture->height);
+    const uint64_t candidateMemory = pixelCount * (LosslessEncoderBytesPerPixel + (baseConfig.exact ? 0 : sizeof(uint32_t)));
+    const uint64_t memoryBudget = GetCandidateMemoryBudget();
+    const size_t alternativeCount = candidates.size() - 1;
+
+    size_t concurrentAlternatives = 0;
+
+    if (candidateMemory > 0 && memoryBudget > candidateMemory)
+    {
+        concurrentAlternatives = static_cast<size_t>(std::min<uint64_t>((memoryBudget - candidateMemory) / candidateMemory, alternativeCount));
+    }
+
+    std::atomic<size_t> nextAlternative(1);
+
+    auto runAlternatives = [&candidates, &nextAlternative, picture]()
+    {
+        for (size_t i = nextAlternative.fetch_add(1); i < candidates.size(); i = nextAlternative.fetch_add(1))
+        {
+            EncodeCandidate(candidates[i].get(), picture);
+        }
+    };
+
+    {
+        TaskGroup group;
+
+        for (size_t i = 0; i < concurrentAlternatives; i++)
+        {
+            group.Run(runAlternatives);
+        }
+
+        EncodeCandidate(candidates[0].get(), picture);
+
+        if (candidates[0]->error != VP8_ENC_OK)
+        {
+            state.cancelled.store(true);
+        }
+        else if (concurrentAlternatives == 0)
+        {
+            // The alternatives run one at a time after the base configuration when two encoders do not fit.
+            runAlternatives();
+        }
+
+        group.Wait();
+    }
+
+    if (candidates[0]->error != VP8_ENC_OK)
+    {
+        return candidates[0]->error;
+    }
+
+    output.Swap(candidates[state.bestIndex]->output);
+
+    return VP8_ENC_OK;
+}
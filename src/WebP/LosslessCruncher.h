@@ -0,0 +1,34 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WebP.h"
+#include "scoped.h"
+
+// Encodes the ARGB picture with the base lossless configuration and a set of alternative
+// lossless configurations in parallel, and stores the smallest result in the output writer.
+//
+// The base configuration always runs to completion on the calling thread and receives the
+// progress callback, the alternatives are cancelled when the time limit (in milliseconds, 0 for no limit)
+// expires. The size of an alternative is only known when it has finished encoding, so the time limit
+// is what bounds the cost of the alternatives.
+// Every encoder allocates its own state for the whole image, so the number of alternatives that run at the same time
+// is limited by the available physical memory, they run one at a time after the base configuration when it is low.
+//
+// Returns VP8_ENC_OK on success, or the WebPEncodingError of the base configuration.
+int CrunchLossless(
+    const WebPConfig& baseConfig,
+    WebPPicture* picture,
+    int timeLimit,
+    ProgressFn progressCallback,
+    ScopedWebPMemoryWriter& output);
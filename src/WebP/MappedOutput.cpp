@@ -0,0 +1,173 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "WebP.h"
+
+namespace
+{
+    // The decoded rows are written back and trimmed from the working set in batches of at least this size.
+    const size_t ReleaseBatchSize = 4 * 1024 * 1024;
+
+    class ScopedMappedView
+    {
+    public:
+        ScopedMappedView(HANDLE fileMapping, uint64_t offset, size_t size)
+            : view(static_cast<uint8_t*>(MapViewOfFile(
+                fileMapping,
+                FILE_MAP_WRITE,
+                static_cast<DWORD>(offset >> 32),
+                static_cast<DWORD>(offset & 0xffffffff),
+                size)))
+        {
+        }
+
+        ~ScopedMappedView()
+        {
+            if (view != nullptr)
+            {
+                UnmapViewOfFile(view);
+                view = nullptr;
+            }
+        }
+
+        uint8_t* Get() const
+        {
+            return view;
+        }
+
+    private:
+        ScopedMappedView(const ScopedMappedView&) = delete;
+        ScopedMappedView& operator=(const ScopedMappedView&) = delete;
+
+        uint8_t* view;
+    };
+
+    // Writes the pages that hold completed rows back to the file and removes them from the working set,
+    // the memory manager can then reuse the physical pages without writing them to the page file.
+    void ReleasePages(uint8_t* view, size_t start, size_t end)
+    {
+        if (end > start)
+        {
+            FlushViewOfFile(view + start, end - start);
+
+            // VirtualUnlock fails with ERROR_NOT_LOCKED for pages that are not locked,
+            // but it still removes them from the working set of the process.
+            VirtualUnlock(view + start, end - start);
+        }
+    }
+}
+
+int __stdcall WebPLoadToFileMapping(const uint8_t* data, size_t dataSize, void* fileMapping, uint64_t offset, int outStride)
+{
+    if (data == nullptr || fileMapping == nullptr || fileMapping == INVALID_HANDLE_VALUE)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    WebPDecoderConfig config;
+
+    if (!WebPInitDecoderConfig(&config))
+    {
+        return errVersionMismatch;
+    }
+
+    VP8StatusCode status = WebPGetFeatures(data, dataSize, &config.input);
+    if (status != VP8_STATUS_OK)
+    {
+        return status;
+    }
+
+    const int width = config.input.width;
+    const int height = config.input.height;
+
+    if (outStride < 0 || static_cast<int64_t>(outStride) < static_cast<int64_t>(width) * 4)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    const size_t outSize = (static_cast<size_t>(outStride) * (height - 1)) + (static_cast<size_t>(width) * 4);
+
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+
+    // The view must start at a multiple of the allocation granularity.
+    const uint64_t viewOffset = offset & ~static_cast<uint64_t>(systemInfo.dwAllocationGranularity - 1);
+    const size_t imageOffset = static_cast<size_t>(offset - viewOffset);
+    const size_t viewSize = imageOffset + outSize;
+    const size_t pageMask = ~static_cast<size_t>(systemInfo.dwPageSize - 1);
+
+    // MapViewOfFile fails if the requested range extends past the end of the file mapping.
+    ScopedMappedView view(fileMapping, viewOffset, viewSize);
+    if (view.Get() == nullptr)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    config.output.colorspace = MODE_BGRA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = view.Get() + imageOffset;
+    config.output.u.RGBA.size = outSize;
+    config.output.u.RGBA.stride = outStride;
+
+    WebPIDecoder* idec = WebPIDecode(nullptr, 0, &config);
+    if (idec == nullptr)
+    {
+        return VP8_STATUS_OUT_OF_MEMORY;
+    }
+
+    // The decoder only writes each row once, so the pages that hold completed rows can be released
+    // while the rest of the image is decoded. This bounds the resident memory of the output to one
+    // release batch, the decoder state is not affected. A lossy image only needs a few rows of decoder
+    // state, but the lossless decoder keeps a full size ARGB copy of the image until the decode has
+    // finished, so a lossless image still needs about as much memory as the output.
+    const size_t blockSize = 64 * 1024;
+    size_t available = 0;
+    size_t releasedEnd = 0;
+
+    do
+    {
+        available = dataSize - available > blockSize ? available + blockSize : dataSize;
+
+        status = WebPIUpdate(idec, data, available);
+
+        int decodedRows = 0;
+        if ((status == VP8_STATUS_OK || status == VP8_STATUS_SUSPENDED) &&
+            WebPIDecGetRGB(idec, &decodedRows, nullptr, nullptr, nullptr) != nullptr)
+        {
+            // The last page may be shared with a row that is still being decoded.
+            const size_t completedEnd = (imageOffset + (static_cast<size_t>(outStride) * decodedRows)) & pageMask;
+
+            if (completedEnd > releasedEnd && completedEnd - releasedEnd >= ReleaseBatchSize)
+            {
+                ReleasePages(view.Get(), releasedEnd, completedEnd);
+                releasedEnd = completedEnd;
+            }
+        }
+    } while (status == VP8_STATUS_SUSPENDED && available < dataSize);
+
+    if (status == VP8_STATUS_SUSPENDED)
+    {
+        status = VP8_STATUS_NOT_ENOUGH_DATA;
+    }
+
+    WebPIDelete(idec);
+    WebPFreeDecBuffer(&config.output);
+
+    if (status == VP8_STATUS_OK)
+    {
+        ReleasePages(view.Get(), releasedEnd, viewSize);
+    }
+
+    return status;
+}
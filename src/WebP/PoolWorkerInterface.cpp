@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <mutex>
+#include <new>
+#include <string.h>
+#include "PoolWorkerInterface.h"
+#include "WorkerPool.h"
+#include "src/utils/thread_utils.h"
+
+namespace
+{
+    // The state of a worker is kept in this structure instead of the status field of WebPWorker,
+    // which is private to the libwebp implementation of the interface.
+    // Only the impl_ field, which is reserved for the interface implementation, and the hook, data
+    // and error fields that the libwebp callers use are accessed.
+    struct PoolWorker
+    {
+        PoolWorker() : group(), launched(false)
+        {
+        }
+
+        TaskGroup group;
+        bool launched;
+    };
+
+    void PoolWorkerExecute(WebPWorker* const worker)
+    {
+        WebPWorkerHook hook = worker->hook;
+
+        if (hook != nullptr)
+        {
+            worker->had_error |= !hook(worker->data1, worker->data2);
+        }
+    }
+
+    int PoolWorkerSync(WebPWorker* const worker)
+    {
+        PoolWorker* poolWorker = static_cast<PoolWorker*>(worker->impl_);
+
+        if (poolWorker != nullptr && poolWorker->launched)
+        {
+            // Waiting on the group makes the worker's job visible to this thread.
+            poolWorker->group.Wait();
+            poolWorker->launched = false;
+        }
+
+        return !worker->had_error;
+    }
+
+    void PoolWorkerInit(WebPWorker* const worker)
+    {
+        memset(worker, 0, sizeof(*worker));
+    }
+
+    int PoolWorkerReset(WebPWorker* const worker)
+    {
+        worker->had_error = 0;
+
+        if (worker->impl_ == nullptr)
+        {
+            worker->impl_ = new (std::nothrow) PoolWorker();
+
+            return worker->impl_ != nullptr;
+        }
+
+        return PoolWorkerSync(worker);
+    }
+
+    void PoolWorkerLaunch(WebPWorker* const worker)
+    {
+        PoolWorker* poolWorker = static_cast<PoolWorker*>(worker->impl_);
+
+        if (poolWorker != nullptr && !poolWorker->launched)
+        {
+            poolWorker->launched = true;
+
+            poolWorker->group.Run([worker]()
+            {
+                PoolWorkerExecute(worker);
+            });
+        }
+    }
+
+    void PoolWorkerEnd(WebPWorker* const worker)
+    {
+        PoolWorker* poolWorker = static_cast<PoolWorker*>(worker->impl_);
+
+        if (poolWorker != nullptr)
+        {
+            PoolWorkerSync(worker);
+
+            delete poolWorker;
+            worker->impl_ = nullptr;
+        }
+    }
+
+    const WebPWorkerInterface poolWorkerInterface =
+    {
+        PoolWorkerInit,
+        PoolWorkerReset,
+        PoolWorkerSync,
+        PoolWorkerLaunch,
+        PoolWorkerExecute,
+        PoolWorkerEnd
+    };
+}
+
+void InstallPoolWorkerInterface()
+{
+    static std::once_flag installed;
+
+    std::call_once(installed, []()
+    {
+        WebPSetWorkerInterface(&poolWorkerInterface);
+    });
+}
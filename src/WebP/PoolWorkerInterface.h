@@ -0,0 +1,23 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Replaces the libwebp worker interface with one that runs the worker jobs on the native worker pool.
+// libwebp uses these workers to encode the alpha plane concurrently with the VP8 color planes,
+// by default each worker creates and destroys its own thread for every image.
+//
+// libwebp is linked statically, so the interface only applies to the encoders and decoders in this library.
+// The decoders do not launch workers because the decoder threading option is not used.
+//
+// This function is safe to call multiple times, only the first call installs the interface.
+void InstallPoolWorkerInterface();
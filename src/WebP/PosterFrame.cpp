@@ -0,0 +1,206 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "Animation.h"
+#include "scoped.h"
+#include "ImageMemory.h"
+#include "RiffWriter.h"
+
+namespace
+{
+    int GetEncodingError(VP8StatusCode status)
+    {
+        return status == VP8_STATUS_OUT_OF_MEMORY ? VP8_ENC_ERROR_OUT_OF_MEMORY : VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    // Writes the frame chunks in a still image container, the bitstream is copied without decoding it.
+    int WriteFrameBitstream(const WebPIterator& iter, const WebPData& iccProfile, WriteImageFn writeImageCallback)
+    {
+        const uint8_t* frameData = iter.fragment.bytes;
+        const size_t frameSize = iter.fragment.size;
+
+        // The alpha plane of a lossy frame is stored in an ALPH chunk, which requires the extended format.
+        const bool hasAlphaChunk = frameSize >= ChunkHeaderSize && ReadLE32(frameData) == AlphFourCC;
+        const bool useVP8X = hasAlphaChunk || iccProfile.size > 0;
+
+        uint8_t header[RiffHeaderSize + ChunkHeaderSize + VP8XChunkSize + ChunkHeaderSize];
+        size_t headerSize = RiffHeaderSize;
+        uint64_t riffSize = 4 + static_cast<uint64_t>(frameSize);
+
+        if (useVP8X)
+        {
+            uint32_t flags = 0;
+
+            if (iter.has_alpha)
+            {
+                flags |= ALPHA_FLAG;
+            }
+
+            if (iccProfile.size > 0)
+            {
+                flags |= ICCP_FLAG;
+            }
+
+            WriteVP8XChunk(header + headerSize, flags, iter.width, iter.height);
+            headerSize += GetChunkSize(VP8XChunkSize);
+            riffSize += GetChunkSize(VP8XChunkSize);
+
+            if (iccProfile.size > 0)
+            {
+                WriteChunkHeader(header + headerSize, IccpFourCC, static_cast<uint32_t>(iccProfile.size));
+                headerSize += ChunkHeaderSize;
+                riffSize += GetChunkSize(iccProfile.size);
+            }
+        }
+
+        if (riffSize > UINT32_MAX)
+        {
+            return VP8_ENC_ERROR_FILE_TOO_BIG;
+        }
+
+        WriteRiffHeader(header, static_cast<uint32_t>(riffSize));
+
+        int error = writeImageCallback(header, headerSize);
+
+        if (error == VP8_ENC_OK && iccProfile.size > 0)
+        {
+            const uint8_t padding = 0;
+
+            error = writeImageCallback(iccProfile.bytes, iccProfile.size);
+
+            if (error == VP8_ENC_OK && (iccProfile.size & 1) != 0)
+            {
+                error = writeImageCallback(&padding, 1);
+            }
+        }
+
+        if (error == VP8_ENC_OK)
+        {
+            error = writeImageCallback(frameData, frameSize);
+        }
+
+        return error;
+    }
+
+    // Composites the frame from the closest key frame and encodes the canvas.
+    int EncodeCompositedFrame(
+        const WebPDemuxer* demux,
+        int frameIndex,
+        const WebPData& iccProfile,
+        const EncodeParams* encodeOptions,
+        WriteImageFn writeImageCallback)
+    {
+        const int canvasWidth = static_cast<int>(WebPDemuxGetI(demux, WEBP_FF_CANVAS_WIDTH));
+        const int canvasHeight = static_cast<int>(WebPDemuxGetI(demux, WEBP_FF_CANVAS_HEIGHT));
+        const int canvasStride = canvasWidth * 4;
+
+        ScopedImageMemory canvas(static_cast<uint8_t*>(AllocateImageMemory(static_cast<size_t>(canvasStride) * canvasHeight)));
+        if (canvas == nullptr)
+        {
+            return VP8_ENC_ERROR_OUT_OF_MEMORY;
+        }
+
+        int firstFrame = frameIndex;
+
+        while (!IsKeyFrame(demux, firstFrame))
+        {
+            firstFrame--;
+        }
+
+        const VP8StatusCode status = CompositeAnimationFrames(demux, canvas.get(), canvasStride, firstFrame, frameIndex, nullptr);
+        if (status != VP8_STATUS_OK)
+        {
+            return GetEncodingError(status);
+        }
+
+        MetadataParams metadata;
+        memset(&metadata, 0, sizeof(metadata));
+
+        metadata.iccProfile = const_cast<uint8_t*>(iccProfile.bytes);
+        metadata.iccProfileSize = iccProfile.size;
+
+        return WebPSave(writeImageCallback, canvas.get(), canvasWidth, canvasHeight, canvasStride, encodeOptions, &metadata, nullptr);
+    }
+}
+
+int __stdcall WebPExtractFrame(
+    const uint8_t* data,
+    size_t dataSize,
+    int frameIndex,
+    const EncodeParams* encodeOptions,
+    const WriteImageFn writeImageCallback)
+{
+    if (data == nullptr || encodeOptions == nullptr || writeImageCallback == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    WebPData webpData;
+    webpData.bytes = data;
+    webpData.size = dataSize;
+
+    ScopedWebPDemuxer demux(WebPDemux(&webpData));
+    if (demux == nullptr)
+    {
+        return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    const int frameCount = static_cast<int>(WebPDemuxGetI(demux.get(), WEBP_FF_FRAME_COUNT));
+
+    if (frameIndex < 0 || frameIndex >= frameCount)
+    {
+        return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    WebPData iccProfile = {};
+    WebPChunkIterator chunkIter;
+
+    if (WebPDemuxGetChunk(demux.get(), "ICCP", 1, &chunkIter))
+    {
+        // The chunk data points into the file data, it remains valid after the iterator is released.
+        iccProfile = chunkIter.chunk;
+        WebPDemuxReleaseChunkIterator(&chunkIter);
+    }
+
+    WebPIterator iter;
+
+    if (!WebPDemuxGetFrame(demux.get(), frameIndex + 1, &iter))
+    {
+        return VP8_ENC_ERROR_INVALID_CONFIGURATION;
+    }
+
+    const int canvasWidth = static_cast<int>(WebPDemuxGetI(demux.get(), WEBP_FF_CANVAS_WIDTH));
+    const int canvasHeight = static_cast<int>(WebPDemuxGetI(demux.get(), WEBP_FF_CANVAS_HEIGHT));
+
+    // A key frame that covers the canvas is drawn without reading the canvas, so the decoded
+    // frame is the composited image and its bitstream can be copied into a still image.
+    const bool copyBitstream = iter.x_offset == 0 &&
+                               iter.y_offset == 0 &&
+                               iter.width == canvasWidth &&
+                               iter.height == canvasHeight &&
+                               IsKeyFrame(demux.get(), frameIndex);
+
+    int error;
+
+    if (copyBitstream)
+    {
+        error = WriteFrameBitstream(iter, iccProfile, writeImageCallback);
+    }
+    else
+    {
+        error = EncodeCompositedFrame(demux.get(), frameIndex, iccProfile, encodeOptions, writeImageCallback);
+    }
+
+    WebPDemuxReleaseIterator(&iter);
+
+    return error;
+}
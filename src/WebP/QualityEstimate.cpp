@@ -0,0 +1,380 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include "WebP.h"
+#include "RiffReader.h"
+
+namespace
+{
+    const size_t VP8FrameHeaderSize = 10;
+    const int MaxSegments = 4;
+    const int MaxQuantizerIndex = 127;
+    // The center of the compression factor interval that maps to the largest quantizer index.
+    const double MinCompression = 0.5 / MaxQuantizerIndex;
+
+    // The boolean entropy decoder that is used for the VP8 frame header, see RFC 6386 section 7.
+    class BoolDecoder
+    {
+    public:
+        BoolDecoder(const uint8_t* data, size_t size) : data(data), end(data + size), value(0), range(255), bitCount(0), overrun(false)
+        {
+            value = (ReadByte() << 8) | ReadByte();
+        }
+
+        bool HasOverrun() const
+        {
+            return overrun;
+        }
+
+        int ReadBool(int probability)
+        {
+            const uint32_t split = 1 + (((range - 1) * probability) >> 8);
+            const uint32_t bigSplit = split << 8;
+            int bit;
+
+            if (value >= bigSplit)
+            {
+                range -= split;
+                value -= bigSplit;
+                bit = 1;
+            }
+            else
+            {
+                range = split;
+                bit = 0;
+            }
+
+            while (range < 128)
+            {
+                value <<= 1;
+                range <<= 1;
+
+                if (++bitCount == 8)
+                {
+                    bitCount = 0;
+                    value |= ReadByte();
+                }
+            }
+
+            return bit;
+        }
+
+        int ReadLiteral(int bits)
+        {
+            int result = 0;
+
+            while (bits-- > 0)
+            {
+                result = (result << 1) | ReadBool(128);
+            }
+
+            return result;
+        }
+
+        // Reads an optional signed value that is stored as a flag, the magnitude and a sign bit.
+        int ReadOptionalSigned(int bits)
+        {
+            if (!ReadLiteral(1))
+            {
+                return 0;
+            }
+
+            const int magnitude = ReadLiteral(bits);
+
+            return ReadLiteral(1) ? -magnitude : magnitude;
+        }
+
+    private:
+        uint32_t ReadByte()
+        {
+            if (data < end)
+            {
+                return *data++;
+            }
+
+            // The decoder reads up to two bytes ahead of the last bit, libwebp treats
+            // the missing bytes as zeros and so does this decoder.
+            if (bitCount != 0 || range < 128)
+            {
+                overrun = true;
+            }
+
+            return 0;
+        }
+
+        const uint8_t* data;
+        const uint8_t* end;
+        uint32_t value;
+        uint32_t range;
+        int bitCount;
+        bool overrun;
+    };
+
+    struct FrameQuantizers
+    {
+        int segmentCount;
+        int quantizers[MaxSegments];
+        // The fraction of the macroblocks that use each segment.
+        double weights[MaxSegments];
+    };
+
+    // Reads the luma AC quantizer index of each segment from the first partition of a VP8 key frame.
+    bool ReadFrameQuantizers(const RiffChunk& chunk, FrameQuantizers& frame)
+    {
+        if (chunk.payloadSize < VP8FrameHeaderSize)
+        {
+            return false;
+        }
+
+        const uint8_t* payload = chunk.payload;
+        const uint32_t frameTag = ReadLE24(payload);
+
+        // The image data of a WebP file is always a single key frame.
+        if ((frameTag & 1) != 0)
+        {
+            return false;
+        }
+
+        const size_t partitionSize = frameTag >> 5;
+
+        if (partitionSize > chunk.payloadSize - VP8FrameHeaderSize)
+        {
+            return false;
+        }
+
+        BoolDecoder decoder(payload + VP8FrameHeaderSize, partitionSize);
+
+        // The color space and clamping type.
+        decoder.ReadLiteral(2);
+
+        bool segmentationEnabled = decoder.ReadLiteral(1) != 0;
+        bool absoluteDeltas = false;
+        int segmentQuantizers[MaxSegments] = {};
+        // The segment tree probabilities default to 255 when they are not present.
+        int segmentProbabilities[3] = { 255, 255, 255 };
+
+        if (segmentationEnabled)
+        {
+            const bool updateMap = decoder.ReadLiteral(1) != 0;
+            const bool updateData = decoder.ReadLiteral(1) != 0;
+
+            if (updateData)
+            {
+                absoluteDeltas = decoder.ReadLiteral(1) != 0;
+
+                for (int i = 0; i < MaxSegments; i++)
+                {
+                    segmentQuantizers[i] = decoder.ReadOptionalSigned(7);
+                }
+
+                // The loop filter strength of each segment.
+                for (int i = 0; i < MaxSegments; i++)
+                {
+                    decoder.ReadOptionalSigned(6);
+                }
+            }
+
+            if (updateMap)
+            {
+                for (int i = 0; i < 3; i++)
+                {
+                    if (decoder.ReadLiteral(1))
+                    {
+                        segmentProbabilities[i] = decoder.ReadLiteral(8);
+                    }
+                }
+            }
+        }
+
+        // The filter type, loop filter level and sharpness.
+        decoder.ReadLiteral(10);
+
+        if (decoder.ReadLiteral(1))
+        {
+            if (decoder.ReadLiteral(1))
+            {
+                // The reference frame and prediction mode loop filter deltas.
+                for (int i = 0; i < 8; i++)
+                {
+                    decoder.ReadOptionalSigned(6);
+                }
+            }
+        }
+
+        // The number of DCT coefficient partitions.
+        decoder.ReadLiteral(2);
+
+        const int baseQuantizer = decoder.ReadLiteral(7);
+
+        if (decoder.HasOverrun())
+        {
+            return false;
+        }
+
+        if (segmentationEnabled)
+        {
+            frame.segmentCount = MaxSegments;
+
+            // The libwebp encoder sets the segment tree probabilities from the number of macroblocks in each
+            // segment, so they approximate the segment sizes without decoding the segment map.
+            const double first = segmentProbabilities[0] / 255.0;
+            const double left = segmentProbabilities[1] / 255.0;
+            const double right = segmentProbabilities[2] / 255.0;
+
+            frame.weights[0] = first * left;
+            frame.weights[1] = first * (1.0 - left);
+            frame.weights[2] = (1.0 - first) * right;
+            frame.weights[3] = (1.0 - first) * (1.0 - right);
+
+            for (int i = 0; i < MaxSegments; i++)
+            {
+                int quantizer = absoluteDeltas ? segmentQuantizers[i] : baseQuantizer + segmentQuantizers[i];
+
+                frame.quantizers[i] = quantizer < 0 ? 0 : quantizer > MaxQuantizerIndex ? MaxQuantizerIndex : quantizer;
+            }
+        }
+        else
+        {
+            frame.segmentCount = 1;
+            frame.quantizers[0] = baseQuantizer;
+            frame.weights[0] = 1.0;
+        }
+
+        return true;
+    }
+
+    // Inverts the quality to quantizer mapping of the libwebp encoder.
+    //
+    // The encoder converts the quality to a compression factor c = QualityToCompression(quality) and
+    // the quantizer index of each segment is 127 * (1 - c^e), where the exponent e is spread around 1
+    // by the spatial noise shaping. The exponents are chosen so that their average over the macroblocks is 1,
+    // so the weighted average of the logarithms of the segment compression factors recovers c.
+    float EstimateFrameQuality(const FrameQuantizers& frame)
+    {
+        double logSum = 0.0;
+        double weightSum = 0.0;
+
+        for (int i = 0; i < frame.segmentCount; i++)
+        {
+            // The encoder truncates the quantizer, use the center of the interval.
+            double compression = 1.0 - ((frame.quantizers[i] + 0.5) / MaxQuantizerIndex);
+
+            if (compression < MinCompression)
+            {
+                compression = MinCompression;
+            }
+
+            logSum += frame.weights[i] * log(compression);
+            weightSum += frame.weights[i];
+        }
+
+        if (weightSum <= 0.0)
+        {
+            return 0.0f;
+        }
+
+        const double compression = exp(logSum / weightSum);
+        const double linearCompression = compression * compression * compression;
+        const double quality = linearCompression < 0.5 ? linearCompression * 1.5 : (linearCompression + 1.0) * 0.5;
+
+        return static_cast<float>(quality < 0.0 ? 0.0 : quality > 1.0 ? 100.0 : quality * 100.0);
+    }
+
+    struct EstimateState
+    {
+        int lossyFrames;
+        int losslessFrames;
+        double qualitySum;
+    };
+
+    VP8StatusCode AddImageChunk(const RiffChunk& chunk, EstimateState& state)
+    {
+        if (chunk.fourcc == VP8LFourCC)
+        {
+            state.losslessFrames++;
+        }
+        else if (chunk.fourcc == VP8FourCC)
+        {
+            FrameQuantizers frame;
+
+            if (!ReadFrameQuantizers(chunk, frame))
+            {
+                return VP8_STATUS_BITSTREAM_ERROR;
+            }
+
+            state.lossyFrames++;
+            state.qualitySum += EstimateFrameQuality(frame);
+        }
+
+        return VP8_STATUS_OK;
+    }
+}
+
+int __stdcall WebPEstimateQuality(const uint8_t* data, size_t dataSize, QualityEstimate* estimate)
+{
+    if (data == nullptr || estimate == nullptr)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    RiffChunkReader reader(data, dataSize);
+
+    if (!reader.IsValid())
+    {
+        return VP8_STATUS_BITSTREAM_ERROR;
+    }
+
+    EstimateState state = {};
+    RiffChunk chunk;
+
+    while (reader.Next(chunk))
+    {
+        VP8StatusCode status = VP8_STATUS_OK;
+
+        if (chunk.fourcc == AnmfFourCC)
+        {
+            if (chunk.payloadSize < AnmfHeaderSize)
+            {
+                return VP8_STATUS_BITSTREAM_ERROR;
+            }
+
+            RiffChunkReader frameReader = RiffChunkReader::ForChunkSequence(chunk.payload + AnmfHeaderSize, chunk.payloadSize - AnmfHeaderSize);
+            RiffChunk frameChunk;
+
+            while (status == VP8_STATUS_OK && frameReader.Next(frameChunk))
+            {
+                status = AddImageChunk(frameChunk, state);
+            }
+        }
+        else
+        {
+            status = AddImageChunk(chunk, state);
+        }
+
+        if (status != VP8_STATUS_OK)
+        {
+            return status;
+        }
+    }
+
+    if (state.lossyFrames == 0 && state.losslessFrames == 0)
+    {
+        return reader.HasError() ? VP8_STATUS_NOT_ENOUGH_DATA : VP8_STATUS_BITSTREAM_ERROR;
+    }
+
+    // An animation can mix lossy and lossless frames, it is only reported as lossless when every frame is lossless.
+    estimate->lossless = state.lossyFrames == 0;
+    estimate->quality = estimate->lossless ? 100.0f : static_cast<float>(state.qualitySum / state.lossyFrames);
+
+    return VP8_STATUS_OK;
+}
@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+    return static_cast<uint32_t>(static_cast<uint8_t>(a)) |
+          (static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8) |
+          (static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16) |
+          (static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24);
+}
+
+constexpr uint32_t RiffFourCC = MakeFourCC('R', 'I', 'F', 'F');
+constexpr uint32_t WebPFourCC = MakeFourCC('W', 'E', 'B', 'P');
+constexpr uint32_t VP8XFourCC = MakeFourCC('V', 'P', '8', 'X');
+constexpr uint32_t VP8FourCC = MakeFourCC('V', 'P', '8', ' ');
+constexpr uint32_t VP8LFourCC = MakeFourCC('V', 'P', '8', 'L');
+constexpr uint32_t AlphFourCC = MakeFourCC('A', 'L', 'P', 'H');
+constexpr uint32_t AnimFourCC = MakeFourCC('A', 'N', 'I', 'M');
+constexpr uint32_t AnmfFourCC = MakeFourCC('A', 'N', 'M', 'F');
+constexpr uint32_t IccpFourCC = MakeFourCC('I', 'C', 'C', 'P');
+constexpr uint32_t ExifFourCC = MakeFourCC('E', 'X', 'I', 'F');
+constexpr uint32_t XmpFourCC = MakeFourCC('X', 'M', 'P', ' ');
+// An unknown chunk that readers skip, used to blank out chunks in place.
+constexpr uint32_t JunkFourCC = MakeFourCC('J', 'U', 'N', 'K');
+
+constexpr size_t RiffHeaderSize = 12;
+constexpr size_t ChunkHeaderSize = 8;
+constexpr size_t VP8XChunkSize = 10;
+constexpr size_t AnmfHeaderSize = 16;
+
+inline uint32_t ReadLE16(const uint8_t* data)
+{
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8);
+}
+
+inline uint32_t ReadLE24(const uint8_t* data)
+{
+    return ReadLE16(data) | (static_cast<uint32_t>(data[2]) << 16);
+}
+
+inline uint32_t ReadLE32(const uint8_t* data)
+{
+    return ReadLE24(data) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+struct RiffChunk
+{
+    uint32_t fourcc;
+    // The chunk payload, excluding the chunk header and padding byte.
+    const uint8_t* payload;
+    uint32_t payloadSize;
+    // The offset of the chunk header from the start of the data that is being read.
+    size_t offset;
+};
+
+// Walks the chunks of a WebP RIFF container in place, without allocating memory.
+class RiffChunkReader
+{
+public:
+    // Reads the chunks that follow the 12 byte RIFF header of a WebP file.
+    RiffChunkReader(const uint8_t* data, size_t dataSize)
+        : data(data), end(0), position(0), valid(false), error(false)
+    {
+        if (data != nullptr &&
+            dataSize >= RiffHeaderSize &&
+            ReadLE32(data) == RiffFourCC &&
+            ReadLE32(data + 8) == WebPFourCC)
+        {
+            const uint64_t riffEnd = static_cast<uint64_t>(ReadLE32(data + 4)) + ChunkHeaderSize;
+
+            // A file that is longer than the RIFF size has trailing data that is ignored.
+            end = riffEnd < dataSize ? static_cast<size_t>(riffEnd) : dataSize;
+            position = RiffHeaderSize;
+            valid = true;
+        }
+    }
+
+    // Reads a sequence of chunks that are nested inside a chunk payload, e.g. the frame data of an ANMF chunk.
+    static RiffChunkReader ForChunkSequence(const uint8_t* data, size_t dataSize)
+    {
+        RiffChunkReader reader(nullptr, 0);
+
+        if (data != nullptr)
+        {
+            reader.data = data;
+            reader.end = dataSize;
+            reader.valid = true;
+        }
+
+        return reader;
+    }
+
+    // Returns true if the data starts with a RIFF header that has the WEBP form type.
+    bool IsValid() const
+    {
+        return valid;
+    }
+
+    // Returns true if a chunk header or payload extends past the end of the data.
+    bool HasError() const
+    {
+        return error;
+    }
+
+    // Returns true if the RIFF size covers more data than was supplied.
+    bool IsTruncated(size_t dataSize) const
+    {
+        return valid && data != nullptr && dataSize >= RiffHeaderSize && static_cast<uint64_t>(ReadLE32(data + 4)) + ChunkHeaderSize > dataSize;
+    }
+
+    bool Next(RiffChunk& chunk)
+    {
+        if (!valid || error || position >= end)
+        {
+            return false;
+        }
+
+        if (end - position < ChunkHeaderSize)
+        {
+            error = true;
+            return false;
+        }
+
+        const uint8_t* header = data + position;
+        const uint32_t payloadSize = ReadLE32(header + 4);
+        const uint64_t paddedSize = static_cast<uint64_t>(payloadSize) + (payloadSize & 1);
+
+        if (paddedSize > end - position - ChunkHeaderSize)
+        {
+            // Some writers omit the padding byte of the last chunk.
+            if (payloadSize > end - position - ChunkHeaderSize)
+            {
+                error = true;
+                return false;
+            }
+        }
+
+        chunk.fourcc = ReadLE32(header);
+        chunk.payload = header + ChunkHeaderSize;
+        chunk.payloadSize = payloadSize;
+        chunk.offset = position;
+
+        const uint64_t next = static_cast<uint64_t>(position) + ChunkHeaderSize + paddedSize;
+        position = next < end ? static_cast<size_t>(next) : end;
+
+        return true;
+    }
+
+private:
+    const uint8_t* data;
+    size_t end;
+    size_t position;
+    bool valid;
+    bool error;
+};
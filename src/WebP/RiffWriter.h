@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RiffReader.h"
+
+inline void WriteLE16(uint8_t* data, uint32_t value)
+{
+    data[0] = static_cast<uint8_t>(value);
+    data[1] = static_cast<uint8_t>(value >> 8);
+}
+
+inline void WriteLE24(uint8_t* data, uint32_t value)
+{
+    WriteLE16(data, value);
+    data[2] = static_cast<uint8_t>(value >> 16);
+}
+
+inline void WriteLE32(uint8_t* data, uint32_t value)
+{
+    WriteLE24(data, value);
+    data[3] = static_cast<uint8_t>(value >> 24);
+}
+
+// Gets the size of a chunk including the header and padding byte.
+inline size_t GetChunkSize(size_t payloadSize)
+{
+    return ChunkHeaderSize + payloadSize + (payloadSize & 1);
+}
+
+inline void WriteChunkHeader(uint8_t* data, uint32_t fourcc, uint32_t payloadSize)
+{
+    WriteLE32(data, fourcc);
+    WriteLE32(data + 4, payloadSize);
+}
+
+inline void WriteRiffHeader(uint8_t* data, uint32_t riffSize)
+{
+    WriteLE32(data, RiffFourCC);
+    WriteLE32(data + 4, riffSize);
+    WriteLE32(data + 8, WebPFourCC);
+}
+
+// Writes a VP8X chunk, the canvas dimensions must be between 1 and 16777216.
+inline void WriteVP8XChunk(uint8_t* data, uint32_t flags, int canvasWidth, int canvasHeight)
+{
+    WriteChunkHeader(data, VP8XFourCC, VP8XChunkSize);
+    WriteLE32(data + ChunkHeaderSize, flags);
+    WriteLE24(data + ChunkHeaderSize + 4, static_cast<uint32_t>(canvasWidth - 1));
+    WriteLE24(data + ChunkHeaderSize + 7, static_cast<uint32_t>(canvasHeight - 1));
+}
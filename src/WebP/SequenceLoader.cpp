@@ -0,0 +1,413 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <string.h>
+#include <memory>
+#include "SequenceLoader.h"
+
+namespace
+{
+    class ScopedFileHandle
+    {
+    public:
+        explicit ScopedFileHandle(HANDLE handle) : handle(handle)
+        {
+        }
+
+        ~ScopedFileHandle()
+        {
+            if (handle != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(handle);
+                handle = INVALID_HANDLE_VALUE;
+            }
+        }
+
+        HANDLE Get() const
+        {
+            return handle;
+        }
+
+    private:
+        ScopedFileHandle(const ScopedFileHandle&) = delete;
+        ScopedFileHandle& operator=(const ScopedFileHandle&) = delete;
+
+        HANDLE handle;
+    };
+
+    int ReadFileData(const std::wstring& path, std::vector<uint8_t>& data)
+    {
+        ScopedFileHandle file(CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+        if (file.Get() == INVALID_HANDLE_VALUE)
+        {
+            return errFileOpenFailed;
+        }
+
+        LARGE_INTEGER fileSize;
+
+        // WebP files are limited to 4 GB by the 32-bit RIFF size.
+        if (!GetFileSizeEx(file.Get(), &fileSize) || fileSize.QuadPart > UINT32_MAX)
+        {
+            return VP8_STATUS_BITSTREAM_ERROR;
+        }
+
+        try
+        {
+            data.resize(static_cast<size_t>(fileSize.QuadPart));
+        }
+        catch (const std::bad_alloc&)
+        {
+            return VP8_STATUS_OUT_OF_MEMORY;
+        }
+
+        DWORD bytesRead = 0;
+
+        if (!data.empty() && (!ReadFile(file.Get(), data.data(), static_cast<DWORD>(data.size()), &bytesRead, nullptr) || bytesRead != data.size()))
+        {
+            return VP8_STATUS_NOT_ENOUGH_DATA;
+        }
+
+        return VP8_STATUS_OK;
+    }
+}
+
+SequenceLoader::SequenceLoader(int prefetchCount, uint64_t memoryBudget)
+    : entries(),
+      current(0),
+      prefetchCount(prefetchCount),
+      memoryBudget(memoryBudget),
+      memoryInUse(0),
+      cancelled(false),
+      mutex(),
+      entryLoaded(),
+      prefetchJobs(JobPriorityNormal)
+{
+}
+
+SequenceLoader::~SequenceLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+    }
+
+    // The queued jobs return without loading their image.
+    prefetchJobs.Wait();
+}
+
+int SequenceLoader::Start(const wchar_t* const* paths, int pathCount)
+{
+    try
+    {
+        entries.resize(static_cast<size_t>(pathCount));
+
+        for (int i = 0; i < pathCount; i++)
+        {
+            if (paths[i] == nullptr)
+            {
+                return VP8_STATUS_INVALID_PARAM;
+            }
+
+            entries[i].path = paths[i];
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        return VP8_STATUS_OUT_OF_MEMORY;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    SchedulePrefetch();
+
+    return VP8_STATUS_OK;
+}
+
+int SequenceLoader::Next(ImageInfo* info, uint8_t* outData, size_t outSize, int outStride)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (current >= entries.size())
+    {
+        return errEndOfSequence;
+    }
+
+    Entry& entry = entries[current];
+
+    while (entry.state != EntryState::Loaded)
+    {
+        // An image that has not been started is loaded on the calling thread instead of waiting for a worker,
+        // the job that was queued for it finds that the image has been claimed and returns.
+        if (entry.state == EntryState::Idle || entry.state == EntryState::Queued)
+        {
+            entry.state = EntryState::Reading;
+
+            lock.unlock();
+            ReadEntry(current);
+            lock.lock();
+        }
+        else if (entry.state == EntryState::Sized || entry.state == EntryState::Reserved)
+        {
+            // The image that the consumer is waiting for is always loaded, even if it does not fit in the budget.
+            if (entry.state == EntryState::Sized)
+            {
+                memoryInUse += entry.decodedSize;
+            }
+
+            entry.state = EntryState::Decoding;
+
+            lock.unlock();
+            DecodeEntry(current);
+            lock.lock();
+        }
+        else
+        {
+            entryLoaded.wait(lock);
+        }
+    }
+
+    if (info != nullptr)
+    {
+        *info = entry.info;
+    }
+
+    int status = entry.status;
+
+    if (status == VP8_STATUS_OK)
+    {
+        const int width = entry.info.width;
+        const int height = entry.info.height;
+        const size_t rowSize = static_cast<size_t>(width) * 4;
+
+        // The image is kept so the caller can allocate a larger buffer and call the function again.
+        if (outData == nullptr ||
+            outStride < 0 ||
+            static_cast<uint64_t>(outStride) < rowSize ||
+            outSize < (static_cast<uint64_t>(outStride) * (height - 1)) + rowSize)
+        {
+            return errBufferTooSmall;
+        }
+
+        for (int y = 0; y < height; y++)
+        {
+            memcpy(outData + (static_cast<size_t>(y) * outStride), entry.pixels.get() + (rowSize * y), rowSize);
+        }
+    }
+
+    // An image that could not be loaded is skipped, so the caller can continue with the next image.
+    entry.pixels.reset();
+    memoryInUse -= entry.decodedSize;
+    current++;
+
+    ReserveInOrder();
+    SchedulePrefetch();
+
+    return status;
+}
+
+void SequenceLoader::SchedulePrefetch()
+{
+    const size_t end = current + static_cast<size_t>(prefetchCount) < entries.size() ? current + prefetchCount : entries.size();
+
+    for (size_t i = current; i < end && !cancelled; i++)
+    {
+        Entry& entry = entries[i];
+
+        if (entry.state != EntryState::Idle)
+        {
+            continue;
+        }
+
+        // The files are not read ahead while the budget is used up, the data would only wait for the memory.
+        if (memoryInUse >= memoryBudget)
+        {
+            break;
+        }
+
+        entry.state = EntryState::Queued;
+
+        prefetchJobs.Run([this, i]()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (cancelled || entries[i].state != EntryState::Queued)
+                {
+                    return;
+                }
+
+                entries[i].state = EntryState::Reading;
+            }
+
+            ReadEntry(i);
+        });
+    }
+}
+
+void SequenceLoader::ReserveInOrder()
+{
+    const size_t end = current + static_cast<size_t>(prefetchCount) < entries.size() ? current + prefetchCount : entries.size();
+
+    for (size_t i = current; i < end && !cancelled; i++)
+    {
+        Entry& entry = entries[i];
+
+        if (entry.state == EntryState::Reserved || entry.state == EntryState::Decoding || entry.state == EntryState::Loaded)
+        {
+            continue;
+        }
+
+        // An image can only reserve memory after every earlier image, one whose size is not known yet
+        // or that does not fit stops the reservations until it has been reserved.
+        if (entry.state != EntryState::Sized || (i != current && memoryInUse + entry.decodedSize > memoryBudget))
+        {
+            break;
+        }
+
+        memoryInUse += entry.decodedSize;
+        entry.state = EntryState::Reserved;
+
+        prefetchJobs.Run([this, i]()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (cancelled || entries[i].state != EntryState::Reserved)
+                {
+                    return;
+                }
+
+                entries[i].state = EntryState::Decoding;
+            }
+
+            DecodeEntry(i);
+        });
+    }
+}
+
+void SequenceLoader::ReadEntry(size_t index)
+{
+    Entry& entry = entries[index];
+
+    std::vector<uint8_t> data;
+    ImageInfo info;
+
+    int status = ReadFileData(entry.path, data);
+
+    if (status == VP8_STATUS_OK)
+    {
+        status = WebPGetImageInfo(data.data(), data.size(), &info);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (status == VP8_STATUS_OK)
+    {
+        entry.info = info;
+        entry.data = std::move(data);
+        entry.decodedSize = static_cast<size_t>(info.width) * info.height * 4;
+        entry.state = EntryState::Sized;
+
+        ReserveInOrder();
+    }
+    else
+    {
+        entry.status = status;
+        entry.state = EntryState::Loaded;
+    }
+
+    entryLoaded.notify_all();
+}
+
+void SequenceLoader::DecodeEntry(size_t index)
+{
+    Entry& entry = entries[index];
+
+    // The memory for the image has been reserved before the entry entered the Decoding state.
+    const size_t decodedSize = entry.decodedSize;
+    ScopedImageMemory pixels(static_cast<uint8_t*>(AllocateImageMemory(decodedSize)));
+    int status;
+
+    if (pixels == nullptr)
+    {
+        status = VP8_STATUS_OUT_OF_MEMORY;
+    }
+    else
+    {
+        status = WebPLoad(entry.data.data(), entry.data.size(), pixels.get(), decodedSize, entry.info.width * 4);
+    }
+
+    std::vector<uint8_t> data;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (status != VP8_STATUS_OK)
+    {
+        pixels.reset();
+        memoryInUse -= decodedSize;
+        entry.decodedSize = 0;
+    }
+
+    // The file data is released after the mutex, by the destructor of the local vector.
+    data.swap(entry.data);
+
+    entry.pixels = std::move(pixels);
+    entry.status = status;
+    entry.state = EntryState::Loaded;
+    entryLoaded.notify_all();
+}
+
+int __stdcall WebPSequenceLoaderCreate(
+    const wchar_t* const* paths,
+    int pathCount,
+    int prefetchCount,
+    uint64_t memoryBudget,
+    SequenceLoader** loader)
+{
+    if (paths == nullptr || pathCount < 0 || prefetchCount < 0 || loader == nullptr)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    *loader = nullptr;
+
+    std::unique_ptr<SequenceLoader> sequenceLoader(new (std::nothrow) SequenceLoader(prefetchCount, memoryBudget));
+    if (sequenceLoader == nullptr)
+    {
+        return VP8_STATUS_OUT_OF_MEMORY;
+    }
+
+    const int status = sequenceLoader->Start(paths, pathCount);
+
+    if (status == VP8_STATUS_OK)
+    {
+        *loader = sequenceLoader.release();
+    }
+
+    return status;
+}
+
+int __stdcall WebPSequenceLoaderNext(SequenceLoader* loader, ImageInfo* info, uint8_t* outData, size_t outSize, int outStride)
+{
+    if (loader == nullptr)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    return loader->Next(info, outData, outSize, outStride);
+}
+
+void __stdcall WebPSequenceLoaderDelete(SequenceLoader* loader)
+{
+    delete loader;
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "WebP.h"
+#include "ImageMemory.h"
+#include "WorkerPool.h"
+
+// Reads and decodes an ordered list of files ahead of the consumer.
+//
+// The next images are loaded by worker pool jobs while the decoded images that have not been consumed
+// fit in the memory budget. The files are read ahead first, and the memory for the decoded images is reserved
+// in sequence order once their sizes are known, so a later image never takes the budget of an earlier one.
+// When the consumer reaches an image that has not been started it is loaded on the calling thread,
+// so a slow prefetch never delays the consumer more than a regular load.
+struct SequenceLoader
+{
+public:
+    SequenceLoader(int prefetchCount, uint64_t memoryBudget);
+
+    // Cancels the queued loads and waits for the running loads to finish.
+    ~SequenceLoader();
+
+    // Disable copying and assignment.
+    SequenceLoader(const SequenceLoader&) = delete;
+    const SequenceLoader& operator=(const SequenceLoader&) = delete;
+
+    // Copies the paths and starts loading the first images.
+    int Start(const wchar_t* const* paths, int pathCount);
+
+    // Waits for the next image and copies it into the output buffer, see WebPSequenceLoaderNext.
+    int Next(ImageInfo* info, uint8_t* outData, size_t outSize, int outStride);
+
+private:
+    enum class EntryState
+    {
+        Idle,
+        Queued,
+        Reading,
+        // The file has been read and its decoded size is known, the image is waiting for its memory reservation.
+        Sized,
+        // The memory has been reserved and a decode job has been queued.
+        Reserved,
+        Decoding,
+        Loaded
+    };
+
+    struct Entry
+    {
+        Entry() : state(EntryState::Idle), status(VP8_STATUS_OK), info(), data(), decodedSize(0)
+        {
+        }
+
+        std::wstring path;
+        EntryState state;
+        int status;
+        ImageInfo info;
+        // The file data, kept from the time the file has been read until the image has been decoded.
+        std::vector<uint8_t> data;
+        ScopedImageMemory pixels;
+        // The size of the decoded image, zero until the image header has been read.
+        size_t decodedSize;
+    };
+
+    // The caller must hold the mutex.
+    void SchedulePrefetch();
+    void ReserveInOrder();
+
+    // Called without the mutex, by the thread that moved the entry to the Reading or Decoding state.
+    void ReadEntry(size_t index);
+    void DecodeEntry(size_t index);
+
+    std::vector<Entry> entries;
+    size_t current;
+    int prefetchCount;
+    uint64_t memoryBudget;
+    uint64_t memoryInUse;
+    bool cancelled;
+    std::mutex mutex;
+    std::condition_variable entryLoaded;
+    TaskGroup prefetchJobs;
+};
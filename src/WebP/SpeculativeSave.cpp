@@ -0,0 +1,248 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <chrono>
+#include "SpeculativeSave.h"
+#include "Checksum.h"
+#include "EncoderConfig.h"
+#include "PoolWorkerInterface.h"
+#include "WorkerPool.h"
+
+namespace
+{
+    bool EncodeParamsEqual(const EncodeParams& a, const EncodeParams& b)
+    {
+        return a.quality == b.quality &&
+               a.preset == b.preset &&
+               a.lossless == b.lossless &&
+               a.crunch == b.crunch &&
+               a.crunchTimeLimit == b.crunchTimeLimit &&
+               a.alphaCompression == b.alphaCompression &&
+               a.alphaFiltering == b.alphaFiltering &&
+               a.alphaQuality == b.alphaQuality &&
+               a.method == b.method;
+    }
+
+    uint64_t GetImageChecksum(const void* bitmap, int width, int height, int stride)
+    {
+        StreamChecksum checksum(ChecksumXxHash64);
+        const uint8_t* scan0 = static_cast<const uint8_t*>(bitmap);
+        const size_t rowSize = static_cast<size_t>(width) * 4;
+
+        for (int y = 0; y < height; y++)
+        {
+            checksum.Update(scan0 + (static_cast<int64_t>(y) * stride), rowSize);
+        }
+
+        return checksum.GetValue();
+    }
+}
+
+SpeculativeSave::SpeculativeSave()
+    : params(), width(0), height(0), imageChecksum(0), argb(), output(), thread(),
+      cancelled(false), raisePriority(false), progress(0), mutex(), encodeFinished(), finished(false), error(VP8_ENC_OK)
+{
+}
+
+SpeculativeSave::~SpeculativeSave()
+{
+    Cancel();
+}
+
+int SpeculativeSave::Start(const void* bitmap, int width, int height, int stride, const EncodeParams& encodeOptions)
+{
+    if (output == nullptr)
+    {
+        return VP8_ENC_ERROR_OUT_OF_MEMORY;
+    }
+
+    const size_t rowSize = static_cast<size_t>(width) * 4;
+
+    argb.reset(static_cast<uint8_t*>(AllocateImageMemory(rowSize * height)));
+    if (argb == nullptr)
+    {
+        return VP8_ENC_ERROR_OUT_OF_MEMORY;
+    }
+
+    // The caller may reuse the bitmap while the image is encoded, so the encoder works on a packed copy.
+    // The BGRA and ARGB byte order is the same on little-endian processors, and an opaque image already has
+    // an alpha of 255 in every pixel, so the copy can be used as the picture ARGB buffer of a lossless image
+    // without conversion. A lossy image is imported from the copy as a BGRA bitmap.
+    const uint8_t* scan0 = static_cast<const uint8_t*>(bitmap);
+    StreamChecksum checksum(ChecksumXxHash64);
+
+    for (int y = 0; y < height; y++)
+    {
+        uint8_t* dst = argb.get() + (rowSize * y);
+
+        memcpy(dst, scan0 + (static_cast<int64_t>(y) * stride), rowSize);
+        checksum.Update(dst, rowSize);
+    }
+
+    this->params = encodeOptions;
+    this->width = width;
+    this->height = height;
+    imageChecksum = checksum.GetValue();
+
+    thread = std::thread(&SpeculativeSave::EncodeThread, this);
+
+    return VP8_ENC_OK;
+}
+
+bool SpeculativeSave::Matches(const void* bitmap, int width, int height, int stride, const EncodeParams& encodeOptions) const
+{
+    return argb != nullptr &&
+           this->width == width &&
+           this->height == height &&
+           EncodeParamsEqual(params, encodeOptions) &&
+           GetImageChecksum(bitmap, width, height, stride) == imageChecksum;
+}
+
+int SpeculativeSave::Wait(ProgressFn progressCallback)
+{
+    raisePriority.store(true);
+
+    int reportedProgress = -1;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!finished)
+    {
+        encodeFinished.wait_for(lock, std::chrono::milliseconds(50));
+
+        const int currentProgress = progress.load();
+
+        if (!finished && progressCallback != nullptr && currentProgress != reportedProgress)
+        {
+            reportedProgress = currentProgress;
+
+            lock.unlock();
+            const bool continueProcessing = progressCallback(currentProgress);
+            lock.lock();
+
+            if (!continueProcessing)
+            {
+                lock.unlock();
+                Cancel();
+                return VP8_ENC_ERROR_USER_ABORT;
+            }
+        }
+    }
+
+    lock.unlock();
+
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+
+    return error;
+}
+
+void SpeculativeSave::Cancel()
+{
+    cancelled.store(true);
+
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+int SpeculativeSave::ProgressReport(int percent, const WebPPicture* picture)
+{
+    SpeculativeSave* save = static_cast<SpeculativeSave*>(picture->user_data);
+
+    save->progress.store(percent);
+
+    // The progress hook runs on the encoder thread, so it is used to raise the priority
+    // once the user has chosen to save with the speculative options.
+    if (save->raisePriority.exchange(false))
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+    }
+
+    return save->cancelled.load() ? 0 : 1;
+}
+
+void SpeculativeSave::EncodeThread()
+{
+    // The encoder should not compete with the user interface while the save options are shown.
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+    // The jobs that the encoder queues on the worker pool run ahead of background jobs
+    // but behind the interactive work.
+    WorkerPool::SetCurrentPriority(JobPriorityNormal);
+
+    WebPConfig config;
+    ScopedWebPPicture pic;
+    int encodeError = VP8_ENC_OK;
+
+    if (pic == nullptr)
+    {
+        encodeError = VP8_ENC_ERROR_OUT_OF_MEMORY;
+    }
+    else if (!InitializeEncoderConfig(params, config) || !pic.IsInitalized())
+    {
+        encodeError = errVersionMismatch;
+    }
+    else
+    {
+        // The same shortcuts as WebPSave are applied, so the output matches a regular save.
+        PixelTraits traits;
+        ScanPixelTraits(argb.get(), width, height, width * 4, traits);
+        ApplyContentShortcuts(traits, config);
+
+        InstallPoolWorkerInterface();
+
+        pic->width = width;
+        pic->height = height;
+        pic->writer = WebPMemoryWrite;
+        pic->custom_ptr = output.Get();
+        pic->user_data = this;
+        pic->progress_hook = ProgressReport;
+
+        bool imported = true;
+
+        if (config.lossless)
+        {
+            pic->use_argb = 1;
+            pic->argb = reinterpret_cast<uint32_t*>(argb.get());
+            pic->argb_stride = width;
+        }
+        else if (traits.hasTransparency)
+        {
+            // The lossy image is converted to YUV by the same import function as WebPSave,
+            // WebPEncode would use a different conversion for an ARGB picture.
+            imported = WebPPictureImportBGRA(pic.Get(), argb.get(), width * 4) != 0;
+        }
+        else
+        {
+            imported = WebPPictureImportBGRX(pic.Get(), argb.get(), width * 4) != 0;
+        }
+
+        if (!imported)
+        {
+            encodeError = VP8_ENC_ERROR_OUT_OF_MEMORY;
+        }
+        else if (!WebPEncode(&config, pic.Get()))
+        {
+            encodeError = static_cast<int>(pic->error_code);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    error = encodeError;
+    finished = true;
+    encodeFinished.notify_all();
+}
@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "WebP.h"
+#include "scoped.h"
+#include "ImageMemory.h"
+
+// Encodes a copy of an image on a background thread while the user is choosing the save options,
+// the result is used by the final save if the image and encoding options have not changed.
+struct SpeculativeSave
+{
+public:
+    SpeculativeSave();
+
+    // Cancels the encoder and waits for the background thread to exit.
+    ~SpeculativeSave();
+
+    // Disable copying and assignment.
+    SpeculativeSave(const SpeculativeSave&) = delete;
+    const SpeculativeSave& operator=(const SpeculativeSave&) = delete;
+
+    // Copies the image and starts encoding it at below normal priority.
+    // Returns VP8_ENC_OK on success, or a WebPEncodingError if the copy could not be allocated.
+    int Start(const void* bitmap, int width, int height, int stride, const EncodeParams& encodeOptions);
+
+    // Returns true if the image and encoding options are identical to the ones that were passed to Start.
+    bool Matches(const void* bitmap, int width, int height, int stride, const EncodeParams& encodeOptions) const;
+
+    // Raises the encoder to normal priority and waits for it to finish, the encoder progress is forwarded
+    // to the callback. The encoder is cancelled if the callback returns false.
+    // Returns VP8_ENC_OK on success, or the WebPEncodingError of the encoder.
+    int Wait(ProgressFn progressCallback);
+
+    void Cancel();
+
+    const uint8_t* GetBuffer() const
+    {
+        return output.GetBuffer();
+    }
+
+    size_t GetBufferSize() const
+    {
+        return output.GetBufferSize();
+    }
+
+private:
+    static int ProgressReport(int percent, const WebPPicture* picture);
+    void EncodeThread();
+
+    EncodeParams params;
+    int width;
+    int height;
+    uint64_t imageChecksum;
+    ScopedImageMemory argb;
+    ScopedWebPMemoryWriter output;
+    std::thread thread;
+    std::atomic<bool> cancelled;
+    std::atomic<bool> raisePriority;
+    std::atomic<int> progress;
+    std::mutex mutex;
+    std::condition_variable encodeFinished;
+    bool finished;
+    int error;
+};
@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <string.h>
+#include "TiledImage.h"
+#include "ImageMemory.h"
+#include "scoped.h"
+
+namespace
+{
+    inline int GetTilesAcross(const TileLayout& layout, int width)
+    {
+        return (width + layout.tileWidth - 1) / layout.tileWidth;
+    }
+
+    inline int GetTileColumnWidth(const TileLayout& layout, int width, int column)
+    {
+        const int remaining = width - (column * layout.tileWidth);
+
+        return remaining < layout.tileWidth ? remaining : layout.tileWidth;
+    }
+
+    inline uint8_t* GetTileRow(const TileLayout& layout, int tilesAcross, int column, int y)
+    {
+        const int tileRow = y / layout.tileHeight;
+        const int rowInTile = y - (tileRow * layout.tileHeight);
+
+        return layout.tiles[(static_cast<int64_t>(tileRow) * tilesAcross) + column] + (static_cast<int64_t>(rowInTile) * layout.tileStride);
+    }
+
+    void CopyPlaneRows(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride, int width, int rows)
+    {
+        for (int y = 0; y < rows; y++)
+        {
+            memcpy(dst, src, static_cast<size_t>(width));
+
+            src += srcStride;
+            dst += dstStride;
+        }
+    }
+}
+
+bool IsValidTileLayout(const TileLayout* layout)
+{
+    return layout != nullptr &&
+           layout->tiles != nullptr &&
+           layout->tileWidth > 0 &&
+           layout->tileHeight > 0 &&
+           layout->gridWidth > 0 &&
+           layout->gridHeight > 0 &&
+           static_cast<int64_t>(layout->tileStride) >= static_cast<int64_t>(layout->tileWidth) * 4;
+}
+
+bool TileLayoutMatchesImage(const TileLayout& layout, int width, int height)
+{
+    return width > 0 &&
+           height > 0 &&
+           layout.gridWidth == GetTilesAcross(layout, width) &&
+           layout.gridHeight == (height + layout.tileHeight - 1) / layout.tileHeight;
+}
+
+bool TiledImageHasTransparency(const TileLayout& layout, int width, int height)
+{
+    const int tilesAcross = GetTilesAcross(layout, width);
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int column = 0; column < tilesAcross; column++)
+        {
+            const uint8_t* ptr = GetTileRow(layout, tilesAcross, column, y);
+            const int columnWidth = GetTileColumnWidth(layout, width, column);
+
+            for (int x = 0; x < columnWidth; x++)
+            {
+                if (ptr[3] < 255)
+                {
+                    return true;
+                }
+
+                ptr += 4;
+            }
+        }
+    }
+
+    return false;
+}
+
+void GatherRows(const TileLayout& layout, int width, int firstRow, int lastRow, bool hasTransparency, uint32_t* argb)
+{
+    const int tilesAcross = GetTilesAcross(layout, width);
+
+    for (int y = firstRow; y < lastRow; y++)
+    {
+        uint32_t* dst = argb + (static_cast<int64_t>(y - firstRow) * width);
+
+        for (int column = 0; column < tilesAcross; column++)
+        {
+            const uint32_t* src = reinterpret_cast<const uint32_t*>(GetTileRow(layout, tilesAcross, column, y));
+            const int columnWidth = GetTileColumnWidth(layout, width, column);
+
+            if (hasTransparency)
+            {
+                memcpy(dst, src, static_cast<size_t>(columnWidth) * sizeof(uint32_t));
+            }
+            else
+            {
+                for (int x = 0; x < columnWidth; x++)
+                {
+                    dst[x] = src[x] | 0xff000000;
+                }
+            }
+
+            dst += columnWidth;
+        }
+    }
+}
+
+bool ImportTiledImage(const TileLayout& layout, int width, int height, bool hasTransparency, WebPPicture* picture)
+{
+    picture->use_argb = 0;
+    picture->colorspace = hasTransparency ? WEBP_YUV420A : WEBP_YUV420;
+    picture->width = width;
+    picture->height = height;
+
+    if (!WebPPictureAlloc(picture))
+    {
+        return false;
+    }
+
+    // The chroma planes are subsampled by two rows, so every band starts on an even row.
+    const int bandHeight = std::min(layout.tileHeight + (layout.tileHeight & 1), height);
+
+    ScopedImageMemory bandMemory(static_cast<uint8_t*>(AllocateImageMemory(static_cast<size_t>(width) * bandHeight * sizeof(uint32_t))));
+    ScopedWebPPicture band;
+
+    if (bandMemory == nullptr || band == nullptr || !band.IsInitalized())
+    {
+        return false;
+    }
+
+    const int uvWidth = (width + 1) >> 1;
+
+    for (int firstRow = 0; firstRow < height; firstRow += bandHeight)
+    {
+        const int lastRow = std::min(firstRow + bandHeight, height);
+        const int rows = lastRow - firstRow;
+
+        // The BGRX import ignores the alpha channel, so it does not need to be set to opaque.
+        GatherRows(layout, width, firstRow, lastRow, true, reinterpret_cast<uint32_t*>(bandMemory.get()));
+
+        WebPPicture* bandPicture = band.Get();
+        bandPicture->width = width;
+        bandPicture->height = rows;
+
+        // Each import converts the band with the same code as a linear import of the whole image.
+        const int imported = hasTransparency ?
+            WebPPictureImportBGRA(bandPicture, bandMemory.get(), width * 4) :
+            WebPPictureImportBGRX(bandPicture, bandMemory.get(), width * 4);
+
+        if (!imported)
+        {
+            return false;
+        }
+
+        const int uvRow = firstRow >> 1;
+        const int uvRows = (rows + 1) >> 1;
+
+        CopyPlaneRows(bandPicture->y, bandPicture->y_stride, picture->y + (static_cast<int64_t>(firstRow) * picture->y_stride), picture->y_stride, width, rows);
+        CopyPlaneRows(bandPicture->u, bandPicture->uv_stride, picture->u + (static_cast<int64_t>(uvRow) * picture->uv_stride), picture->uv_stride, uvWidth, uvRows);
+        CopyPlaneRows(bandPicture->v, bandPicture->uv_stride, picture->v + (static_cast<int64_t>(uvRow) * picture->uv_stride), picture->uv_stride, uvWidth, uvRows);
+
+        if (picture->a != nullptr)
+        {
+            uint8_t* alpha = picture->a + (static_cast<int64_t>(firstRow) * picture->a_stride);
+
+            if (bandPicture->a != nullptr)
+            {
+                CopyPlaneRows(bandPicture->a, bandPicture->a_stride, alpha, picture->a_stride, width, rows);
+            }
+            else
+            {
+                // The import leaves out the alpha plane of a band that is fully opaque.
+                for (int y = 0; y < rows; y++)
+                {
+                    memset(alpha + (static_cast<int64_t>(y) * picture->a_stride), 0xff, static_cast<size_t>(width));
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void ScatterRows(const TileLayout& layout, int width, const uint8_t* scan0, int stride, int firstRow, int lastRow)
+{
+    const int tilesAcross = GetTilesAcross(layout, width);
+
+    for (int y = firstRow; y < lastRow; y++)
+    {
+        const uint8_t* src = scan0 + (static_cast<int64_t>(y) * stride);
+
+        for (int column = 0; column < tilesAcross; column++)
+        {
+            const size_t columnSize = static_cast<size_t>(GetTileColumnWidth(layout, width, column)) * 4;
+
+            memcpy(GetTileRow(layout, tilesAcross, column, y), src, columnSize);
+            src += columnSize;
+        }
+    }
+}
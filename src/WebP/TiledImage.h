@@ -0,0 +1,34 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "WebP.h"
+
+bool IsValidTileLayout(const TileLayout* layout);
+
+// Checks that the tile grid covers an image of the specified size, and has no rows or columns past its edges.
+bool TileLayoutMatchesImage(const TileLayout& layout, int width, int height);
+
+bool TiledImageHasTransparency(const TileLayout& layout, int width, int height);
+
+// Copies the rows in the range [firstRow, lastRow) of the BGRA tiles into a packed ARGB buffer,
+// the alpha channel is set to opaque if hasTransparency is false.
+void GatherRows(const TileLayout& layout, int width, int firstRow, int lastRow, bool hasTransparency, uint32_t* argb);
+
+// Converts the tiles to the YUV planes of a lossy picture one band of rows at a time,
+// so only a band of the image is gathered instead of a full size BGRA copy.
+// Returns false if the memory could not be allocated.
+bool ImportTiledImage(const TileLayout& layout, int width, int height, bool hasTransparency, WebPPicture* picture);
+
+// Copies the BGRA rows in the range [firstRow, lastRow) of a linear image into the tiles.
+void ScatterRows(const TileLayout& layout, int width, const uint8_t* scan0, int stride, int firstRow, int lastRow);
@@ -0,0 +1,497 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#include "WebP.h"
+#include "RiffReader.h"
+
+namespace
+{
+    const size_t AnimChunkSize = 6;
+    const size_t VP8FrameHeaderSize = 10;
+    const size_t VP8LHeaderSize = 5;
+    const uint8_t VP8LSignature = 0x2f;
+    // The RIFF size covers the form type and at least one chunk header.
+    const uint32_t MinRiffSize = 4 + ChunkHeaderSize;
+
+    struct ImageDimensions
+    {
+        int width;
+        int height;
+    };
+
+    class WebPValidator
+    {
+    public:
+        WebPValidator(const uint8_t* data, size_t dataSize) : data(data), dataSize(dataSize), riffEnd(0), errorOffset(0)
+        {
+        }
+
+        WebPValidationStatus Validate();
+
+        size_t GetErrorOffset() const
+        {
+            return errorOffset;
+        }
+
+    private:
+        WebPValidationStatus Fail(WebPValidationStatus status, size_t offset)
+        {
+            errorOffset = offset;
+            return status;
+        }
+
+        WebPValidationStatus Fail(WebPValidationStatus status, const RiffChunk& chunk)
+        {
+            return Fail(status, static_cast<size_t>(chunk.payload - data) - ChunkHeaderSize);
+        }
+
+        WebPValidationStatus GetReaderError(const RiffChunkReader& reader, size_t offset);
+        WebPValidationStatus ValidateSimpleFile(RiffChunkReader& reader, const RiffChunk& first);
+        WebPValidationStatus ValidateExtendedFile(RiffChunkReader& reader, const RiffChunk& vp8x);
+        WebPValidationStatus ValidateFrameData(RiffChunkReader& reader, bool allowTrailingChunks, size_t containerOffset, ImageDimensions& dimensions);
+        WebPValidationStatus ValidateVP8(const RiffChunk& chunk, ImageDimensions& dimensions);
+        WebPValidationStatus ValidateVP8L(const RiffChunk& chunk, ImageDimensions& dimensions);
+
+        const uint8_t* data;
+        size_t dataSize;
+        size_t riffEnd;
+        size_t errorOffset;
+    };
+
+    WebPValidationStatus WebPValidator::Validate()
+    {
+        RiffChunkReader reader(data, dataSize);
+
+        if (!reader.IsValid())
+        {
+            return Fail(WebPValidationNotWebP, 0);
+        }
+
+        const uint32_t riffSize = ReadLE32(data + 4);
+
+        if (riffSize < MinRiffSize)
+        {
+            return Fail(WebPValidationBadRiffSize, 4);
+        }
+
+        if (reader.IsTruncated(dataSize))
+        {
+            return Fail(WebPValidationTruncated, dataSize);
+        }
+
+        riffEnd = static_cast<size_t>(riffSize) + ChunkHeaderSize;
+
+        RiffChunk first;
+        if (!reader.Next(first))
+        {
+            return GetReaderError(reader, RiffHeaderSize);
+        }
+
+        if (first.fourcc == VP8XFourCC)
+        {
+            return ValidateExtendedFile(reader, first);
+        }
+
+        return ValidateSimpleFile(reader, first);
+    }
+
+    WebPValidationStatus WebPValidator::GetReaderError(const RiffChunkReader& reader, size_t offset)
+    {
+        if (reader.HasError())
+        {
+            return Fail(WebPValidationBadChunkSize, offset);
+        }
+
+        return Fail(WebPValidationMissingImage, offset);
+    }
+
+    WebPValidationStatus WebPValidator::ValidateSimpleFile(RiffChunkReader& reader, const RiffChunk& first)
+    {
+        ImageDimensions dimensions;
+        WebPValidationStatus status;
+
+        if (first.fourcc == VP8FourCC)
+        {
+            status = ValidateVP8(first, dimensions);
+        }
+        else if (first.fourcc == VP8LFourCC)
+        {
+            status = ValidateVP8L(first, dimensions);
+        }
+        else
+        {
+            return Fail(WebPValidationMissingImage, first);
+        }
+
+        if (status != WebPValidationOk)
+        {
+            return status;
+        }
+
+        // The simple format only contains the image data, unknown chunks are ignored by readers.
+        RiffChunk chunk;
+        size_t lastOffset = first.offset;
+
+        while (reader.Next(chunk))
+        {
+            switch (chunk.fourcc)
+            {
+            case VP8XFourCC:
+            case VP8FourCC:
+            case VP8LFourCC:
+            case AlphFourCC:
+            case AnimFourCC:
+            case AnmfFourCC:
+            case IccpFourCC:
+            case ExifFourCC:
+            case XmpFourCC:
+                return Fail(WebPValidationUnexpectedChunk, chunk);
+            }
+
+            lastOffset = chunk.offset;
+        }
+
+        if (reader.HasError())
+        {
+            return Fail(WebPValidationBadChunkSize, lastOffset);
+        }
+
+        return WebPValidationOk;
+    }
+
+    WebPValidationStatus WebPValidator::ValidateExtendedFile(RiffChunkReader& reader, const RiffChunk& vp8x)
+    {
+        if (vp8x.payloadSize < VP8XChunkSize)
+        {
+            return Fail(WebPValidationBadVP8X, vp8x);
+        }
+
+        const uint32_t flags = ReadLE32(vp8x.payload);
+        const uint32_t canvasWidth = ReadLE24(vp8x.payload + 4) + 1;
+        const uint32_t canvasHeight = ReadLE24(vp8x.payload + 7) + 1;
+
+        // The reserved flag bits must be zero, libwebp rejects files that set them.
+        if ((flags & ~ALL_VALID_FLAGS) != 0 || static_cast<uint64_t>(canvasWidth) * canvasHeight > UINT32_MAX)
+        {
+            return Fail(WebPValidationBadVP8X, vp8x);
+        }
+
+        const bool isAnimation = (flags & ANIMATION_FLAG) != 0;
+        bool hasIccp = false;
+        bool hasExif = false;
+        bool hasXmp = false;
+        bool hasAnim = false;
+        bool hasImage = false;
+        int frameCount = 0;
+
+        RiffChunk chunk;
+        size_t lastOffset = vp8x.offset;
+
+        while (reader.Next(chunk))
+        {
+            lastOffset = chunk.offset;
+
+            switch (chunk.fourcc)
+            {
+            case VP8XFourCC:
+                return Fail(WebPValidationUnexpectedChunk, chunk);
+
+            case IccpFourCC:
+                // The color profile must precede the image data.
+                if (hasIccp || hasAnim || hasImage)
+                {
+                    return Fail(WebPValidationUnexpectedChunk, chunk);
+                }
+                hasIccp = true;
+                break;
+
+            case ExifFourCC:
+                hasExif = true;
+                break;
+
+            case XmpFourCC:
+                hasXmp = true;
+                break;
+
+            case AnimFourCC:
+                if (!isAnimation)
+                {
+                    return Fail(WebPValidationFlagMismatch, chunk);
+                }
+
+                if (hasAnim || frameCount > 0 || chunk.payloadSize < AnimChunkSize)
+                {
+                    return Fail(WebPValidationBadAnimation, chunk);
+                }
+                hasAnim = true;
+                break;
+
+            case AnmfFourCC:
+            {
+                if (!isAnimation)
+                {
+                    return Fail(WebPValidationFlagMismatch, chunk);
+                }
+
+                if (!hasAnim || chunk.payloadSize < AnmfHeaderSize)
+                {
+                    return Fail(WebPValidationBadAnimation, chunk);
+                }
+
+                const uint32_t x = ReadLE24(chunk.payload) * 2;
+                const uint32_t y = ReadLE24(chunk.payload + 3) * 2;
+                const uint32_t width = ReadLE24(chunk.payload + 6) + 1;
+                const uint32_t height = ReadLE24(chunk.payload + 9) + 1;
+
+                RiffChunkReader frameReader = RiffChunkReader::ForChunkSequence(chunk.payload + AnmfHeaderSize, chunk.payloadSize - AnmfHeaderSize);
+                ImageDimensions dimensions;
+
+                WebPValidationStatus status = ValidateFrameData(frameReader, true, chunk.offset, dimensions);
+                if (status != WebPValidationOk)
+                {
+                    return status;
+                }
+
+                if (static_cast<uint32_t>(dimensions.width) != width || static_cast<uint32_t>(dimensions.height) != height)
+                {
+                    return Fail(WebPValidationDimensionMismatch, chunk);
+                }
+
+                if (static_cast<uint64_t>(x) + width > canvasWidth || static_cast<uint64_t>(y) + height > canvasHeight)
+                {
+                    return Fail(WebPValidationBadFrameBounds, chunk);
+                }
+
+                frameCount++;
+                break;
+            }
+
+            case AlphFourCC:
+            case VP8FourCC:
+            case VP8LFourCC:
+            {
+                if (isAnimation)
+                {
+                    return Fail(WebPValidationFlagMismatch, chunk);
+                }
+
+                if (hasImage)
+                {
+                    return Fail(WebPValidationUnexpectedChunk, chunk);
+                }
+
+                // Validate the image chunks as a sequence, starting from this chunk.
+                RiffChunkReader imageReader = RiffChunkReader::ForChunkSequence(data + chunk.offset, riffEnd - chunk.offset);
+                ImageDimensions dimensions;
+
+                WebPValidationStatus status = ValidateFrameData(imageReader, false, chunk.offset, dimensions);
+                if (status != WebPValidationOk)
+                {
+                    return status;
+                }
+
+                if (static_cast<uint32_t>(dimensions.width) != canvasWidth || static_cast<uint32_t>(dimensions.height) != canvasHeight)
+                {
+                    return Fail(WebPValidationDimensionMismatch, chunk);
+                }
+
+                // Skip the VP8 chunk that follows an ALPH chunk.
+                if (chunk.fourcc == AlphFourCC && !reader.Next(chunk))
+                {
+                    return GetReaderError(reader, lastOffset);
+                }
+
+                hasImage = true;
+                break;
+            }
+            }
+        }
+
+        if (reader.HasError())
+        {
+            return Fail(WebPValidationBadChunkSize, lastOffset);
+        }
+
+        if (isAnimation ? frameCount == 0 : !hasImage)
+        {
+            return Fail(WebPValidationMissingImage, dataSize);
+        }
+
+        if (hasIccp != ((flags & ICCP_FLAG) != 0) ||
+            hasExif != ((flags & EXIF_FLAG) != 0) ||
+            hasXmp != ((flags & XMP_FLAG) != 0))
+        {
+            return Fail(WebPValidationFlagMismatch, vp8x);
+        }
+
+        return WebPValidationOk;
+    }
+
+    // Validates an image that consists of an optional ALPH chunk followed by a VP8 chunk, or a VP8L chunk.
+    // When allowTrailingChunks is false only the image chunks are read from the sequence.
+    // Structural errors in the sequence are reported at the offset of the containing chunk.
+    WebPValidationStatus WebPValidator::ValidateFrameData(RiffChunkReader& reader, bool allowTrailingChunks, size_t containerOffset, ImageDimensions& dimensions)
+    {
+        RiffChunk chunk;
+        bool hasImage = false;
+        bool hasAlpha = false;
+
+        while (!hasImage && reader.Next(chunk))
+        {
+            switch (chunk.fourcc)
+            {
+            case AlphFourCC:
+                if (hasAlpha || chunk.payloadSize == 0)
+                {
+                    return Fail(WebPValidationUnexpectedChunk, chunk);
+                }
+                hasAlpha = true;
+                break;
+
+            case VP8FourCC:
+            {
+                WebPValidationStatus status = ValidateVP8(chunk, dimensions);
+                if (status != WebPValidationOk)
+                {
+                    return status;
+                }
+                hasImage = true;
+                break;
+            }
+
+            case VP8LFourCC:
+            {
+                // The VP8L bitstream contains its own alpha channel.
+                if (hasAlpha)
+                {
+                    return Fail(WebPValidationUnexpectedChunk, chunk);
+                }
+
+                WebPValidationStatus status = ValidateVP8L(chunk, dimensions);
+                if (status != WebPValidationOk)
+                {
+                    return status;
+                }
+                hasImage = true;
+                break;
+            }
+
+            default:
+                if (!allowTrailingChunks || hasAlpha)
+                {
+                    return Fail(WebPValidationUnexpectedChunk, chunk);
+                }
+                break;
+            }
+        }
+
+        if (!hasImage)
+        {
+            return Fail(reader.HasError() ? WebPValidationBadChunkSize : WebPValidationMissingImage, containerOffset);
+        }
+
+        if (allowTrailingChunks)
+        {
+            // Unknown chunks may follow the frame bitstream.
+            while (reader.Next(chunk))
+            {
+                if (chunk.fourcc == AlphFourCC || chunk.fourcc == VP8FourCC || chunk.fourcc == VP8LFourCC)
+                {
+                    return Fail(WebPValidationUnexpectedChunk, chunk);
+                }
+            }
+
+            if (reader.HasError())
+            {
+                return Fail(WebPValidationBadChunkSize, containerOffset);
+            }
+        }
+
+        return WebPValidationOk;
+    }
+
+    WebPValidationStatus WebPValidator::ValidateVP8(const RiffChunk& chunk, ImageDimensions& dimensions)
+    {
+        if (chunk.payloadSize < VP8FrameHeaderSize)
+        {
+            return Fail(WebPValidationBadVP8Header, chunk);
+        }
+
+        const uint8_t* header = chunk.payload;
+        const uint32_t frameTag = ReadLE24(header);
+
+        const bool isKeyFrame = (frameTag & 1) == 0;
+        const uint32_t profile = (frameTag >> 1) & 7;
+        const bool showFrame = ((frameTag >> 4) & 1) != 0;
+        const uint32_t partitionLength = frameTag >> 5;
+
+        if (!isKeyFrame || profile > 3 || !showFrame || partitionLength >= chunk.payloadSize)
+        {
+            return Fail(WebPValidationBadVP8Header, chunk);
+        }
+
+        if (header[3] != 0x9d || header[4] != 0x01 || header[5] != 0x2a)
+        {
+            return Fail(WebPValidationBadVP8Header, chunk);
+        }
+
+        dimensions.width = static_cast<int>(ReadLE16(header + 6) & 0x3fff);
+        dimensions.height = static_cast<int>(ReadLE16(header + 8) & 0x3fff);
+
+        if (dimensions.width == 0 || dimensions.height == 0)
+        {
+            return Fail(WebPValidationBadVP8Header, chunk);
+        }
+
+        return WebPValidationOk;
+    }
+
+    WebPValidationStatus WebPValidator::ValidateVP8L(const RiffChunk& chunk, ImageDimensions& dimensions)
+    {
+        if (chunk.payloadSize < VP8LHeaderSize || chunk.payload[0] != VP8LSignature)
+        {
+            return Fail(WebPValidationBadVP8LHeader, chunk);
+        }
+
+        const uint32_t bits = ReadLE32(chunk.payload + 1);
+        const uint32_t version = bits >> 29;
+
+        if (version != 0)
+        {
+            return Fail(WebPValidationBadVP8LHeader, chunk);
+        }
+
+        dimensions.width = static_cast<int>((bits & 0x3fff) + 1);
+        dimensions.height = static_cast<int>(((bits >> 14) & 0x3fff) + 1);
+
+        return WebPValidationOk;
+    }
+}
+
+int __stdcall WebPValidate(const uint8_t* data, size_t dataSize, size_t* errorOffset)
+{
+    if (data == nullptr)
+    {
+        return WebPValidationNotWebP;
+    }
+
+    WebPValidator validator(data, dataSize);
+
+    const WebPValidationStatus status = validator.Validate();
+
+    if (errorOffset != nullptr)
+    {
+        *errorOffset = status == WebPValidationOk ? 0 : validator.GetErrorOffset();
+    }
+
+    return status;
+}
@@ -11,8 +11,21 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include <memory>
+#include <string.h>
 #include "WebP.h"
 #include "scoped.h"
+#include "Checksum.h"
+#include "EncoderConfig.h"
+#include "ExifReader.h"
+#include "FileWriter.h"
+#include "FixedBufferWriter.h"
+#include "ImageAnalysis.h"
+#include "ImageMemory.h"
+#include "LosslessCruncher.h"
+#include "PoolWorkerInterface.h"
+#include "SpeculativeSave.h"
+#include "TiledImage.h"
+#include "WorkerPool.h"
 
 int __stdcall WebPGetImageInfo(const uint8_t* data, size_t dataSize, ImageInfo* info)
 {
@@ -31,6 +44,8 @@ int __stdcall WebPGetImageInfo(const uint8_t* data, size_t dataSize, ImageInfo*
 
 int __stdcall WebPLoad(const uint8_t* data, size_t dataSize, uint8_t* outData, size_t outSize, int outStride)
 {
+    InteractiveWorkScope interactiveWork;
+
     WebPDecoderConfig config;
 
     if (!WebPInitDecoderConfig(&config))
@@ -51,42 +66,182 @@ int __stdcall WebPLoad(const uint8_t* data, size_t dataSize, uint8_t* outData, s
     return status;
 }
 
-static bool HasTransparency(const void* data, int width, int height, int stride)
+int __stdcall WebPLoadTiled(const uint8_t* data, size_t dataSize, const TileLayout* output)
+{
+    if (data == nullptr || !IsValidTileLayout(output))
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    WebPDecoderConfig config;
+
+    if (!WebPInitDecoderConfig(&config))
+    {
+        return errVersionMismatch;
+    }
+
+    VP8StatusCode status = WebPGetFeatures(data, dataSize, &config.input);
+    if (status != VP8_STATUS_OK)
+    {
+        return status;
+    }
+
+    const int width = config.input.width;
+    const int height = config.input.height;
+
+    if (!TileLayoutMatchesImage(*output, width, height))
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    const int stride = width * 4;
+    const size_t size = static_cast<size_t>(stride) * height;
+
+    // libwebp can only decode into a linear buffer that holds the whole image, the rows are copied
+    // into the tiles as soon as they have been decoded so that they are still in the cache when they are copied.
+    ScopedImageMemory rows(static_cast<uint8_t*>(AllocateImageMemory(size)));
+    if (rows == nullptr)
+    {
+        return VP8_STATUS_OUT_OF_MEMORY;
+    }
+
+    config.output.colorspace = MODE_BGRA;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = rows.get();
+    config.output.u.RGBA.size = size;
+    config.output.u.RGBA.stride = stride;
+
+    WebPIDecoder* idec = WebPIDecode(nullptr, 0, &config);
+    if (idec == nullptr)
+    {
+        return VP8_STATUS_OUT_OF_MEMORY;
+    }
+
+    // The input is passed to the decoder in blocks, each block produces a band of rows.
+    const size_t blockSize = 64 * 1024;
+    size_t available = 0;
+    int scatteredRows = 0;
+
+    do
+    {
+        available = dataSize - available > blockSize ? available + blockSize : dataSize;
+
+        status = WebPIUpdate(idec, data, available);
+
+        int decodedRows = 0;
+        if ((status == VP8_STATUS_OK || status == VP8_STATUS_SUSPENDED) &&
+            WebPIDecGetRGB(idec, &decodedRows, nullptr, nullptr, nullptr) != nullptr &&
+            decodedRows > scatteredRows)
+        {
+            ScatterRows(*output, width, rows.get(), stride, scatteredRows, decodedRows);
+            scatteredRows = decodedRows;
+        }
+    } while (status == VP8_STATUS_SUSPENDED && available < dataSize);
+
+    if (status == VP8_STATUS_SUSPENDED)
+    {
+        status = VP8_STATUS_NOT_ENOUGH_DATA;
+    }
+
+    WebPIDelete(idec);
+    WebPFreeDecBuffer(&config.output);
+
+    return status;
+}
+
+// Copies the BGRA bitmap into a packed ARGB buffer, on little-endian processors the byte order of the two formats is the same.
+static void CopyToArgb(const void* bitmap, int width, int height, int stride, bool hasTransparency, uint32_t* argb)
 {
-    const uint8_t* scan0 = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* scan0 = reinterpret_cast<const uint8_t*>(bitmap);
 
     for (int y = 0; y < height; y++)
     {
-        const uint8_t* ptr = scan0 + (static_cast<int64_t>(y) * stride);
-        for (int x = 0; x < width; x++)
+        const uint32_t* src = reinterpret_cast<const uint32_t*>(scan0 + (static_cast<int64_t>(y) * stride));
+        uint32_t* dst = argb + (static_cast<int64_t>(y) * width);
+
+        if (hasTransparency)
+        {
+            memcpy(dst, src, static_cast<size_t>(width) * sizeof(uint32_t));
+        }
+        else
         {
-            if (ptr[3] < 255)
+            // Match WebPPictureImportBGRX, which ignores the alpha channel.
+            for (int x = 0; x < width; x++)
             {
-                return true;
+                dst[x] = src[x] | 0xff000000;
             }
-
-            ptr += 4;
         }
     }
-
-    return false;
 }
 
+// The state that is shared with the encoder callbacks through the WebPPicture user_data field.
+struct EncoderContext
+{
+    ProgressFn progressCallback;
+    StreamChecksum* checksum;
+};
+
 static int ProgressReport(int percent, const WebPPicture* picture)
 {
-    ProgressFn callback = reinterpret_cast<ProgressFn>(picture->user_data);
-    bool continueProcessing = callback(percent);
+    const EncoderContext* context = static_cast<const EncoderContext*>(picture->user_data);
+
+    // The progress checkpoints are where a background encode gives way to interactive work.
+    WorkerPool::GetInstance().YieldToInteractiveWork();
+
+    bool continueProcessing = context->progressCallback == nullptr || context->progressCallback(percent);
 
     return continueProcessing ? 1 : 0;
 }
 
+// The destination of the encoded image, either the caller's write callback or a file that is written natively.
+class ImageOutput
+{
+public:
+    ImageOutput() : writeImageCallback(nullptr), file(nullptr)
+    {
+    }
+
+    explicit ImageOutput(WriteImageFn writeImageCallback) : writeImageCallback(writeImageCallback), file(nullptr)
+    {
+    }
+
+    explicit ImageOutput(FileWriter* file) : writeImageCallback(nullptr), file(file)
+    {
+    }
+
+    bool IsValid() const
+    {
+        return writeImageCallback != nullptr || file != nullptr;
+    }
+
+    int Write(const uint8_t* data, size_t dataSize) const
+    {
+        return file != nullptr ? file->Write(data, dataSize) : writeImageCallback(data, dataSize);
+    }
+
+private:
+    WriteImageFn writeImageCallback;
+    FileWriter* file;
+};
+
+static int ChecksumMemoryWrite(const uint8_t* data, size_t dataSize, const WebPPicture* picture)
+{
+    const EncoderContext* context = static_cast<const EncoderContext*>(picture->user_data);
+
+    // The encoder only writes each block once, so the checksum is computed while the block is still in the cache.
+    context->checksum->Update(data, dataSize);
+
+    return WebPMemoryWrite(data, dataSize, picture);
+}
+
 static int EncodeImageMetadata(
     const uint8_t* image,
     const size_t imageSize,
     const MetadataParams* metadata,
-    const WriteImageFn writeImageCallback)
+    const ImageOutput& output,
+    StreamChecksum* checksum)
 {
-    if (image == nullptr || metadata == nullptr || writeImageCallback == nullptr)
+    if (image == nullptr || metadata == nullptr || !output.IsValid())
     {
         return VP8_ENC_ERROR_NULL_PARAMETER;
     }
@@ -141,7 +296,12 @@ static int EncodeImageMetadata(
 
             if (muxError == WEBP_MUX_OK)
             {
-                encodeError = writeImageCallback(assembler.GetBuffer(), assembler.GetBufferSize());
+                if (checksum != nullptr)
+                {
+                    checksum->Update(assembler.GetBuffer(), assembler.GetBufferSize());
+                }
+
+                encodeError = output.Write(assembler.GetBuffer(), assembler.GetBufferSize());
             }
         }
     }
@@ -167,21 +327,29 @@ static int EncodeImageMetadata(
     return encodeError;
 }
 
-int __stdcall WebPSave(
-    const WriteImageFn writeImageCallback,
+// Saves either a linear bitmap or a tile grid, tiles is nullptr for a linear bitmap.
+// The image is written to bufferWriter if it is not nullptr, otherwise it is passed to output.
+static int SaveImage(
+    const ImageOutput& output,
+    FixedBufferWriter* bufferWriter,
     const void* bitmap,
+    const int stride,
+    const TileLayout* tiles,
     const int width,
     const int height,
-    const int stride,
     const EncodeParams* encodeOptions,
     const MetadataParams* metadata,
-    ProgressFn callback)
+    ProgressFn callback,
+    ChecksumType checksumType,
+    uint64_t* checksum)
 {
-    if (writeImageCallback == nullptr || bitmap == nullptr || encodeOptions == nullptr)
+    if ((!output.IsValid() && bufferWriter == nullptr) || encodeOptions == nullptr)
     {
         return VP8_ENC_ERROR_NULL_PARAMETER;
     }
 
+    InteractiveWorkScope interactiveWork;
+
     WebPConfig config;
     ScopedWebPPicture pic;
     ScopedWebPMemoryWriter wrt;
@@ -191,173 +359,691 @@ int __stdcall WebPSave(
         return VP8_ENC_ERROR_OUT_OF_MEMORY;
     }
 
-    if (!WebPConfigPreset(&config, static_cast<WebPPreset>(encodeOptions->preset), encodeOptions->quality) || !pic.IsInitalized())
+    if (!InitializeEncoderConfig(*encodeOptions, config) || !pic.IsInitalized())
     {
         return errVersionMismatch; // WebP API version mismatch
     }
 
-    config.method = 6; // 6 is the highest quality encoding
-    config.thread_level = 1;
+    // With a thread level above zero the alpha plane is encoded by a libwebp worker
+    // while the color planes are being encoded, the workers run on the native worker pool.
+    InstallPoolWorkerInterface();
+
+    PixelTraits traits;
 
-    if (encodeOptions->lossless)
+    if (tiles != nullptr)
     {
-        config.lossless = 1;
-        pic->use_argb = 1;
+        // Only the transparency is needed to gather the tiles, the shortcuts are not used for tiled images.
+        traits.hasTransparency = TiledImageHasTransparency(*tiles, width, height);
+        traits.binaryAlpha = false;
+        traits.grayscale = false;
+        traits.colorCount = MaxTraitColors + 1;
+    }
+    else
+    {
+        ScanPixelTraits(bitmap, width, height, stride, traits);
+    }
 
-        switch (encodeOptions->preset)
-        {
-        case WEBP_PRESET_PHOTO:
-            config.image_hint = WEBP_HINT_PHOTO;
-            break;
-        case WEBP_PRESET_PICTURE:
-            config.image_hint = WEBP_HINT_PICTURE;
-            break;
-        case WEBP_PRESET_DRAWING:
-            config.image_hint = WEBP_HINT_GRAPH;
-            break;
-        }
+    // There is nothing for the crunch mode to search when the shortcut selects the configuration.
+    const bool flatContent = ApplyContentShortcuts(traits, config);
+    const bool lossless = config.lossless != 0;
+
+    if (lossless)
+    {
+        pic->use_argb = 1;
     }
 
     pic->width = width;
     pic->height = height;
 
-    pic->writer = WebPMemoryWrite;
-    pic->custom_ptr = wrt.Get();
+    StreamChecksum outputChecksum(checksum != nullptr ? checksumType : ChecksumNone);
+
+    EncoderContext context;
+    context.progressCallback = callback;
+    context.checksum = &outputChecksum;
+
+    pic->user_data = &context;
 
-    if (HasTransparency(bitmap, width, height, stride))
+    if (bufferWriter != nullptr)
     {
-        if (WebPPictureImportBGRA(pic.Get(), reinterpret_cast<const uint8_t*>(bitmap), stride) == 0)
+        pic->writer = FixedBufferWriter::Write;
+        pic->custom_ptr = bufferWriter;
+    }
+    else
+    {
+        pic->writer = metadata == nullptr && outputChecksum.GetType() != ChecksumNone ? ChecksumMemoryWrite : WebPMemoryWrite;
+        pic->custom_ptr = wrt.Get();
+    }
+
+    const bool hasTransparency = traits.hasTransparency;
+    ScopedImageMemory argbMemory;
+
+    if (lossless)
+    {
+        // The lossless encoder works on the ARGB pixels directly, so they are copied into
+        // image memory that the picture references instead of a libwebp heap allocation.
+        argbMemory.reset(static_cast<uint8_t*>(AllocateImageMemory(static_cast<size_t>(width) * height * sizeof(uint32_t))));
+        if (argbMemory == nullptr)
         {
             return VP8_ENC_ERROR_OUT_OF_MEMORY;
         }
+
+        if (tiles != nullptr)
+        {
+            GatherRows(*tiles, width, 0, height, hasTransparency, reinterpret_cast<uint32_t*>(argbMemory.get()));
+        }
+        else
+        {
+            CopyToArgb(bitmap, width, height, stride, hasTransparency, reinterpret_cast<uint32_t*>(argbMemory.get()));
+        }
+
+        pic->use_argb = 1;
+        pic->argb = reinterpret_cast<uint32_t*>(argbMemory.get());
+        pic->argb_stride = width;
     }
-    else
+    else if (tiles != nullptr)
     {
-        // If the image does not have any transparency import using the BGRX method which will ignore the alpha channel.
-        if (WebPPictureImportBGRX(pic.Get(), reinterpret_cast<const uint8_t*>(bitmap), stride) == 0)
+        if (!ImportTiledImage(*tiles, width, height, hasTransparency, pic.Get()))
         {
             return VP8_ENC_ERROR_OUT_OF_MEMORY;
         }
     }
+    else
+    {
+        const uint8_t* pixels = reinterpret_cast<const uint8_t*>(bitmap);
+
+        if (hasTransparency)
+        {
+            if (WebPPictureImportBGRA(pic.Get(), pixels, stride) == 0)
+            {
+                return VP8_ENC_ERROR_OUT_OF_MEMORY;
+            }
+        }
+        else
+        {
+            // If the image does not have any transparency import using the BGRX method which will ignore the alpha channel.
+            if (WebPPictureImportBGRX(pic.Get(), pixels, stride) == 0)
+            {
+                return VP8_ENC_ERROR_OUT_OF_MEMORY;
+            }
+        }
+    }
 
-    if (callback != nullptr)
+    if (callback != nullptr || WorkerPool::GetCurrentPriority() == JobPriorityBackground)
     {
-        pic->user_data = callback;
         pic->progress_hook = ProgressReport;
     }
 
     int error = VP8_ENC_OK;
-    if (WebPEncode(&config, pic.Get()) != 0) // C-style Boolean
+    bool encoded;
+
+    if (lossless && encodeOptions->crunch && !flatContent)
     {
-        if (metadata != nullptr)
+        error = CrunchLossless(config, pic.Get(), encodeOptions->crunchTimeLimit, callback, wrt);
+        encoded = error == VP8_ENC_OK;
+
+        // The output of the winning configuration was not passed through the picture writer.
+        if (encoded && bufferWriter != nullptr)
         {
-            error = EncodeImageMetadata(wrt.GetBuffer(), wrt.GetBufferSize(), metadata, writeImageCallback);
+            if (!bufferWriter->Append(wrt.GetBuffer(), wrt.GetBufferSize()))
+            {
+                error = VP8_ENC_ERROR_BAD_WRITE;
+                encoded = false;
+            }
         }
-        else
+        else if (encoded && metadata == nullptr)
         {
-            error = writeImageCallback(wrt.GetBuffer(), wrt.GetBufferSize());
+            outputChecksum.Update(wrt.GetBuffer(), wrt.GetBufferSize());
         }
     }
     else
     {
-        error = static_cast<int>(pic->error_code);
+        encoded = WebPEncode(&config, pic.Get()) != 0; // C-style Boolean
+
+        if (!encoded)
+        {
+            error = static_cast<int>(pic->error_code);
+        }
+    }
+
+    if (encoded)
+    {
+        if (bufferWriter != nullptr)
+        {
+            error = bufferWriter->Finish();
+        }
+        else if (metadata != nullptr)
+        {
+            error = EncodeImageMetadata(
+                wrt.GetBuffer(),
+                wrt.GetBufferSize(),
+                metadata,
+                output,
+                outputChecksum.GetType() != ChecksumNone ? &outputChecksum : nullptr);
+        }
+        else
+        {
+            error = output.Write(wrt.GetBuffer(), wrt.GetBufferSize());
+        }
+    }
+
+    if (error == VP8_ENC_OK && checksum != nullptr)
+    {
+        *checksum = outputChecksum.GetValue();
     }
 
     return error;
 }
 
-uint32_t __stdcall GetMetadataSize(const uint8_t* data, size_t dataSize, MetadataType type)
+int __stdcall WebPSave(
+    const WriteImageFn writeImageCallback,
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn callback)
 {
-    uint32_t outSize = 0;
+    return WebPSaveWithChecksum(
+        writeImageCallback,
+        bitmap,
+        width,
+        height,
+        stride,
+        encodeOptions,
+        metadata,
+        callback,
+        ChecksumNone,
+        nullptr);
+}
 
-    WebPData webpData;
-    webpData.bytes = data;
-    webpData.size = dataSize;
+int __stdcall WebPSaveWithChecksum(
+    const WriteImageFn writeImageCallback,
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn callback,
+    ChecksumType checksumType,
+    uint64_t* checksum)
+{
+    if (bitmap == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
 
-    ScopedWebPDemuxer demux(WebPDemux(&webpData));
-    if (demux != nullptr)
+    return SaveImage(
+        ImageOutput(writeImageCallback),
+        nullptr,
+        bitmap,
+        stride,
+        nullptr,
+        width,
+        height,
+        encodeOptions,
+        metadata,
+        callback,
+        checksumType,
+        checksum);
+}
+
+int __stdcall WebPSaveTiled(
+    const WriteImageFn writeImageCallback,
+    const TileLayout* input,
+    const int width,
+    const int height,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn callback)
+{
+    if (!IsValidTileLayout(input))
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    if (!TileLayoutMatchesImage(*input, width, height))
     {
-        uint32_t flags = WebPDemuxGetI(demux.get(), WEBP_FF_FORMAT_FLAGS);
+        return VP8_ENC_ERROR_BAD_DIMENSION;
+    }
 
-        WebPChunkIterator iter;
-        memset(&iter, 0, sizeof(WebPChunkIterator));
-        int result = 0;
+    return SaveImage(
+        ImageOutput(writeImageCallback),
+        nullptr,
+        nullptr,
+        0,
+        input,
+        width,
+        height,
+        encodeOptions,
+        metadata,
+        callback,
+        ChecksumNone,
+        nullptr);
+}
 
-        switch (type)
+int __stdcall WebPSaveToBuffer(
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn callback,
+    uint8_t* output,
+    size_t outputCapacity,
+    size_t* outputSize)
+{
+    if (bitmap == nullptr || outputSize == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    FixedBufferWriter writer(output, outputCapacity, metadata, width, height);
+
+    const int error = SaveImage(
+        ImageOutput(),
+        &writer,
+        bitmap,
+        stride,
+        nullptr,
+        width,
+        height,
+        encodeOptions,
+        metadata,
+        callback,
+        ChecksumNone,
+        nullptr);
+
+    *outputSize = error == VP8_ENC_OK || error == errBufferTooSmall ? writer.GetRequiredSize() : 0;
+
+    return error;
+}
+
+// A generous estimate of the encoded file size, which is used as the initial file allocation.
+// Lossless photographs average about 2 bytes per pixel, and lossy images are well below 1 byte per pixel.
+static uint64_t EstimateEncodedSize(int width, int height, const EncodeParams* encodeOptions, const MetadataParams* metadata)
+{
+    if (width <= 0 || height <= 0 || encodeOptions == nullptr)
+    {
+        return 0;
+    }
+
+    const uint64_t pixelCount = static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+    uint64_t size = encodeOptions->lossless ? pixelCount * 2 : pixelCount / 2;
+
+    if (metadata != nullptr)
+    {
+        size += metadata->iccProfileSize + metadata->exifSize + metadata->xmpSize;
+    }
+
+    return size;
+}
+
+int __stdcall WebPSaveToFile(
+    const wchar_t* path,
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn callback,
+    bool unbuffered,
+    FileFlushPolicy flushPolicy)
+{
+    if (path == nullptr || bitmap == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    FileWriter file;
+
+    int error = file.Open(path, EstimateEncodedSize(width, height, encodeOptions, metadata), unbuffered, flushPolicy);
+
+    if (error == VP8_ENC_OK)
+    {
+        error = SaveImage(
+            ImageOutput(&file),
+            nullptr,
+            bitmap,
+            stride,
+            nullptr,
+            width,
+            height,
+            encodeOptions,
+            metadata,
+            callback,
+            ChecksumNone,
+            nullptr);
+    }
+
+    // The temporary file is deleted when the writer is destroyed without being committed.
+    if (error == VP8_ENC_OK)
+    {
+        error = file.Commit();
+    }
+
+    return error;
+}
+
+SpeculativeSave* __stdcall WebPBeginSpeculativeSave(
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions)
+{
+    // The crunch mode encodes several configurations in parallel, it would use all of the processors
+    // while the user is still choosing the options.
+    if (bitmap == nullptr || encodeOptions == nullptr || (encodeOptions->lossless && encodeOptions->crunch))
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<SpeculativeSave> speculative(new (std::nothrow) SpeculativeSave());
+
+    if (speculative == nullptr || speculative->Start(bitmap, width, height, stride, *encodeOptions) != VP8_ENC_OK)
+    {
+        return nullptr;
+    }
+
+    return speculative.release();
+}
+
+int __stdcall WebPSaveSpeculative(
+    SpeculativeSave* speculative,
+    const WriteImageFn writeImageCallback,
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn callback)
+{
+    if (writeImageCallback == nullptr || bitmap == nullptr || encodeOptions == nullptr)
+    {
+        return VP8_ENC_ERROR_NULL_PARAMETER;
+    }
+
+    if (speculative != nullptr)
+    {
+        if (speculative->Matches(bitmap, width, height, stride, *encodeOptions))
         {
-        case ColorProfile:
-            if ((flags & ICCP_FLAG) != 0)
-            {
-                result = WebPDemuxGetChunk(demux.get(), "ICCP", 1, &iter);
-            }
-        break;
-        case EXIF:
-            if ((flags & EXIF_FLAG) != 0)
+            const int error = speculative->Wait(callback);
+
+            if (error != VP8_ENC_OK)
             {
-                result = WebPDemuxGetChunk(demux.get(), "EXIF", 1, &iter);
+                return error;
             }
-            break;
-        case XMP:
-            if ((flags & XMP_FLAG) != 0)
+
+            if (metadata != nullptr)
             {
-                result = WebPDemuxGetChunk(demux.get(), "XMP ", 1, &iter);
+                return EncodeImageMetadata(speculative->GetBuffer(), speculative->GetBufferSize(), metadata, ImageOutput(writeImageCallback), nullptr);
             }
-            break;
+
+            return writeImageCallback(speculative->GetBuffer(), speculative->GetBufferSize());
         }
 
-        if (result != 0)
+        // Stop the speculative encode before starting the real one so they do not compete for the processors.
+        speculative->Cancel();
+    }
+
+    return WebPSave(writeImageCallback, bitmap, width, height, stride, encodeOptions, metadata, callback);
+}
+
+void __stdcall WebPEndSpeculativeSave(SpeculativeSave* speculative)
+{
+    delete speculative;
+}
+
+void __stdcall WebPSaveBatch(SaveJob* jobs, int jobCount, JobPriority priority)
+{
+    if (jobs == nullptr || jobCount <= 0 || priority < JobPriorityInteractive || priority >= JobPriorityCount)
+    {
+        return;
+    }
+
+    WorkerPool& pool = WorkerPool::GetInstance();
+    TaskGroup group(priority);
+
+    for (int i = 0; i < jobCount; i++)
+    {
+        SaveJob* job = &jobs[i];
+
+        // The WebPPicture and the encoder output are allocated by the worker,
+        // so the memory is placed on the same node as the input bitmap.
+        group.Run([job]()
+        {
+            job->result = WebPSave(
+                job->writeImageCallback,
+                job->bitmap,
+                job->width,
+                job->height,
+                job->stride,
+                job->encodeOptions,
+                job->metadata,
+                job->progressCallback);
+        }, pool.GetNodeForAddress(job->bitmap));
+    }
+
+    group.Wait();
+}
+
+void __stdcall WebPLoadBatch(LoadJob* jobs, int jobCount, JobPriority priority)
+{
+    if (jobs == nullptr || jobCount <= 0 || priority < JobPriorityInteractive || priority >= JobPriorityCount)
+    {
+        return;
+    }
+
+    WorkerPool& pool = WorkerPool::GetInstance();
+    TaskGroup group(priority);
+
+    for (int i = 0; i < jobCount; i++)
+    {
+        LoadJob* job = &jobs[i];
+
+        // The decoder writes every pixel of the output buffer, so the job is routed to the
+        // node that holds it and falls back to the node that holds the input data.
+        int node = pool.GetNodeForAddress(job->outData);
+        if (node < 0)
         {
-            outSize = static_cast<uint32_t>(iter.chunk.size);
+            node = pool.GetNodeForAddress(job->data);
         }
 
-        WebPDemuxReleaseChunkIterator(&iter);
+        group.Run([job]()
+        {
+            job->result = WebPLoad(job->data, job->dataSize, job->outData, job->outSize, job->outStride);
+        }, node);
     }
 
-    return outSize;
+    group.Wait();
 }
 
-void __stdcall ExtractMetadata(const uint8_t* data, size_t dataSize, uint8_t* outData, uint32_t outSize, MetadataType type)
+bool __stdcall WebPEnableLargePages(bool enabled)
+{
+    return EnableLargePageMemory(enabled);
+}
+
+// Finds the first metadata chunk of the specified type.
+// The chunk data points into the file data, it remains valid after the demuxer is destroyed.
+static bool GetMetadataChunk(const WebPDemuxer* demux, MetadataType type, WebPData& chunk)
+{
+    const char* fourcc;
+    uint32_t flag;
+
+    switch (type)
+    {
+    case ColorProfile:
+        fourcc = "ICCP";
+        flag = ICCP_FLAG;
+        break;
+    case EXIF:
+        fourcc = "EXIF";
+        flag = EXIF_FLAG;
+        break;
+    case XMP:
+        fourcc = "XMP ";
+        flag = XMP_FLAG;
+        break;
+    default:
+        return false;
+    }
+
+    const uint32_t flags = WebPDemuxGetI(demux, WEBP_FF_FORMAT_FLAGS);
+    if ((flags & flag) == 0)
+    {
+        return false;
+    }
+
+    WebPChunkIterator iter;
+    memset(&iter, 0, sizeof(WebPChunkIterator));
+
+    const bool result = WebPDemuxGetChunk(demux, fourcc, 1, &iter) != 0;
+
+    if (result)
+    {
+        chunk = iter.chunk;
+    }
+
+    WebPDemuxReleaseChunkIterator(&iter);
+
+    return result;
+}
+
+static ScopedWebPDemuxer DemuxImage(const uint8_t* data, size_t dataSize)
 {
     WebPData webpData;
     webpData.bytes = data;
     webpData.size = dataSize;
 
-    ScopedWebPDemuxer demux(WebPDemux(&webpData));
+    return ScopedWebPDemuxer(WebPDemux(&webpData));
+}
+
+uint32_t __stdcall GetMetadataSize(const uint8_t* data, size_t dataSize, MetadataType type)
+{
+    uint32_t outSize = 0;
+
+    ScopedWebPDemuxer demux(DemuxImage(data, dataSize));
     if (demux != nullptr)
     {
-        uint32_t flags = WebPDemuxGetI(demux.get(), WEBP_FF_FORMAT_FLAGS);
+        WebPData chunk;
 
-        WebPChunkIterator iter;
-        memset(&iter, 0, sizeof(WebPChunkIterator));
-        int result = 0;
+        if (GetMetadataChunk(demux.get(), type, chunk))
+        {
+            outSize = static_cast<uint32_t>(chunk.size);
+        }
+    }
+
+    return outSize;
+}
+
+void __stdcall ExtractMetadata(const uint8_t* data, size_t dataSize, uint8_t* outData, uint32_t outSize, MetadataType type)
+{
+    ScopedWebPDemuxer demux(DemuxImage(data, dataSize));
+    if (demux != nullptr)
+    {
+        WebPData chunk;
 
-        switch (type)
+        if (GetMetadataChunk(demux.get(), type, chunk))
         {
-        case ColorProfile:
-            if ((flags & ICCP_FLAG) != 0)
-            {
-                result = WebPDemuxGetChunk(demux.get(), "ICCP", 1, &iter);
-            }
-        break;
-        case EXIF:
-            if ((flags & EXIF_FLAG) != 0)
-            {
-                result = WebPDemuxGetChunk(demux.get(), "EXIF", 1, &iter);
-            }
-            break;
-        case XMP:
-            if ((flags & XMP_FLAG) != 0)
-            {
-                result = WebPDemuxGetChunk(demux.get(), "XMP ", 1, &iter);
-            }
-            break;
+            memcpy_s(outData, outSize, chunk.bytes, chunk.size);
         }
+    }
+}
+
+bool __stdcall WebPGetExifImageInfo(const uint8_t* data, size_t dataSize, ExifImageInfo* info)
+{
+    if (info == nullptr)
+    {
+        return false;
+    }
+
+    memset(info, 0, sizeof(*info));
+
+    ScopedWebPDemuxer demux(DemuxImage(data, dataSize));
+    WebPData chunk;
+
+    if (demux == nullptr || !GetMetadataChunk(demux.get(), EXIF, chunk))
+    {
+        return false;
+    }
+
+    return ReadExifImageInfo(chunk.bytes, chunk.size, *info);
+}
+
+// Locates all of the metadata chunks with a single demuxer, the chunks are validated
+// in the same way as GetMetadataSize and ExtractMetadata.
+static void FindMetadataSpans(const uint8_t* data, size_t dataSize, LoadResult& result)
+{
+    ScopedWebPDemuxer demux(DemuxImage(data, dataSize));
+    if (demux == nullptr)
+    {
+        return;
+    }
+
+    const MetadataType types[] = { ColorProfile, EXIF, XMP };
+    MetadataSpan* spans[] = { &result.iccProfile, &result.exif, &result.xmp };
 
-        if (result != 0)
+    for (size_t i = 0; i < 3; i++)
+    {
+        WebPData chunk;
+
+        if (GetMetadataChunk(demux.get(), types[i], chunk))
         {
-            memcpy_s(outData, outSize, iter.chunk.bytes, iter.chunk.size);
+            spans[i]->offset = static_cast<size_t>(chunk.bytes - data);
+            spans[i]->size = chunk.size;
         }
+    }
+}
+
+int __stdcall WebPLoadWithMetadata(
+    const uint8_t* data,
+    size_t dataSize,
+    uint8_t* outData,
+    size_t outSize,
+    int outStride,
+    LoadResult* result)
+{
+    if (data == nullptr || result == nullptr)
+    {
+        return VP8_STATUS_INVALID_PARAM;
+    }
+
+    memset(result, 0, sizeof(*result));
+
+    int status = WebPGetImageInfo(data, dataSize, &result->info);
+    if (status != VP8_STATUS_OK)
+    {
+        return status;
+    }
 
-        WebPDemuxReleaseChunkIterator(&iter);
+    // The sizing call only needs the image information, the metadata is located by the call that decodes the image.
+    if (outData == nullptr)
+    {
+        return errBufferTooSmall;
+    }
+
+    FindMetadataSpans(data, dataSize, *result);
+
+    if (result->exif.size > 0)
+    {
+        ReadExifImageInfo(data + result->exif.offset, result->exif.size, result->exifInfo);
+    }
+
+    const int width = result->info.width;
+    const int height = result->info.height;
+
+    if (outStride < 0 ||
+        static_cast<int64_t>(outStride) < static_cast<int64_t>(width) * 4 ||
+        outSize < (static_cast<uint64_t>(outStride) * (height - 1)) + (static_cast<uint64_t>(width) * 4))
+    {
+        return errBufferTooSmall;
     }
-}
\ No newline at end of file
+
+    return WebPLoad(data, dataSize, outData, outSize, outStride);
+}
+
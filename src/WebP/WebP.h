@@ -37,13 +37,34 @@ typedef bool (__stdcall *ProgressFn)(int progress);
 // the WebPMemoryWriter's buffer instead requiring that new memory be allocated to store the entire image.
 typedef WebPEncodingError (__stdcall *WriteImageFn)(const uint8_t* image, const size_t imageSize);
 
+// This must be kept in sync with the EncodeParams class in WebPNative.cs.
 typedef struct EncodeParams
 {
     float quality;
     int preset;
     bool lossless;
+    // Encodes a lossless image with several configurations in parallel and keeps the smallest.
+    bool crunch;
+    // The time limit for the alternative crunch configurations in milliseconds, 0 for no limit.
+    int crunchTimeLimit;
+    // The alpha plane compression method, 0 = none and 1 = lossless.
+    // A negative value uses the encoder default for this and the following alpha options.
+    int alphaCompression;
+    // The alpha plane predictive filtering method, 0 = none, 1 = fast and 2 = best.
+    int alphaFiltering;
+    // The alpha plane quality, between 0 and 100.
+    int alphaQuality;
+    // The encoder effort, between 0 (fastest) and 6 (slowest). A negative value uses 6.
+    int method;
 }EncParams;
 
+enum ChecksumType
+{
+    ChecksumNone = 0,
+    ChecksumCrc32c,
+    ChecksumXxHash64
+};
+
 enum MetadataType
 {
     ColorProfile = 0,
@@ -62,6 +83,23 @@ typedef struct MetadataParams
     size_t xmpSize;
 }MetadataParams;
 
+// Describes an image that is stored as a grid of BGRA tiles.
+// The tiles on the right and bottom edges are allocated at the full tile size, only the part
+// that is inside the image is read or written.
+typedef struct TileLayout
+{
+    // The tile pointers in row-major order, the array holds gridWidth * gridHeight pointers.
+    uint8_t** tiles;
+    int tileWidth;
+    int tileHeight;
+    // The distance in bytes between the rows of a tile.
+    int tileStride;
+    // The number of tiles across and down, these must be ceil(width / tileWidth) and
+    // ceil(height / tileHeight) for the size of the image that is loaded or saved.
+    int gridWidth;
+    int gridHeight;
+}TileLayout;
+
 typedef struct ImageInfo
 {
     int width;
@@ -73,6 +111,37 @@ DLLEXPORT int __stdcall WebPGetImageInfo(const uint8_t* data, size_t dataSize, I
 
 DLLEXPORT int __stdcall WebPLoad(const uint8_t* data, size_t dataSize, uint8_t* outData, size_t outSize, int outStride);
 
+// Decodes the image into a tile grid, the rows are copied into the tiles while the image is decoded.
+// Returns VP8_STATUS_INVALID_PARAM if the tile grid does not match the image size.
+DLLEXPORT int __stdcall WebPLoadTiled(const uint8_t* data, size_t dataSize, const TileLayout* output);
+
+// Decodes the image into a view of a file mapping that was created by CreateFileMapping, the BGRA rows
+// start at the specified byte offset in the mapping. The rows are written back to the file and removed
+// from the working set while the image is decoded, so the output of a lossy image can be larger than
+// the available memory. The lossless decoder keeps a full size ARGB copy of the image in memory,
+// only the output rows are released for a lossless image.
+DLLEXPORT int __stdcall WebPLoadToFileMapping(const uint8_t* data, size_t dataSize, void* fileMapping, uint64_t offset, int outStride);
+
+// The pixel formats of WebPLoadLinear, each pixel holds premultiplied linear-light R, G, B and A channels.
+enum LinearPixelFormat
+{
+    // IEEE single precision, 16 bytes per pixel.
+    LinearPixelFormatFloat32 = 0,
+    // IEEE half precision, 8 bytes per pixel.
+    LinearPixelFormatFloat16
+};
+
+// Decodes the image to premultiplied linear-light RGBA for compositing.
+// The sRGB rows are decoded into the output buffer and expanded in place as soon as each row
+// is complete, so there is no intermediate 8-bit image or separate conversion pass.
+DLLEXPORT int __stdcall WebPLoadLinear(
+    const uint8_t* data,
+    size_t dataSize,
+    void* outData,
+    size_t outSize,
+    int outStride,
+    LinearPixelFormat format);
+
 DLLEXPORT int __stdcall WebPSave(
     const WriteImageFn writeImageCallback,
     const void* bitmap,
@@ -83,14 +152,453 @@ DLLEXPORT int __stdcall WebPSave(
     const MetadataParams* metadata,
     ProgressFn progressCallback);
 
+// Saves the image in the same way as WebPSave, and computes a checksum of the bytes that are
+// passed to writeImageCallback while they are being written.
+// When the image has no metadata the checksum is updated as the encoder emits each block of the
+// image, otherwise the assembled file is checksummed immediately before it is passed to the callback.
+DLLEXPORT int __stdcall WebPSaveWithChecksum(
+    const WriteImageFn writeImageCallback,
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn progressCallback,
+    ChecksumType checksumType,
+    uint64_t* checksum);
+
+// Saves an image that is stored as a tile grid, the encoder imports the pixels directly from the tiles.
+// The lossy encoder converts the tiles to YUV one band of rows at a time, the lossless encoder
+// gathers them into the ARGB picture that it encodes.
+// Returns VP8_ENC_ERROR_BAD_DIMENSION if the tile grid does not match the image size.
+DLLEXPORT int __stdcall WebPSaveTiled(
+    const WriteImageFn writeImageCallback,
+    const TileLayout* input,
+    const int width,
+    const int height,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn progressCallback);
+
+// Saves the image directly into a caller-provided buffer, without the write image callback.
+// If the image does not fit in the buffer errBufferTooSmall is returned, and outputSize
+// receives the required buffer size. Otherwise outputSize receives the size of the image.
+DLLEXPORT int __stdcall WebPSaveToBuffer(
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn progressCallback,
+    uint8_t* output,
+    size_t outputCapacity,
+    size_t* outputSize);
+
+// Controls when the data that WebPSaveToFile writes is flushed to the storage device.
+enum FileFlushPolicy
+{
+    // The data is left in the system cache, the file system writes it back lazily.
+    FileFlushNone = 0,
+    // The file buffers are flushed after the image has been written.
+    FileFlushOnCommit,
+    // Every write goes through the system cache to the device before it completes.
+    FileFlushWriteThrough
+};
+
+// Saves the image to the specified file, the encoder output is written from native code.
+// When unbuffered is true the file is written in large sector-aligned blocks that bypass the system cache.
+// The image is written to a temporary file in the same directory, which replaces the specified file once
+// the image has been saved. If the image could not be saved an existing file is left unchanged.
+// The plugin does not call this function, Paint.NET passes it a stream that the host owns rather than a path.
+DLLEXPORT int __stdcall WebPSaveToFile(
+    const wchar_t* path,
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn progressCallback,
+    bool unbuffered,
+    FileFlushPolicy flushPolicy);
+
+// A background encode that is started when the save options are shown, see WebPBeginSpeculativeSave.
+typedef struct SpeculativeSave SpeculativeSave;
+
+// Starts encoding a copy of the image with the current save options on a background thread.
+// Returns nullptr if the image could not be copied, or if the options use the lossless crunch mode.
+DLLEXPORT SpeculativeSave* __stdcall WebPBeginSpeculativeSave(
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions);
+
+// Saves the image in the same way as WebPSave, the speculative encode is used if it was started with
+// the same image and encoding options. Otherwise it is cancelled and the image is encoded again.
+// The speculative parameter can be nullptr.
+DLLEXPORT int __stdcall WebPSaveSpeculative(
+    SpeculativeSave* speculative,
+    const WriteImageFn writeImageCallback,
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const EncodeParams* encodeOptions,
+    const MetadataParams* metadata,
+    ProgressFn progressCallback);
+
+// Cancels the speculative encode if it is still running and releases it.
+DLLEXPORT void __stdcall WebPEndSpeculativeSave(SpeculativeSave* speculative);
+
+// A WebPSave call that is part of a batch, the result field receives the WebPSave return value.
+typedef struct SaveJob
+{
+    WriteImageFn writeImageCallback;
+    const void* bitmap;
+    int width;
+    int height;
+    int stride;
+    const EncodeParams* encodeOptions;
+    const MetadataParams* metadata;
+    ProgressFn progressCallback;
+    int result;
+}SaveJob;
+
+// A WebPLoad call that is part of a batch, the result field receives the WebPLoad return value.
+typedef struct LoadJob
+{
+    const uint8_t* data;
+    size_t dataSize;
+    uint8_t* outData;
+    size_t outSize;
+    int outStride;
+    int result;
+}LoadJob;
+
+// The scheduling class of the native worker pool jobs.
+enum JobPriority
+{
+    // Work that the user is waiting for, such as saving the open document.
+    JobPriorityInteractive = 0,
+    JobPriorityNormal,
+    // Bulk work, it runs at a lower OS priority and pauses while interactive work is running.
+    JobPriorityBackground,
+    JobPriorityCount
+};
+
+// Runs the jobs on the native worker pool and waits for all of them to finish.
+// Each job is routed to the NUMA node that holds its input, the image is then
+// encoded or decoded by a worker that is pinned to that node.
+// The jobs are queued with the specified priority, the workers take higher priority jobs first.
+DLLEXPORT void __stdcall WebPSaveBatch(SaveJob* jobs, int jobCount, JobPriority priority);
+
+DLLEXPORT void __stdcall WebPLoadBatch(LoadJob* jobs, int jobCount, JobPriority priority);
+
+// Enables or disables large pages for the image buffers that the library allocates, e.g. the ARGB copy
+// of an image that is saved as lossless. Large pages are not used by default because they are never
+// paged out. The process token must already have the SeLockMemoryPrivilege enabled, the library does
+// not enable it. Returns true if large pages will be used.
+DLLEXPORT bool __stdcall WebPEnableLargePages(bool enabled);
+
+// The animation frame callback, called after each frame has been composited onto the canvas.
+// Returns true if decoding should continue, or false to abort the decoding process.
+typedef bool (__stdcall *AnimationFrameFn)(int frameIndex, int duration);
+
+// Decodes the frames of an animated image onto a caller-provided BGRA canvas.
+// The frame bitstreams are decoded concurrently on the native worker pool, and the frames
+// are blended onto the canvas in order, frameCallback is called after each frame.
+DLLEXPORT int __stdcall WebPLoadAnimation(
+    const uint8_t* data,
+    size_t dataSize,
+    uint8_t* canvas,
+    size_t canvasSize,
+    int canvasStride,
+    AnimationFrameFn frameCallback);
+
+// Moves the output stream to an absolute position.
+typedef WebPEncodingError (__stdcall *SeekFn)(uint64_t position);
+
+// Writes an animation to a stream one frame at a time, see WebPAnimationWriterCreate.
+typedef struct AnimationWriter AnimationWriter;
+
+typedef struct AnimationFrameParams
+{
+    // The frame offset on the canvas, the offset must be even.
+    int x;
+    int y;
+    // The frame duration in milliseconds.
+    int duration;
+    WebPMuxAnimDispose dispose;
+    WebPMuxAnimBlend blend;
+}AnimationFrameParams;
+
+// Creates an animation writer and writes the container headers and the color profile.
+// Each frame is written as soon as it has been encoded, WebPAnimationWriterFinish appends the EXIF
+// and XMP chunks and uses the seek callback to update the container header.
+// A loop count of 0 repeats the animation indefinitely, the background color is in BGRA byte order.
+DLLEXPORT int __stdcall WebPAnimationWriterCreate(
+    const WriteImageFn writeImageCallback,
+    const SeekFn seekCallback,
+    const int canvasWidth,
+    const int canvasHeight,
+    const int loopCount,
+    const uint32_t backgroundColor,
+    const MetadataParams* metadata,
+    AnimationWriter** writer);
+
+// Encodes a frame and writes it to the stream, the lossless crunch option is not used for animation frames.
+// If the frame could not be encoded nothing is written, and other frames can still be added.
+DLLEXPORT int __stdcall WebPAnimationWriterAddFrame(
+    AnimationWriter* writer,
+    const void* bitmap,
+    const int width,
+    const int height,
+    const int stride,
+    const AnimationFrameParams* frameParams,
+    const EncodeParams* encodeOptions,
+    ProgressFn progressCallback);
+
+// Encodes a frame that covers the whole canvas, only the rectangle that differs from the previous canvas is written.
+DLLEXPORT int __stdcall WebPAnimationWriterAddCanvasFrame(
+    AnimationWriter* writer,
+    const void* bitmap,
+    const int stride,
+    const int duration,
+    const EncodeParams* encodeOptions,
+    ProgressFn progressCallback);
+
+// Creates a writer that appends frames to an existing animation in place, without encoding the existing frames again.
+// The write and seek callbacks must operate on a stream that holds the existing file data. The new frames are
+// written after the existing data and the file is only updated by WebPAnimationWriterFinish, so the original
+// animation is still intact if the append is not finished.
+// If previousFrame is not nullptr it must be the canvas that was passed for the last existing frame, the first
+// WebPAnimationWriterAddCanvasFrame call then only stores the difference from it.
+DLLEXPORT int __stdcall WebPAnimationWriterOpen(
+    const uint8_t* data,
+    size_t dataSize,
+    const WriteImageFn writeImageCallback,
+    const SeekFn seekCallback,
+    const void* previousFrame,
+    const int previousFrameStride,
+    AnimationWriter** writer);
+
+DLLEXPORT int __stdcall WebPAnimationWriterFinish(AnimationWriter* writer);
+
+DLLEXPORT void __stdcall WebPAnimationWriterDelete(AnimationWriter* writer);
+
+// Writes a frame of an animation as a still image, the frame index is zero-based.
+// The bitstream of a frame that covers the canvas and does not depend on the previous frames is copied
+// without decoding it, other frames are composited from the closest key frame and encoded with encodeOptions.
+// Returns VP8_ENC_ERROR_INVALID_CONFIGURATION if the file is not a valid animation or the frame does not exist.
+DLLEXPORT int __stdcall WebPExtractFrame(
+    const uint8_t* data,
+    size_t dataSize,
+    int frameIndex,
+    const EncodeParams* encodeOptions,
+    const WriteImageFn writeImageCallback);
+
+typedef struct ImageFeatures
+{
+    // The number of unique BGRA colors, images with more than 256 colors report 257.
+    int colorCount;
+    // The fraction of pixels that differ from a neighboring pixel by a large luma step, between 0 and 1.
+    float edgeDensity;
+    bool hasTransparency;
+    // Every alpha value is either 0 or 255.
+    bool hasBinaryAlpha;
+    // The blue, green and red channels are equal in every pixel.
+    bool isGrayscale;
+}ImageFeatures;
+
+DLLEXPORT void __stdcall WebPAnalyzeImage(const void* bitmap, int width, int height, int stride, ImageFeatures* features);
+
+// The content clusters that the encoder tuner recommends a profile for.
+enum ContentCluster
+{
+    // At most 256 colors, e.g. icons, diagrams and screenshots.
+    ContentPalette = 0,
+    // Photographs and gradients with a low edge density.
+    ContentSmooth,
+    // Photographs and artwork with a high edge density.
+    ContentDetailed,
+    ContentClusterCount
+};
+
+typedef struct TuneImage
+{
+    const void* bitmap;
+    int width;
+    int height;
+    int stride;
+}TuneImage;
+
+typedef struct TuneParams
+{
+    // The minimum SSIM between the source and decoded image, between 0 and 1.
+    float targetSsim;
+    // The maximum number of corpus images that are encoded, 0 to encode every image.
+    int sampleCount;
+    // The encoding options that are compared, nullptr selects a built-in sweep of the
+    // presets, quality and method values.
+    const EncodeParams* candidates;
+    int candidateCount;
+}TuneParams;
+
+typedef struct TuneProfile
+{
+    EncodeParams params;
+    // The number of sampled images in the cluster, the other fields are zero if this is zero.
+    int imageCount;
+    // false if no candidate reached the SSIM target for every image, params then contains
+    // the candidate with the highest average SSIM.
+    bool meetsTarget;
+    float averageSsim;
+    // The average encode time in milliseconds.
+    double averageEncodeTime;
+    double averageSize;
+}TuneProfile;
+
+// Encodes a sample of the corpus with each candidate, one encode at a time so that the encode times are not
+// skewed by each other, then computes the SSIM of the candidates in parallel on the native worker pool and
+// recommends the candidate with the lowest encode time that meets the SSIM target for each content cluster.
+// The profiles array must have ContentClusterCount entries.
+DLLEXPORT int __stdcall WebPTuneEncodeParams(
+    const TuneImage* images,
+    int imageCount,
+    const TuneParams* tuneParams,
+    TuneProfile* profiles);
+
+enum WebPValidationStatus
+{
+    WebPValidationOk = 0,
+    // The data does not start with a RIFF header that has the WEBP form type.
+    WebPValidationNotWebP,
+    // The RIFF size is too small to hold a chunk.
+    WebPValidationBadRiffSize,
+    // The RIFF size covers more data than was supplied.
+    WebPValidationTruncated,
+    // A chunk header or payload extends past the end of the RIFF data.
+    WebPValidationBadChunkSize,
+    // The VP8X chunk is too small, has reserved flags set or the canvas is too large.
+    WebPValidationBadVP8X,
+    // The VP8X flags do not match the chunks that are present.
+    WebPValidationFlagMismatch,
+    // A chunk is in the wrong position, duplicated or not allowed in this format.
+    WebPValidationUnexpectedChunk,
+    // The file or an animation frame does not contain any image data.
+    WebPValidationMissingImage,
+    WebPValidationBadVP8Header,
+    WebPValidationBadVP8LHeader,
+    // The bitstream dimensions do not match the canvas or animation frame size.
+    WebPValidationDimensionMismatch,
+    // The ANIM chunk is missing, duplicated or too small, or an ANMF chunk is too small.
+    WebPValidationBadAnimation,
+    // An animation frame extends past the canvas.
+    WebPValidationBadFrameBounds
+};
+
+// Checks the structure of a WebP file without decoding the image data.
+// The RIFF chunks, VP8X flags, VP8 and VP8L frame headers and animation frame bounds are checked.
+// Returns a WebPValidationStatus value, errorOffset receives the file offset of the first error.
+DLLEXPORT int __stdcall WebPValidate(const uint8_t* data, size_t dataSize, size_t* errorOffset);
+
+typedef struct QualityEstimate
+{
+    // The estimated libwebp quality setting that the image was encoded with, 100 for lossless images.
+    float quality;
+    bool lossless;
+}QualityEstimate;
+
+// Estimates the encoder quality from the segment quantizers in the VP8 frame headers, without decoding the image.
+// The estimate for an animation is the average of the lossy frames.
+// The plugin does not call this function: Paint.NET creates the save options without the document that is
+// being saved and restores the options that were used last, so they cannot be seeded from the loaded image.
+DLLEXPORT int __stdcall WebPEstimateQuality(const uint8_t* data, size_t dataSize, QualityEstimate* estimate);
+
 DLLEXPORT uint32_t __stdcall GetMetadataSize(const uint8_t* data, size_t dataSize, MetadataType type);
 
 DLLEXPORT void __stdcall ExtractMetadata(const uint8_t* data, size_t dataSize, uint8_t* outData, uint32_t outSize, MetadataType type);
 
+// The EXIF tags that are applied when an image is loaded, a field is zero if the tag is not present or not valid.
+// This must be kept in sync with the ExifImageInfo structure in WebPNative.cs.
+typedef struct ExifImageInfo
+{
+    uint16_t orientation;
+    uint16_t resolutionUnit;
+    double xResolution;
+    double yResolution;
+}ExifImageInfo;
+
+// Reads the orientation and resolution tags from the first IFD of the EXIF chunk, without parsing the other tags.
+// Returns false if the image does not have an EXIF chunk or the chunk is not valid.
+DLLEXPORT bool __stdcall WebPGetExifImageInfo(const uint8_t* data, size_t dataSize, ExifImageInfo* info);
+
+// The location of a chunk payload in the file data, the size is zero if the chunk is not present.
+// This must be kept in sync with the MetadataSpan structure in WebPNative.cs.
+typedef struct MetadataSpan
+{
+    size_t offset;
+    size_t size;
+}MetadataSpan;
+
+// This must be kept in sync with the LoadResult structure in WebPNative.cs.
+typedef struct LoadResult
+{
+    ImageInfo info;
+    MetadataSpan iccProfile;
+    MetadataSpan exif;
+    MetadataSpan xmp;
+    ExifImageInfo exifInfo;
+}LoadResult;
+
+// Decodes the image and locates its metadata in a single call, the metadata is returned as spans of the
+// input data so the caller can copy it without calling GetMetadataSize and ExtractMetadata.
+// If outData is nullptr errBufferTooSmall is returned after only the image information has been read,
+// so the caller can allocate the buffer and call the function again. If the buffer is too small for the image
+// errBufferTooSmall is returned with the metadata spans filled in.
+DLLEXPORT int __stdcall WebPLoadWithMetadata(
+    const uint8_t* data,
+    size_t dataSize,
+    uint8_t* outData,
+    size_t outSize,
+    int outStride,
+    LoadResult* result);
+
+// Loads an ordered list of files ahead of the consumer, see WebPSequenceLoaderCreate.
+typedef struct SequenceLoader SequenceLoader;
+
+// Starts reading and decoding the first prefetchCount files on the worker pool.
+// The decoded images that have not been returned by WebPSequenceLoaderNext are limited to memoryBudget bytes,
+// an image that does not fit is loaded when the consumer reaches it.
+DLLEXPORT int __stdcall WebPSequenceLoaderCreate(
+    const wchar_t* const* paths,
+    int pathCount,
+    int prefetchCount,
+    uint64_t memoryBudget,
+    SequenceLoader** loader);
+
+// Copies the next image in the sequence as BGRA, and starts loading the file that follows the prefetched files.
+// If outData is nullptr or the buffer is too small for the image errBufferTooSmall is returned and the loader
+// stays on the image, info is still filled in so the caller can allocate the buffer and call the function again.
+// A file that cannot be loaded returns its error and is skipped, errEndOfSequence is returned after the last file.
+// A file that does not exist or cannot be opened returns errFileOpenFailed.
+DLLEXPORT int __stdcall WebPSequenceLoaderNext(SequenceLoader* loader, ImageInfo* info, uint8_t* outData, size_t outSize, int outStride);
+
+DLLEXPORT void __stdcall WebPSequenceLoaderDelete(SequenceLoader* loader);
+
 #define errVersionMismatch -1
 
 #define errMuxEncodeMetadata -2
 
+#define errBufferTooSmall -3
+
+#define errEndOfSequence -4
+
+#define errFileOpenFailed -5
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
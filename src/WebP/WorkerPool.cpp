@@ -0,0 +1,485 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <psapi.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "WorkerPool.h"
+
+namespace
+{
+    thread_local JobPriority currentPriority = JobPriorityInteractive;
+    // The node of the pool worker that is running on this thread, or -1 for the other threads.
+    thread_local int workerNode = -1;
+    // True while RunJob has put this thread in the background processing mode.
+    thread_local bool backgroundModeActive = false;
+
+    int CountProcessors(KAFFINITY mask)
+    {
+        int count = 0;
+
+        while (mask != 0)
+        {
+            mask &= mask - 1;
+            count++;
+        }
+
+        return count;
+    }
+}
+
+WorkerPool& WorkerPool::GetInstance()
+{
+    // The pool is intentionally never destroyed, joining the worker threads
+    // from the static destructors of a DLL would deadlock on the loader lock.
+    static WorkerPool* instance = new WorkerPool();
+
+    return *instance;
+}
+
+WorkerPool::WorkerPool() : nodes(), mutex(), workerCount(0), nextNode(0), interactiveWork(0), interactiveMutex(), interactiveWorkChanged()
+{
+    ULONG highestNodeNumber = 0;
+    std::vector<GROUP_AFFINITY> affinities;
+
+    if (GetNumaHighestNodeNumber(&highestNodeNumber) && highestNodeNumber > 0)
+    {
+        for (ULONG i = 0; i <= highestNodeNumber; i++)
+        {
+            GROUP_AFFINITY affinity;
+            memset(&affinity, 0, sizeof(affinity));
+
+            // Skip the nodes that only contain memory.
+            if (GetNumaNodeProcessorMaskEx(static_cast<USHORT>(i), &affinity) && affinity.Mask != 0)
+            {
+                nodes.push_back(std::unique_ptr<Node>(new Node(static_cast<unsigned short>(i))));
+                affinities.push_back(affinity);
+            }
+        }
+    }
+
+    if (nodes.size() > 1)
+    {
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            const int nodeWorkerCount = CountProcessors(affinities[i].Mask);
+
+            for (int j = 0; j < nodeWorkerCount; j++)
+            {
+                std::thread worker(&WorkerPool::WorkerThread, this, static_cast<int>(i));
+
+                SetThreadGroupAffinity(worker.native_handle(), &affinities[i], nullptr);
+                worker.detach();
+            }
+
+            workerCount += nodeWorkerCount;
+        }
+    }
+    else
+    {
+        // Single-node machine, or the NUMA topology could not be queried.
+        nodes.clear();
+        nodes.push_back(std::unique_ptr<Node>(new Node(0)));
+
+        workerCount = static_cast<int>(std::thread::hardware_concurrency());
+        if (workerCount < 1)
+        {
+            workerCount = 1;
+        }
+
+        for (int i = 0; i < workerCount; i++)
+        {
+            std::thread(&WorkerPool::WorkerThread, this, 0).detach();
+        }
+    }
+}
+
+int WorkerPool::GetNodeForAddress(const void* address) const
+{
+    if (nodes.size() == 1)
+    {
+        return 0;
+    }
+
+    if (address == nullptr)
+    {
+        return -1;
+    }
+
+    PSAPI_WORKING_SET_EX_INFORMATION info;
+    memset(&info, 0, sizeof(info));
+    info.VirtualAddress = const_cast<void*>(address);
+
+    if (QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)) && info.VirtualAttributes.Valid)
+    {
+        const unsigned short number = static_cast<unsigned short>(info.VirtualAttributes.Node);
+
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            if (nodes[i]->number == number)
+            {
+                return static_cast<int>(i);
+            }
+        }
+    }
+
+    return -1;
+}
+
+int WorkerPool::GetCurrentNode() const
+{
+    if (nodes.size() == 1)
+    {
+        return 0;
+    }
+
+    // The workers are affinitized to their node, the other threads may be moved between nodes by the scheduler.
+    if (workerNode >= 0)
+    {
+        return workerNode;
+    }
+
+    PROCESSOR_NUMBER processor;
+    USHORT number;
+
+    GetCurrentProcessorNumberEx(&processor);
+
+    if (GetNumaProcessorNodeEx(&processor, &number))
+    {
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            if (nodes[i]->number == number)
+            {
+                return static_cast<int>(i);
+            }
+        }
+    }
+
+    return -1;
+}
+
+JobPriority WorkerPool::GetCurrentPriority()
+{
+    return currentPriority;
+}
+
+void WorkerPool::SetCurrentPriority(JobPriority priority)
+{
+    currentPriority = priority;
+}
+
+void WorkerPool::BeginInteractiveWork()
+{
+    interactiveWork.fetch_add(1);
+}
+
+void WorkerPool::EndInteractiveWork()
+{
+    if (interactiveWork.fetch_sub(1) == 1)
+    {
+        std::lock_guard<std::mutex> lock(interactiveMutex);
+        interactiveWorkChanged.notify_all();
+    }
+}
+
+void WorkerPool::YieldToInteractiveWork()
+{
+    if (currentPriority != JobPriorityBackground || interactiveWork.load() == 0)
+    {
+        return;
+    }
+
+    // The interactive work may be waiting for jobs that it queued on the pool, and every worker may be paused
+    // here. The waiting thread runs those jobs, outside of the background mode so they are not slowed down
+    // by the lowered CPU, I/O and memory priority.
+    const bool leaveBackgroundMode = backgroundModeActive;
+
+    if (leaveBackgroundMode)
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+        backgroundModeActive = false;
+    }
+
+    while (interactiveWork.load() > 0)
+    {
+        if (TryRunPendingJob(JobPriorityInteractive))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(interactiveMutex);
+
+        // The timeout guards against a missed notification, the counter and the queues are not changed under this mutex.
+        interactiveWorkChanged.wait_for(lock, std::chrono::milliseconds(10));
+    }
+
+    if (leaveBackgroundMode)
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+        backgroundModeActive = true;
+    }
+}
+
+int WorkerPool::Submit(Job job, int preferredNode, JobPriority priority)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const int nodeCount = static_cast<int>(nodes.size());
+    const int node = preferredNode >= 0 && preferredNode < nodeCount ? preferredNode : static_cast<int>(nextNode++ % nodeCount);
+
+    nodes[node]->queues[priority].push_back(std::move(job));
+
+    // The background jobs that are paused for interactive work run the interactive jobs.
+    if (priority == JobPriorityInteractive && interactiveWork.load() > 0)
+    {
+        std::lock_guard<std::mutex> interactiveLock(interactiveMutex);
+        interactiveWorkChanged.notify_all();
+    }
+
+    if (nodes[node]->idleWorkers > 0)
+    {
+        nodes[node]->jobAvailable.notify_one();
+    }
+    else
+    {
+        // All of the workers on the preferred node are busy, wake a worker
+        // on another node so the job is not left waiting in the queue.
+        for (int i = 1; i < nodeCount; i++)
+        {
+            Node* other = nodes[(node + i) % nodeCount].get();
+
+            if (other->idleWorkers > 0)
+            {
+                other->jobAvailable.notify_one();
+                break;
+            }
+        }
+    }
+
+    return node;
+}
+
+bool WorkerPool::TryRunPendingJob(JobPriority priority)
+{
+    Job job;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!TryDequeue(GetCurrentNode(), priority, job))
+        {
+            return false;
+        }
+    }
+
+    RunJob(job, priority);
+
+    return true;
+}
+
+bool WorkerPool::TryDequeue(int preferredNode, JobPriority priority, Job& job)
+{
+    const int nodeCount = static_cast<int>(nodes.size());
+    const int first = preferredNode >= 0 ? preferredNode : 0;
+
+    // Jobs queued on the preferred node are taken first, the remaining nodes are only used when it is empty.
+    for (int i = 0; i < nodeCount; i++)
+    {
+        std::deque<Job>& queue = nodes[(first + i) % nodeCount]->queues[priority];
+
+        if (!queue.empty())
+        {
+            job = std::move(queue.front());
+            queue.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool WorkerPool::TryDequeueHighestPriority(int preferredNode, QueuedJob& job)
+{
+    for (int priority = 0; priority < JobPriorityCount; priority++)
+    {
+        if (TryDequeue(preferredNode, static_cast<JobPriority>(priority), job.job))
+        {
+            job.priority = static_cast<JobPriority>(priority);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkerPool::RunJob(const Job& job, JobPriority priority)
+{
+    const JobPriority previousPriority = currentPriority;
+    const bool backgroundMode = priority == JobPriorityBackground && previousPriority != JobPriorityBackground;
+
+    // The background mode lowers the CPU, I/O and memory priority of the thread,
+    // it can only be changed for the calling thread.
+    if (backgroundMode)
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+        backgroundModeActive = true;
+    }
+
+    currentPriority = priority;
+
+    job();
+
+    currentPriority = previousPriority;
+
+    if (backgroundMode)
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+        backgroundModeActive = false;
+    }
+}
+
+void WorkerPool::WorkerThread(int node)
+{
+    Node* self = nodes[node].get();
+
+    // An idle worker has no job priority, RunJob sets it for each job.
+    currentPriority = JobPriorityNormal;
+    workerNode = node;
+
+    for (;;)
+    {
+        QueuedJob job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while (!TryDequeueHighestPriority(node, job))
+            {
+                self->idleWorkers++;
+                self->jobAvailable.wait(lock);
+                self->idleWorkers--;
+            }
+        }
+
+        RunJob(job.job, job.priority);
+    }
+}
+
+void TaskGroup::Run(WorkerPool::Job job, int preferredNode)
+{
+    std::shared_ptr<GroupJob> groupJob = std::make_shared<GroupJob>(std::move(job));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending++;
+        queued.push_back(groupJob);
+    }
+
+    // The pool queue keeps the job alive, a job that was run by a waiting thread is skipped
+    // without touching the group, which may have been destroyed by then.
+    const int node = pool.Submit([this, groupJob]()
+    {
+        if (!groupJob->started.exchange(true))
+        {
+            groupJob->job();
+            JobCompleted();
+        }
+    }, preferredNode, priority);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    groupJob->node = node;
+
+    // Wake a waiting thread, so it can help with the new job.
+    completed.notify_all();
+}
+
+bool TaskGroup::TryRunPendingJob()
+{
+    const int currentNode = pool.GetCurrentNode();
+
+    for (;;)
+    {
+        std::shared_ptr<GroupJob> groupJob;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!HasUnstartedJob())
+            {
+                return false;
+            }
+
+            // The queue is in submission order, the first job is used when none are queued on this node.
+            auto job = queued.begin();
+
+            for (auto it = queued.begin(); it != queued.end(); ++it)
+            {
+                if ((*it)->node == currentNode && !(*it)->started.load())
+                {
+                    job = it;
+                    break;
+                }
+            }
+
+            groupJob = *job;
+            queued.erase(job);
+        }
+
+        // A worker may have started the job after the mutex was released.
+        if (!groupJob->started.exchange(true))
+        {
+            WorkerPool::RunJob(groupJob->job, priority);
+            JobCompleted();
+            return true;
+        }
+    }
+}
+
+void TaskGroup::Wait()
+{
+    for (;;)
+    {
+        if (TryRunPendingJob())
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // The remaining jobs are running on other threads, wait until they have finished
+        // or one of them has added a job to the group.
+        completed.wait(lock, [this]() { return pending == 0 || HasUnstartedJob(); });
+
+        if (pending == 0)
+        {
+            return;
+        }
+    }
+}
+
+bool TaskGroup::HasUnstartedJob()
+{
+    // The jobs that have been started by the workers are no longer needed.
+    queued.erase(std::remove_if(queued.begin(), queued.end(), [](const std::shared_ptr<GroupJob>& job) { return job->started.load(); }), queued.end());
+
+    return !queued.empty();
+}
+
+void TaskGroup::JobCompleted()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pending--;
+    completed.notify_all();
+}
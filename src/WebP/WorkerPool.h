@@ -0,0 +1,212 @@
+////////////////////////////////////////////////////////////////////////
+//
+// This file is part of pdn-webp, a FileType plugin for Paint.NET
+// that loads and saves WebP images.
+//
+// Copyright (c) 2011-2022 Nicholas Hayes
+//
+// This file is licensed under the MIT License.
+// See LICENSE.txt for complete licensing and attribution information.
+//
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "WebP.h"
+
+// A process-wide pool of worker threads with a separate job queue for each NUMA node.
+//
+// The workers for a node are affinitized to the processors of that node, so the memory
+// they allocate and touch first is placed on that node by the operating system.
+// On single-node machines the pool has one queue and the threads are not affinitized.
+//
+// Each node has a queue for every JobPriority, the workers take the jobs with the highest priority first.
+// Background jobs run in the background processing mode, and pause at the encoder progress checkpoints
+// while interactive work is running, so bulk jobs do not delay an interactive save. A paused worker
+// leaves the background mode and runs the queued interactive jobs until the interactive work has finished.
+class WorkerPool
+{
+public:
+    typedef std::function<void()> Job;
+
+    static WorkerPool& GetInstance();
+
+    // Disable copying and assignment.
+    WorkerPool(const WorkerPool&) = delete;
+    const WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int GetNodeCount() const
+    {
+        return static_cast<int>(nodes.size());
+    }
+
+    int GetWorkerCount() const
+    {
+        return workerCount;
+    }
+
+    // Gets the NUMA node that holds the page containing the specified address.
+    // Returns -1 if the node cannot be determined, e.g. when the page is not resident.
+    int GetNodeForAddress(const void* address) const;
+
+    // Gets the NUMA node of the processor that the calling thread is running on, or -1 if it cannot be determined.
+    int GetCurrentNode() const;
+
+    // Queues a job on the specified node, a negative node selects the next node in round-robin order.
+    // Returns the node that the job was queued on.
+    int Submit(Job job, int preferredNode, JobPriority priority);
+
+    // Runs one queued job with the specified priority on the calling thread, the jobs queued on the
+    // node that the thread is running on are taken first.
+    // Returns true if a job was run, or false if the queues for that priority were empty.
+    bool TryRunPendingJob(JobPriority priority);
+
+    // Runs a job on the calling thread with the scheduling priority of the specified job priority.
+    static void RunJob(const Job& job, JobPriority priority);
+
+    // Gets the priority of the job that is running on the calling thread.
+    // Threads that are not running a pool job are interactive unless SetCurrentPriority was called.
+    static JobPriority GetCurrentPriority();
+
+    static void SetCurrentPriority(JobPriority priority);
+
+    // Marks the start and end of work that an interactive thread is waiting for, see InteractiveWorkScope.
+    void BeginInteractiveWork();
+    void EndInteractiveWork();
+
+    // Called by jobs at progress checkpoints, a background job waits until there is no interactive work
+    // and runs the queued interactive jobs on the calling thread while it waits.
+    void YieldToInteractiveWork();
+
+private:
+    struct Node
+    {
+        Node(unsigned short number) : number(number), idleWorkers(0)
+        {
+        }
+
+        std::deque<Job> queues[JobPriorityCount];
+        std::condition_variable jobAvailable;
+        unsigned short number;
+        int idleWorkers;
+    };
+
+    WorkerPool();
+
+    struct QueuedJob
+    {
+        Job job;
+        JobPriority priority;
+    };
+
+    // The caller must hold the mutex.
+    bool TryDequeue(int preferredNode, JobPriority priority, Job& job);
+    bool TryDequeueHighestPriority(int preferredNode, QueuedJob& job);
+    void WorkerThread(int node);
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::mutex mutex;
+    int workerCount;
+    unsigned int nextNode;
+    std::atomic<int> interactiveWork;
+    std::mutex interactiveMutex;
+    // Notified when the interactive work has finished, or an interactive job has been queued.
+    std::condition_variable interactiveWorkChanged;
+};
+
+// Marks the lifetime of an encode or decode that is called from an interactive thread,
+// background jobs are paused at their next progress checkpoint until it has finished.
+class InteractiveWorkScope
+{
+public:
+    InteractiveWorkScope() : pool(WorkerPool::GetInstance()), active(WorkerPool::GetCurrentPriority() == JobPriorityInteractive)
+    {
+        if (active)
+        {
+            pool.BeginInteractiveWork();
+        }
+    }
+
+    ~InteractiveWorkScope()
+    {
+        if (active)
+        {
+            pool.EndInteractiveWork();
+        }
+    }
+
+    // Disable copying and assignment.
+    InteractiveWorkScope(const InteractiveWorkScope&) = delete;
+    const InteractiveWorkScope& operator=(const InteractiveWorkScope&) = delete;
+
+private:
+    WorkerPool& pool;
+    bool active;
+};
+
+// Tracks a group of jobs submitted to the worker pool.
+// Waiting for the group runs the group's queued jobs on the calling thread, so a job
+// may start and wait for nested groups without starving the pool.
+// The jobs of other groups are left to the workers, the waiting thread is not affinitized to
+// their node and the time spent waiting should only depend on the work of this group.
+class TaskGroup
+{
+public:
+    // The jobs inherit the priority of the calling thread.
+    TaskGroup() : pool(WorkerPool::GetInstance()), priority(WorkerPool::GetCurrentPriority()), queued(), pending(0)
+    {
+    }
+
+    explicit TaskGroup(JobPriority priority) : pool(WorkerPool::GetInstance()), priority(priority), queued(), pending(0)
+    {
+    }
+
+    ~TaskGroup()
+    {
+        Wait();
+    }
+
+    // Disable copying and assignment.
+    TaskGroup(const TaskGroup&) = delete;
+    const TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void Run(WorkerPool::Job job, int preferredNode = -1);
+
+    // Runs one of the group's jobs that has not been started by a worker on the calling thread,
+    // the jobs queued on the node that the thread is running on are taken first.
+    // Returns true if a job was run, or false if every job has been started.
+    bool TryRunPendingJob();
+
+    void Wait();
+
+private:
+    struct GroupJob
+    {
+        explicit GroupJob(WorkerPool::Job job) : job(std::move(job)), node(-1), started(false)
+        {
+        }
+
+        WorkerPool::Job job;
+        int node;
+        // Set by the thread that runs the job, the pool queue and the group both reference the job.
+        std::atomic<bool> started;
+    };
+
+    // The caller must hold the mutex.
+    bool HasUnstartedJob();
+    void JobCompleted();
+
+    WorkerPool& pool;
+    JobPriority priority;
+    std::mutex mutex;
+    std::condition_variable completed;
+    std::deque<std::shared_ptr<GroupJob>> queued;
+    int pending;
+};
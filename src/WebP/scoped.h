@@ -223,6 +223,14 @@ public:
         }
     }
 
+    // Exchanges the buffers of the two writers.
+    void Swap(ScopedWebPMemoryWriter& other)
+    {
+        WebPMemoryWriter* temp = writer;
+        writer = other.writer;
+        other.writer = temp;
+    }
+
     void Release()
     {
         if (writer != nullptr)
@@ -30,45 +30,51 @@ namespace WebPFileType
         /// Gets the color profile from the WebP image.
         /// </summary>
         /// <param name="webpBytes">The WebP image data.</param>
+        /// <param name="loadResult">The metadata locations that were returned when the image was loaded.</param>
         /// <returns>
         /// A byte array containing the color profile, if present; otherwise, <see langword="null"/>
         /// </returns>
         /// <exception cref="ArgumentNullException"><paramref name="webpBytes"/> is null.</exception>
-        internal static byte[] GetColorProfileBytes(byte[] webpBytes)
+        internal static byte[] GetColorProfileBytes(byte[] webpBytes, in WebPNative.LoadResult loadResult)
         {
-            return GetMetadataBytes(webpBytes, WebPNative.MetadataType.ColorProfile);
+            return GetMetadataBytes(webpBytes, loadResult.iccProfile);
         }
 
         /// <summary>
         /// Gets the EXIF data from the WebP image.
         /// </summary>
         /// <param name="webpBytes">The WebP image data.</param>
+        /// <param name="loadResult">The metadata locations that were returned when the image was loaded.</param>
         /// <returns>
         /// A byte array containing the EXIF data, if present; otherwise, <see langword="null"/>
         /// </returns>
         /// <exception cref="ArgumentNullException"><paramref name="webpBytes"/> is null.</exception>
-        internal static byte[] GetExifBytes(byte[] webpBytes)
+        internal static byte[] GetExifBytes(byte[] webpBytes, in WebPNative.LoadResult loadResult)
         {
-            return GetMetadataBytes(webpBytes, WebPNative.MetadataType.EXIF);
+            return GetMetadataBytes(webpBytes, loadResult.exif);
         }
 
         /// <summary>
         /// Gets the XMP data from the WebP image.
         /// </summary>
         /// <param name="webpBytes">The WebP image data.</param>
+        /// <param name="loadResult">The metadata locations that were returned when the image was loaded.</param>
         /// <returns>
         /// A byte array containing the XMP data, if present; otherwise, <see langword="null"/>
         /// </returns>
         /// <exception cref="ArgumentNullException"><paramref name="webpBytes"/> is null.</exception>
-        internal static byte[] GetXmpBytes(byte[] webpBytes)
+        internal static byte[] GetXmpBytes(byte[] webpBytes, in WebPNative.LoadResult loadResult)
         {
-            return GetMetadataBytes(webpBytes, WebPNative.MetadataType.XMP);
+            return GetMetadataBytes(webpBytes, loadResult.xmp);
         }
 
         /// <summary>
         /// The WebP load function.
         /// </summary>
         /// <param name="webpBytes">The input image data</param>
+        /// <param name="loadResult">
+        /// The image information, and the location of the metadata in <paramref name="webpBytes"/>.
+        /// </param>
         /// <returns>
         /// A <see cref="Bitmap"/> containing the WebP image.
         /// </returns>
@@ -79,16 +85,17 @@ namespace WebPFileType
         /// -or-
         /// A native API parameter is invalid.
         /// </exception>
-        internal static unsafe Surface Load(byte[] webpBytes)
+        internal static unsafe Surface Load(byte[] webpBytes, out WebPNative.LoadResult loadResult)
         {
             if (webpBytes == null)
             {
                 throw new ArgumentNullException(nameof(webpBytes));
             }
 
-            WebPNative.WebPGetImageInfo(webpBytes, out WebPNative.ImageInfo imageInfo);
+            // The first call only reads the image size, the second call decodes the image and locates the metadata.
+            WebPNative.WebPLoadWithMetadata(webpBytes, null, out loadResult);
 
-            if (imageInfo.hasAnimation)
+            if (loadResult.info.hasAnimation)
             {
                 throw new WebPException(Resources.AnimatedWebPNotSupported);
             }
@@ -98,9 +105,12 @@ namespace WebPFileType
 
             try
             {
-                temp = new Surface(imageInfo.width, imageInfo.height);
+                temp = new Surface(loadResult.info.width, loadResult.info.height);
 
-                WebPNative.WebPLoad(webpBytes, temp);
+                if (!WebPNative.WebPLoadWithMetadata(webpBytes, temp, out loadResult))
+                {
+                    throw new WebPException(Resources.InvalidWebPImage);
+                }
 
                 image = temp;
                 temp = null;
@@ -295,12 +305,12 @@ namespace WebPFileType
         /// Gets the metadata from the WebP image.
         /// </summary>
         /// <param name="webpBytes">The WebP image data.</param>
-        /// <param name="type">The metadata type.</param>
+        /// <param name="span">The location of the metadata in <paramref name="webpBytes"/>.</param>
         /// <returns>
         /// A byte array containing the requested metadata, if present; otherwise, <see langword="null"/>
         /// </returns>
         /// <exception cref="ArgumentNullException"><paramref name="webpBytes"/> is null.</exception>
-        private static byte[] GetMetadataBytes(byte[] webpBytes, WebPNative.MetadataType type)
+        private static byte[] GetMetadataBytes(byte[] webpBytes, WebPNative.MetadataSpan span)
         {
             if (webpBytes == null)
             {
@@ -309,11 +319,11 @@ namespace WebPFileType
 
             byte[] bytes = null;
 
-            uint size = WebPNative.GetMetadataSize(webpBytes, type);
+            int size = checked((int)span.size.ToUInt64());
             if (size > 0)
             {
                 bytes = new byte[size];
-                WebPNative.ExtractMetadata(webpBytes, type, bytes, size);
+                Buffer.BlockCopy(webpBytes, checked((int)span.offset.ToUInt64()), bytes, 0, size);
             }
 
             return bytes;
@@ -64,25 +64,22 @@ namespace WebPFileType
             return strings.GetString(name);
         }
 
-        private static Surface GetOrientedSurface(byte[] bytes, out ExifValueCollection exifMetadata)
+        private static Surface GetOrientedSurface(byte[] bytes, out WebPNative.LoadResult loadResult, out ExifValueCollection exifMetadata)
         {
             exifMetadata = null;
 
-            Surface surface = WebPFile.Load(bytes);
+            Surface surface = WebPFile.Load(bytes, out loadResult);
 
-            byte[] exifBytes = WebPFile.GetExifBytes(bytes);
+            // The orientation is read by the native EXIF reader when the image is loaded.
+            MetadataHelpers.ApplyOrientationTransform(loadResult.exifInfo.orientation, ref surface);
+
+            byte[] exifBytes = WebPFile.GetExifBytes(bytes, loadResult);
             if (exifBytes != null)
             {
                 exifMetadata = ExifParser.Parse(exifBytes);
 
-                if (exifMetadata != null)
-                {
-                    ExifValue orientationProperty = exifMetadata.GetAndRemoveValue(ExifPropertyKeys.Image.Orientation.Path);
-                    if (orientationProperty != null)
-                    {
-                        MetadataHelpers.ApplyOrientationTransform(orientationProperty, ref surface);
-                    }
-                }
+                // The orientation has been applied to the image, so it is not copied to the document.
+                exifMetadata?.GetAndRemoveValue(ExifPropertyKeys.Image.Orientation.Path);
             }
 
             return surface;
@@ -97,14 +94,14 @@ namespace WebPFileType
 
             if (FormatDetection.HasWebPFileSignature(bytes))
             {
-                Surface surface = GetOrientedSurface(bytes, out ExifValueCollection exifMetadata);
+                Surface surface = GetOrientedSurface(bytes, out WebPNative.LoadResult loadResult, out ExifValueCollection exifMetadata);
                 bool disposeSurface = true;
 
                 try
                 {
                     doc = new Document(surface.Width, surface.Height);
 
-                    byte[] colorProfileBytes = WebPFile.GetColorProfileBytes(bytes);
+                    byte[] colorProfileBytes = WebPFile.GetColorProfileBytes(bytes, loadResult);
                     if (colorProfileBytes != null)
                     {
                         doc.Metadata.AddExifPropertyItem(ExifSection.Image,
@@ -113,36 +110,31 @@ namespace WebPFileType
                                                                        colorProfileBytes));
                     }
 
-                    if (exifMetadata != null && exifMetadata.Count > 0)
-                    {
-                        ExifValue xResProperty = exifMetadata.GetAndRemoveValue(ExifPropertyKeys.Image.XResolution.Path);
-                        ExifValue yResProperty = exifMetadata.GetAndRemoveValue(ExifPropertyKeys.Image.YResolution.Path);
-                        ExifValue resUnitProperty = exifMetadata.GetAndRemoveValue(ExifPropertyKeys.Image.ResolutionUnit.Path);
+                    WebPNative.ExifImageInfo exifInfo = loadResult.exifInfo;
 
-                        if (xResProperty != null && yResProperty != null && resUnitProperty != null)
+                    if (exifInfo.xResolution > 0.0 && exifInfo.yResolution > 0.0)
+                    {
+                        switch (exifInfo.resolutionUnit)
                         {
-                            if (MetadataHelpers.TryDecodeRational(xResProperty, out double xRes) &&
-                                MetadataHelpers.TryDecodeRational(yResProperty, out double yRes) &&
-                                MetadataHelpers.TryDecodeShort(resUnitProperty, out ushort resUnit))
-                            {
-                                if (xRes > 0.0 && yRes > 0.0)
-                                {
-                                    switch (resUnit)
-                                    {
-                                        case TiffConstants.ResolutionUnit.Centimeter:
-                                            doc.DpuUnit = MeasurementUnit.Centimeter;
-                                            doc.DpuX = xRes;
-                                            doc.DpuY = yRes;
-                                            break;
-                                        case TiffConstants.ResolutionUnit.Inch:
-                                            doc.DpuUnit = MeasurementUnit.Inch;
-                                            doc.DpuX = xRes;
-                                            doc.DpuY = yRes;
-                                            break;
-                                    }
-                                }
-                            }
+                            case TiffConstants.ResolutionUnit.Centimeter:
+                                doc.DpuUnit = MeasurementUnit.Centimeter;
+                                doc.DpuX = exifInfo.xResolution;
+                                doc.DpuY = exifInfo.yResolution;
+                                break;
+                            case TiffConstants.ResolutionUnit.Inch:
+                                doc.DpuUnit = MeasurementUnit.Inch;
+                                doc.DpuX = exifInfo.xResolution;
+                                doc.DpuY = exifInfo.yResolution;
+                                break;
                         }
+                    }
+
+                    if (exifMetadata != null && exifMetadata.Count > 0)
+                    {
+                        // The resolution has been applied to the document above.
+                        exifMetadata.GetAndRemoveValue(ExifPropertyKeys.Image.XResolution.Path);
+                        exifMetadata.GetAndRemoveValue(ExifPropertyKeys.Image.YResolution.Path);
+                        exifMetadata.GetAndRemoveValue(ExifPropertyKeys.Image.ResolutionUnit.Path);
 
                         foreach (KeyValuePair<ExifPropertyPath, ExifValue> item in exifMetadata)
                         {
@@ -152,7 +144,7 @@ namespace WebPFileType
                         }
                     }
 
-                    byte[] xmpBytes = WebPFile.GetXmpBytes(bytes);
+                    byte[] xmpBytes = WebPFile.GetXmpBytes(bytes, loadResult);
                     if (xmpBytes != null)
                     {
                         XmpPacket xmpPacket = XmpPacket.TryParse(xmpBytes);
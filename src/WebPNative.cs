@@ -21,15 +21,9 @@ namespace WebPFileType
 {
     internal static class WebPNative
     {
-        internal enum MetadataType : int
-        {
-            ColorProfile = 0,
-            EXIF,
-            XMP
-        }
-
         private enum VP8StatusCode : int
         {
+            BufferTooSmall = -3,
             Ok = 0,
             OutOfMemory,
             InvalidParam,
@@ -64,6 +58,7 @@ namespace WebPFileType
         [UnmanagedFunctionPointer(CallingConvention.StdCall)]
         private delegate WebPEncodingError WebPWriteImage(IntPtr image, UIntPtr imageSize);
 
+        // This must be kept in sync with the EncodeParams structure in WebP.h.
         [StructLayout(LayoutKind.Sequential)]
         internal sealed class EncodeParams
         {
@@ -73,6 +68,18 @@ namespace WebPFileType
             public WebPPreset preset;
             [MarshalAs(UnmanagedType.U1)]
             public bool lossless;
+            [MarshalAs(UnmanagedType.U1)]
+            public bool crunch;
+            [MarshalAs(UnmanagedType.I4)]
+            public int crunchTimeLimit;
+            [MarshalAs(UnmanagedType.I4)]
+            public int alphaCompression = -1;
+            [MarshalAs(UnmanagedType.I4)]
+            public int alphaFiltering = -1;
+            [MarshalAs(UnmanagedType.I4)]
+            public int alphaQuality = -1;
+            [MarshalAs(UnmanagedType.I4)]
+            public int method = -1;
         }
 
         [StructLayout(LayoutKind.Sequential)]
@@ -110,18 +117,43 @@ namespace WebPFileType
             public bool hasAnimation;
         }
 
+        // This must be kept in sync with the MetadataSpan structure in WebP.h.
+        [StructLayout(LayoutKind.Sequential)]
+        internal struct MetadataSpan
+        {
+            public UIntPtr offset;
+            public UIntPtr size;
+        }
+
+        // This must be kept in sync with the ExifImageInfo structure in WebP.h.
+        [StructLayout(LayoutKind.Sequential)]
+        internal struct ExifImageInfo
+        {
+            public ushort orientation;
+            public ushort resolutionUnit;
+            public double xResolution;
+            public double yResolution;
+        }
+
+        // This must be kept in sync with the LoadResult structure in WebP.h.
+        [StructLayout(LayoutKind.Sequential)]
+        internal struct LoadResult
+        {
+            public ImageInfo info;
+            public MetadataSpan iccProfile;
+            public MetadataSpan exif;
+            public MetadataSpan xmp;
+            public ExifImageInfo exifInfo;
+        }
+
         internal const int WebPMaxDimension = 16383;
 
         [System.Security.SuppressUnmanagedCodeSecurity]
         private unsafe static class WebP_x86
         {
             [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_x86.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPGetImageInfo")]
-            public static extern VP8StatusCode WebPGetImageInfo(byte* data, UIntPtr dataSize, out ImageInfo info);
-
-            [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_x86.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPLoad")]
-            public static extern VP8StatusCode WebPLoad(byte* data, UIntPtr dataSize, byte* outData, UIntPtr outSize, int outStride);
+            [DllImport("WebP_x86.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPLoadWithMetadata")]
+            public static extern VP8StatusCode WebPLoadWithMetadata(byte* data, UIntPtr dataSize, byte* outData, UIntPtr outSize, int outStride, out LoadResult result);
 
             [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
             [DllImport("WebP_x86.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPSave")]
@@ -135,26 +167,14 @@ namespace WebPFileType
                 [MarshalAs(UnmanagedType.CustomMarshaler, MarshalTypeRef = typeof(MetadataCustomMarshaler))]
                 MetadataParams metadata,
                 WebPReportProgress callback);
-
-            [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_x86.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "GetMetadataSize")]
-            public static extern uint GetMetadataSize(byte* iData, UIntPtr iDataSize, MetadataType type);
-
-            [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_x86.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "ExtractMetadata")]
-            public static extern void ExtractMetadata(byte* iData, UIntPtr iDataSize, byte* metadataBytes, uint metadataSize, MetadataType type);
         }
 
         [System.Security.SuppressUnmanagedCodeSecurity]
         private unsafe static class WebP_x64
         {
             [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_x64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPGetImageInfo")]
-            public static extern VP8StatusCode WebPGetImageInfo(byte* data, UIntPtr dataSize, out ImageInfo info);
-
-            [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_x64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPLoad")]
-            public static extern VP8StatusCode WebPLoad(byte* data, UIntPtr dataSize, byte* outData, UIntPtr outSize, int outStride);
+            [DllImport("WebP_x64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPLoadWithMetadata")]
+            public static extern VP8StatusCode WebPLoadWithMetadata(byte* data, UIntPtr dataSize, byte* outData, UIntPtr outSize, int outStride, out LoadResult result);
 
             [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
             [DllImport("WebP_x64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPSave")]
@@ -168,26 +188,14 @@ namespace WebPFileType
                 [MarshalAs(UnmanagedType.CustomMarshaler, MarshalTypeRef = typeof(MetadataCustomMarshaler))]
                 MetadataParams metadata,
                 WebPReportProgress callback);
-
-            [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_x64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "GetMetadataSize")]
-            public static extern uint GetMetadataSize(byte* iData, UIntPtr iDataSize, MetadataType type);
-
-            [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_x64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "ExtractMetadata")]
-            public static extern void ExtractMetadata(byte* iData, UIntPtr iDataSize, byte* metadataBytes, uint metadataSize, MetadataType type);
         }
 
         [System.Security.SuppressUnmanagedCodeSecurity]
         private unsafe static class WebP_ARM64
         {
             [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_ARM64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPGetImageInfo")]
-            public static extern VP8StatusCode WebPGetImageInfo(byte* data, UIntPtr dataSize, out ImageInfo info);
-
-            [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_ARM64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPLoad")]
-            public static extern VP8StatusCode WebPLoad(byte* data, UIntPtr dataSize, byte* outData, UIntPtr outSize, int outStride);
+            [DllImport("WebP_ARM64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPLoadWithMetadata")]
+            public static extern VP8StatusCode WebPLoadWithMetadata(byte* data, UIntPtr dataSize, byte* outData, UIntPtr outSize, int outStride, out LoadResult result);
 
             [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
             [DllImport("WebP_ARM64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "WebPSave")]
@@ -201,99 +209,55 @@ namespace WebPFileType
                 [MarshalAs(UnmanagedType.CustomMarshaler, MarshalTypeRef = typeof(MetadataCustomMarshaler))]
                 MetadataParams metadata,
                 WebPReportProgress callback);
-
-            [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_ARM64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "GetMetadataSize")]
-            public static extern uint GetMetadataSize(byte* iData, UIntPtr iDataSize, MetadataType type);
-
-            [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Design", "CA1060:MovePInvokesToNativeMethodsClass")]
-            [DllImport("WebP_ARM64.dll", CallingConvention = CallingConvention.StdCall, EntryPoint = "ExtractMetadata")]
-            public static extern void ExtractMetadata(byte* iData, UIntPtr iDataSize, byte* metadataBytes, uint metadataSize, MetadataType type);
         }
 
         /// <summary>
-        /// Gets the WebP image information.
+        /// Decodes the WebP image and locates its metadata.
         /// </summary>
-        /// <param name="data">The input image data.</param>
-        /// <param name="info">The output image information.</param>
+        /// <param name="webpBytes">The input image data.</param>
+        /// <param name="output">The output surface, or <see langword="null"/> to only read the image information.</param>
+        /// <param name="result">
+        /// The image information, and the location of the metadata in <paramref name="webpBytes"/>.
+        /// The metadata is only located when <paramref name="output"/> is not <see langword="null"/>.
+        /// </param>
+        /// <returns>
+        /// <see langword="true"/> if the image was decoded into <paramref name="output"/>; otherwise,
+        /// <see langword="false"/> if <paramref name="output"/> is null or smaller than the image.
+        /// </returns>
         /// <exception cref="OutOfMemoryException">Insufficient memory to load the WebP image.</exception>
         /// <exception cref="WebPException">
         /// The WebP image is invalid.
         /// -or-
         /// A native API parameter is invalid.
         /// </exception>
-        internal static unsafe void WebPGetImageInfo(byte[] data, out ImageInfo info)
+        internal static unsafe bool WebPLoadWithMetadata(byte[] webpBytes, Surface output, out LoadResult result)
         {
             VP8StatusCode status;
 
-            fixed (byte* ptr = data)
+            fixed (byte* ptr = webpBytes)
             {
-                if (RuntimeInformation.ProcessArchitecture == Architecture.X64)
-                {
-                    status = WebP_x64.WebPGetImageInfo(ptr, new UIntPtr((ulong)data.Length), out info);
-                }
-                else if (RuntimeInformation.ProcessArchitecture == Architecture.X86)
-                {
-                    status = WebP_x86.WebPGetImageInfo(ptr, new UIntPtr((ulong)data.Length), out info);
-                }
-                else if (RuntimeInformation.ProcessArchitecture == Architecture.Arm64)
-                {
-                    status = WebP_ARM64.WebPGetImageInfo(ptr, new UIntPtr((ulong)data.Length), out info);
-                }
-                else
-                {
-                    throw new PlatformNotSupportedException();
-                }
-            }
+                byte* outData = null;
+                int stride = 0;
+                ulong outputSize = 0;
 
-            if (status != VP8StatusCode.Ok)
-            {
-                switch (status)
+                if (output != null)
                 {
-                    case VP8StatusCode.OutOfMemory:
-                        throw new OutOfMemoryException();
-                    case VP8StatusCode.InvalidParam:
-                        throw new WebPException(string.Format(CultureInfo.InvariantCulture, Resources.InvalidParameterFormat, nameof(WebPGetImageInfo)));
-                    case VP8StatusCode.UnsupportedFeature:
-                        throw new WebPException(Resources.UnsupportedWebPFeature);
-                    case VP8StatusCode.BitStreamError:
-                    case VP8StatusCode.NotEnoughData:
-                    default:
-                        throw new WebPException(Resources.InvalidWebPImage);
+                    outData = (byte*)output.Scan0.VoidStar;
+                    stride = output.Stride;
+                    outputSize = (ulong)stride * (ulong)output.Height;
                 }
-            }
-        }
-
-        /// <summary>
-        /// The WebP load function.
-        /// </summary>
-        /// <param name="webpBytes">The input image data</param>
-        /// <exception cref="OutOfMemoryException">Insufficient memory to load the WebP image.</exception>
-        /// <exception cref="WebPException">
-        /// The WebP image is invalid.
-        /// -or-
-        /// A native API parameter is invalid.
-        /// </exception>
-        internal static unsafe void WebPLoad(byte[] webpBytes, Surface output)
-        {
-            VP8StatusCode status;
-
-            fixed (byte* ptr = webpBytes)
-            {
-                int stride = output.Stride;
-                ulong outputSize = (ulong)stride * (ulong)output.Height;
 
                 if (RuntimeInformation.ProcessArchitecture == Architecture.X64)
                 {
-                    status = WebP_x64.WebPLoad(ptr, new UIntPtr((ulong)webpBytes.Length), (byte*)output.Scan0.VoidStar, new UIntPtr(outputSize), stride);
+                    status = WebP_x64.WebPLoadWithMetadata(ptr, new UIntPtr((ulong)webpBytes.Length), outData, new UIntPtr(outputSize), stride, out result);
                 }
                 else if (RuntimeInformation.ProcessArchitecture == Architecture.X86)
                 {
-                    status = WebP_x86.WebPLoad(ptr, new UIntPtr((ulong)webpBytes.Length), (byte*)output.Scan0.VoidStar, new UIntPtr(outputSize), stride);
+                    status = WebP_x86.WebPLoadWithMetadata(ptr, new UIntPtr((ulong)webpBytes.Length), outData, new UIntPtr(outputSize), stride, out result);
                 }
                 else if (RuntimeInformation.ProcessArchitecture == Architecture.Arm64)
                 {
-                    status = WebP_ARM64.WebPLoad(ptr, new UIntPtr((ulong)webpBytes.Length), (byte*)output.Scan0.VoidStar, new UIntPtr(outputSize), stride);
+                    status = WebP_ARM64.WebPLoadWithMetadata(ptr, new UIntPtr((ulong)webpBytes.Length), outData, new UIntPtr(outputSize), stride, out result);
                 }
                 else
                 {
@@ -305,10 +269,12 @@ namespace WebPFileType
             {
                 switch (status)
                 {
+                    case VP8StatusCode.BufferTooSmall:
+                        return false;
                     case VP8StatusCode.OutOfMemory:
                         throw new OutOfMemoryException();
                     case VP8StatusCode.InvalidParam:
-                        throw new WebPException(string.Format(CultureInfo.InvariantCulture, Resources.InvalidParameterFormat, nameof(WebPLoad)));
+                        throw new WebPException(string.Format(CultureInfo.InvariantCulture, Resources.InvalidParameterFormat, nameof(WebPLoadWithMetadata)));
                     case VP8StatusCode.UnsupportedFeature:
                         throw new WebPException(Resources.UnsupportedWebPFeature);
                     case VP8StatusCode.BitStreamError:
@@ -317,6 +283,8 @@ namespace WebPFileType
                         throw new WebPException(Resources.InvalidWebPImage);
                 }
             }
+
+            return true;
         }
 
         /// <summary>
@@ -408,56 +376,6 @@ namespace WebPFileType
             }
         }
 
-        internal static unsafe uint GetMetadataSize(byte[] data, MetadataType type)
-        {
-            uint metadataSize;
-
-            fixed (byte* ptr = data)
-            {
-                if (RuntimeInformation.ProcessArchitecture == Architecture.X64)
-                {
-                    metadataSize = WebP_x64.GetMetadataSize(ptr, new UIntPtr((ulong)data.Length), type);
-                }
-                else if (RuntimeInformation.ProcessArchitecture == Architecture.X86)
-                {
-                    metadataSize = WebP_x86.GetMetadataSize(ptr, new UIntPtr((ulong)data.Length), type);
-                }
-                else if (RuntimeInformation.ProcessArchitecture == Architecture.Arm64)
-                {
-                    metadataSize = WebP_ARM64.GetMetadataSize(ptr, new UIntPtr((ulong)data.Length), type);
-                }
-                else
-                {
-                    throw new PlatformNotSupportedException();
-                }
-            }
-
-            return metadataSize;
-        }
-
-        internal static unsafe void ExtractMetadata(byte[] data, MetadataType type, byte[] outData, uint outSize)
-        {
-            fixed (byte* ptr = data, outPtr = outData)
-            {
-                if (RuntimeInformation.ProcessArchitecture == Architecture.X64)
-                {
-                    WebP_x64.ExtractMetadata(ptr, new UIntPtr((ulong)data.Length), outPtr, outSize, type);
-                }
-                else if (RuntimeInformation.ProcessArchitecture == Architecture.X86)
-                {
-                    WebP_x86.ExtractMetadata(ptr, new UIntPtr((ulong)data.Length), outPtr, outSize, type);
-                }
-                else if (RuntimeInformation.ProcessArchitecture == Architecture.Arm64)
-                {
-                    WebP_ARM64.ExtractMetadata(ptr, new UIntPtr((ulong)data.Length), outPtr, outSize, type);
-                }
-                else
-                {
-                    throw new PlatformNotSupportedException();
-                }
-            }
-        }
-
         private sealed class StreamIOHandler
         {
             private readonly Stream output;